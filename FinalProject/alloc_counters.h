@@ -0,0 +1,29 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: alloc_counters.h
+// DATE: Spring 2021
+// DESC: Process-wide count of heap allocations (number and bytes) used
+//       by the phase report and the profiler. The counts are only kept
+//       in a program that replaces the global operator new and delete
+//       with the counting ones in alloc_hooks.h (mypl does); elsewhere
+//       they stay at zero.
+//----------------------------------------------------------------------
+
+#ifndef ALLOC_COUNTERS_H
+#define ALLOC_COUNTERS_H
+
+#include <atomic>
+#include <cstddef>
+
+
+// allocation counters (only updated while some tool has enabled them)
+struct AllocCounters
+{
+  static std::atomic<int>& users() {static std::atomic<int> n(0); return n;}
+  static std::atomic<size_t>& count() {static std::atomic<size_t> n(0); return n;}
+  static std::atomic<size_t>& bytes() {static std::atomic<size_t> n(0); return n;}
+  static void enable() {++users();}
+  static void disable() {--users();}
+};
+
+#endif
@@ -0,0 +1,57 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: alloc_hooks.h
+// DATE: Spring 2021
+// DESC: Replaces the global operator new and delete with ones that
+//       update the allocation counters (see alloc_counters.h). A
+//       program can replace them only once, so this header belongs in
+//       a single translation unit of an executable (mypl.cpp), never in
+//       a header that others include.
+//----------------------------------------------------------------------
+
+#ifndef ALLOC_HOOKS_H
+#define ALLOC_HOOKS_H
+
+#include <cstdlib>
+#include <new>
+#include "alloc_counters.h"
+
+
+void* operator new(size_t size)
+{
+  if (AllocCounters::users().load(std::memory_order_relaxed) > 0) {
+    AllocCounters::count().fetch_add(1, std::memory_order_relaxed);
+    AllocCounters::bytes().fetch_add(size, std::memory_order_relaxed);
+  }
+  void* p = std::malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+  std::free(p);
+}
+
+#endif
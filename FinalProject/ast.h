@@ -13,7 +13,9 @@
 #ifndef AST_H
 #define AST_H
 
+#include <atomic>
 #include <list>
+#include <vector>
 #include "token.h"
 
 //----------------------------------------------------------------------
@@ -37,6 +39,7 @@ class TryStmt;
 class CatchStmt;
 class ThrowStmt;
 class Expr;
+class QuickExpr;
 class SimpleTerm;
 class ComplexTerm;
 class SimpleRValue;
@@ -48,6 +51,7 @@ class NegatedRValue;
 
 class Visitor {
 public:
+  virtual ~Visitor() {};
   // top-level
   virtual void visit(Program& node) = 0;
   virtual void visit(FunDecl& node) = 0;
@@ -66,6 +70,7 @@ public:
   virtual void visit(ThrowStmt& node) = 0;
   // expressions
   virtual void visit(Expr& node) = 0;
+  virtual void visit(QuickExpr& node) = 0;
   virtual void visit(SimpleTerm& node) = 0;
   virtual void visit(ComplexTerm& node) = 0;
   // rvalues (rhs values)
@@ -99,6 +104,9 @@ class Decl : public ASTNode
 // root statement node
 class Stmt : public ASTNode
 {
+public:
+  int line = 0;                 // source position of the first token
+  int column = 0;
 };
 
 
@@ -106,6 +114,7 @@ class Stmt : public ASTNode
 class ExprTerm : public ASTNode
 {
 public:
+  std::string type;             // static type (set by the type checker)
   virtual Token first_token() = 0;
 };
 
@@ -129,6 +138,7 @@ public:
   ExprTerm* first = nullptr;    // the first term
   Token* op = nullptr;          // optional operator
   Expr* rest = nullptr;         // expression after operator (if exists)
+  std::string type;             // static type (set by the type checker)
   // cleanup
   ~Expr() {delete first; delete op; delete rest;}
   // get first token
@@ -138,6 +148,28 @@ public:
 };
 
 
+// type-specialized binary expression created from a type-checked Expr
+// (see quickener.h); the operand types are fixed, so no runtime type
+// tests are needed to evaluate it
+class QuickExpr : public Expr
+{
+public:
+  enum QuickOp {
+    INT_ADD, INT_SUB, INT_MUL, INT_DIV, INT_MOD,
+    INT_LESS, INT_LESS_EQUAL, INT_GREATER, INT_GREATER_EQUAL,
+    INT_EQUAL, INT_NOT_EQUAL,
+    DOUBLE_ADD, DOUBLE_SUB, DOUBLE_MUL, DOUBLE_DIV,
+    DOUBLE_LESS, DOUBLE_LESS_EQUAL, DOUBLE_GREATER, DOUBLE_GREATER_EQUAL,
+    DOUBLE_EQUAL, DOUBLE_NOT_EQUAL,
+    STRING_CONCAT, STRING_EQUAL, STRING_NOT_EQUAL,
+    BOOL_AND, BOOL_OR
+  };
+  QuickOp quick_op = INT_ADD;   // the specialized operation
+  // visitor access
+  void accept(Visitor& v) {v.visit(*this);}
+};
+
+
 class SimpleTerm : public ExprTerm
 {
 public:
@@ -188,6 +220,10 @@ public:
   Token id;                                // function name
   std::list<FunParam> params;              // function params
   std::list<Stmt*> stmts;                  // function body
+  // with lazy parsing, the body's tokens (through its END) until the
+  // first call parses it (see lazy_bodies.h)
+  std::vector<Token> body_tokens;
+  std::atomic<bool> skimmed{false};
   // cleanup memory
   ~FunDecl() {for (Stmt* s : stmts) delete s;}
   // visitor access
@@ -294,10 +330,21 @@ public:
 class ForStmt : public Stmt
 {
 public:
+  // a reduction clause of a parallel for (e.g., reduce sum total)
+  struct Reduction
+  {
+    Token op;                   // sum, min, or max
+    Token var_id;               // the reduced variable
+  };
   Token var_id;                 // loop variable
   Expr* start;                  // loop start expression
   Expr* end;                    // loop end expression
   std::list<Stmt*> stmts;       // loop body
+  bool parallel = false;        // iterations may run concurrently
+  std::list<Reduction> reductions;
+  // variables from enclosing scopes the body reads (set by the type
+  // checker for parallel loops)
+  std::list<std::string> captures;
   // cleanup memory
   ~ForStmt() {delete start; delete end; for (Stmt* s : stmts) delete s;}
   // visitor access
@@ -360,6 +407,11 @@ class NewRValue : public RValue
 {
 public:
   Token type_id;                // type name being instantiated
+  Expr* capacity = nullptr;     // channel capacity (new channel<T>(n))
+  bool spsc = false;            // channel with one sender and one receiver
+                                // (set by the type checker)
+  // cleanup memory
+  ~NewRValue() {delete capacity;}
   // return first token
   Token first_token() {return type_id;}
   // visitor access
@@ -372,6 +424,7 @@ class CallExpr : public RValue, public Stmt
 public:
   Token function_id;            // function name being called
   std::list<Expr*> arg_list;    // call arguments
+  bool spawn = false;           // run as a task (spawn f(...))
   // cleanup memory
   ~CallExpr() {for(Expr* e : arg_list) delete e;}
   // return first token
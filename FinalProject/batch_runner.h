@@ -0,0 +1,175 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: batch_runner.h
+// DATE: Spring 2021
+// DESC: Runs one MyPL program over many input files (mypl --batch).
+//       The program is lexed, parsed, and type checked once; worker
+//       threads then take the inputs in turn and run the program in its
+//       own execution context (see mypl_api.h), with read bound to the
+//       input file and print to the input's output file. Each output
+//       file holds what the program printed, followed by the error
+//       message if the run failed, just as mypl would print them.
+//----------------------------------------------------------------------
+
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <limits.h>
+#include <stdlib.h>
+#include "mypl_api.h"
+
+
+class BatchRunner
+{
+public:
+
+  // runs on the given number of threads (0 for one per available core);
+  // outputs go next to their inputs (INPUT.out) unless out_dir is given
+  BatchRunner(int threads, const std::string& out_dir)
+    : threads(threads), out_dir(out_dir) {}
+
+  // compile the program and run it over each input; returns 0 if every
+  // run returned 0, and otherwise 1. Front-end errors, inputs that would
+  // share an output file or that are another input's output file
+  // (nothing is run then), and runs that fail are reported on err.
+  int run(const std::string& program_file, const std::vector<std::string>& inputs,
+          std::ostream& err);
+
+  // the output file for an input
+  std::string output_file(const std::string& input) const;
+
+private:
+  int threads;
+  std::string out_dir;
+
+  // the resolved path of a file that exists, and otherwise the path
+  static std::string canonical(const std::string& path);
+};
+
+
+std::string BatchRunner::canonical(const std::string& path)
+{
+  char resolved[PATH_MAX];
+  return realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+}
+
+
+std::string BatchRunner::output_file(const std::string& input) const
+{
+  if (out_dir == "")
+    return input + ".out";
+  size_t slash = input.find_last_of('/');
+  std::string base = slash == std::string::npos ? input : input.substr(slash + 1);
+  return out_dir + "/" + base + ".out";
+}
+
+
+int BatchRunner::run(const std::string& program_file, const std::vector<std::string>& inputs,
+                     std::ostream& err)
+{
+  // two inputs with the same name in different directories would
+  // overwrite each other's output in out_dir
+  std::map<std::string, std::string> outputs;
+  for (const std::string& input : inputs) {
+    auto added = outputs.insert({output_file(input), input});
+    if (!added.second) {
+      err << "inputs " << added.first->second << " and " << input << " have the same output file "
+          << added.first->first << std::endl;
+      return 1;
+    }
+  }
+
+  // an input that is also an output (e.g., a.out left next to a by an
+  // earlier run) would be truncated while another run reads it; such an
+  // output exists, so comparing resolved paths catches every spelling
+  std::map<std::string, std::string> resolved_outputs;
+  for (const auto& output : outputs)
+    resolved_outputs[canonical(output.first)] = output.second;
+  for (const std::string& input : inputs) {
+    auto found = resolved_outputs.find(canonical(input));
+    if (found != resolved_outputs.end()) {
+      err << "input " << input << " is the output file of input " << found->second << std::endl;
+      return 1;
+    }
+  }
+
+  CompiledProgram* program;
+  std::ifstream source(program_file);
+  if (!source) {
+    err << "cannot open " << program_file << std::endl;
+    return 1;
+  }
+  try {
+    program = CompiledProgram::compile(source);
+  }
+  catch (MyPLException& e) {
+    err << e.to_string() << std::endl;
+    return 1;
+  }
+
+  int count = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+  count = std::min(count, (int)inputs.size());
+  std::atomic<size_t> next(0);
+  std::atomic<int> failures(0);
+  std::mutex err_lock;
+  auto report = [&](const std::string& msg) {
+    std::lock_guard<std::mutex> guard(err_lock);
+    err << msg << std::endl;
+  };
+
+  auto worker = [&]() {
+    for (size_t i = next++; i < inputs.size(); i = next++) {
+      const std::string& input = inputs[i];
+      std::ifstream in(input);
+      if (!in) {
+        report("cannot open " + input);
+        ++failures;
+        continue;
+      }
+      std::ofstream out(output_file(input));
+      if (!out) {
+        report("cannot write " + output_file(input));
+        ++failures;
+        continue;
+      }
+      int code;
+      try {
+        ExecutionContext context(*program, in, out);
+        code = context.run();
+      }
+      catch (MyPLException& e) {
+        out << e.to_string() << std::endl;
+        code = 1;
+      }
+      catch (std::exception& e) {
+        // e.g., stoi of a malformed input; only this run fails
+        out << e.what() << std::endl;
+        code = 1;
+      }
+      if (code != 0) {
+        report(input + ": exit " + std::to_string(code));
+        ++failures;
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int t = 1; t < count; ++t)
+    workers.push_back(std::thread(worker));
+  worker();
+  for (std::thread& t : workers)
+    t.join();
+
+  delete program;
+  return failures.load() == 0 ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,124 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: embed_bench.cpp
+// DATE: Spring 2021
+// DESC: Runs a MyPL program through the embedding API (mypl_api.h):
+//       compiles it once, then runs it in many execution contexts
+//       spread over several threads, each with its own input and
+//       output. Every run's output is checked against a run of the same
+//       input on the main thread, and the runs per second are reported.
+//       Without a file, a small built-in rule script is used (see
+//       embed_rules.h); run i reads the line "i" followed by the
+//       contents of --input.
+//
+// usage: embed_bench [--threads N] [--runs N] [--input FILE] [FILE]
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../mypl_api.h"
+#include "embed_rules.h"
+using namespace std;
+
+
+struct Outcome
+{
+  string output;
+  int code = 0;
+  string error;
+  bool operator==(const Outcome& rhs) const
+  {
+    return output == rhs.output and code == rhs.code and error == rhs.error;
+  }
+};
+
+
+Outcome run_once(const CompiledProgram& program, const string& input)
+{
+  Outcome outcome;
+  istringstream in(input);
+  ostringstream out;
+  ExecutionContext context(program, in, out);
+  try {
+    outcome.code = context.run();
+  }
+  catch (MyPLException& e) {
+    outcome.error = e.to_string();
+  }
+  outcome.output = out.str();
+  return outcome;
+}
+
+
+int main(int argc, char* argv[])
+{
+  int threads = max(1u, thread::hardware_concurrency());
+  int runs = 10000;
+  string input_file = "";
+  string file_name = "";
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--threads" and i + 1 < argc)
+      threads = max(1, stoi(argv[++i]));
+    else if (arg == "--runs" and i + 1 < argc)
+      runs = max(1, stoi(argv[++i]));
+    else if (arg == "--input" and i + 1 < argc)
+      input_file = argv[++i];
+    else
+      file_name = arg;
+  }
+
+  string extra_input = "";
+  if (input_file != "") {
+    ifstream file(input_file);
+    extra_input.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+  }
+
+  CompiledProgram* program;
+  auto compile_start = chrono::steady_clock::now();
+  try {
+    program = compile_rules(file_name);
+  }
+  catch (MyPLException& e) {
+    printf("%s\n", e.to_string().c_str());
+    return 1;
+  }
+  double compile_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - compile_start).count();
+
+  // the expected outcome of each distinct input, from the main thread
+  const int distinct = 100;
+  vector<string> inputs;
+  vector<Outcome> expected;
+  for (int i = 0; i < distinct; ++i) {
+    inputs.push_back(to_string(i) + "\n" + extra_input);
+    expected.push_back(run_once(*program, inputs.back()));
+  }
+
+  atomic<int> next(0);
+  atomic<int> mismatches(0);
+  auto start = chrono::steady_clock::now();
+  vector<thread> workers;
+  for (int t = 0; t < threads; ++t)
+    workers.push_back(thread([&]() {
+        for (int i = next++; i < runs; i = next++)
+          if (!(run_once(*program, inputs[i % distinct]) == expected[i % distinct]))
+            ++mismatches;
+      }));
+  for (thread& w : workers)
+    w.join();
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  printf("compile: %.3f ms\n", compile_ms);
+  printf("runs:    %d on %d threads in %.3f s (%.0f runs/s, %.1f us/run)\n",
+         runs, threads, secs, runs / secs, secs * 1e6 / runs);
+  printf("output mismatches: %d\n", mismatches.load());
+  delete program;
+  return mismatches.load() == 0 ? 0 : 1;
+}
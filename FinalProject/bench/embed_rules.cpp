@@ -0,0 +1,55 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: embed_rules.cpp
+// DATE: Spring 2021
+// DESC: The rule script embed_bench runs (see embed_rules.h)
+//----------------------------------------------------------------------
+
+#include <fstream>
+#include <iterator>
+#include "embed_rules.h"
+using namespace std;
+
+
+// decides on an order from its id (read from the input)
+const char* DEFAULT_RULES = R"(
+type Order
+  var id = 0
+  var amount = 0
+  var priority = false
+end
+
+fun Order make_order (id:int)
+  var o = new Order
+  o.id = id
+  o.amount = (id * 37) % 1000
+  o.priority = (id % 7) == 0
+  return o
+end
+
+fun string decide (o:Order)
+  if o.priority then
+    return "expedite"
+  elseif o.amount > 900 then
+    return "review"
+  end
+  return "accept"
+end
+
+fun int main()
+  var o = make_order(stoi(read()))
+  print(itos(o.id) + ": " + decide(o))
+  return o.amount % 2
+end
+)";
+
+
+CompiledProgram* compile_rules(const string& file_name)
+{
+  string source = DEFAULT_RULES;
+  if (file_name != "") {
+    ifstream file(file_name);
+    source.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+  }
+  return CompiledProgram::compile(source);
+}
@@ -0,0 +1,22 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: embed_rules.h
+// DATE: Spring 2021
+// DESC: The rule script embed_bench runs. It is compiled in its own
+//       translation unit (embed_rules.cpp), which also includes
+//       mypl_api.h, so building embed_bench checks that the API links
+//       into a program from more than one source file.
+//----------------------------------------------------------------------
+
+#ifndef EMBED_RULES_H
+#define EMBED_RULES_H
+
+#include <string>
+#include "../mypl_api.h"
+
+
+// compile the rules in the given file, or the built-in rules if the name
+// is empty (the caller owns the result); throws a MyPLException
+CompiledProgram* compile_rules(const std::string& file_name);
+
+#endif
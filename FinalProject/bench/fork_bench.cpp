@@ -0,0 +1,169 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: fork_bench.cpp
+// DATE: Spring 2021
+// DESC: Startup latency of a MyPL program three ways: a cold mypl
+//       process (exec, front end, run), a request to a compile daemon
+//       (mypl --serve, see compile_server.h), and a dispatch through a
+//       fork server that has the program loaded (mypl --fork-server,
+//       see fork_server.h). Each request is timed from the moment it
+//       is made until its exit code is back; the program reads from
+//       and writes to /dev/null. Reports the median and p95 latency.
+//
+// usage: fork_bench [--runs N] [--mypl PATH] [PROGRAM]
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "../fork_server.h"
+using namespace std;
+
+
+// the value at the given fraction of the sorted values
+double percentile(vector<double> values, double fraction)
+{
+  sort(values.begin(), values.end());
+  size_t i = (size_t)(fraction * values.size() + 0.999999);
+  return values[min(values.size(), max<size_t>(i, 1)) - 1];
+}
+
+
+// start mypl with the arguments and standard streams on /dev/null
+pid_t start_mypl(const string& mypl, vector<string> args)
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    int null = open("/dev/null", O_RDWR);
+    dup2(null, 0);
+    dup2(null, 1);
+    dup2(null, 2);
+    vector<char*> argv;
+    argv.push_back((char*)mypl.c_str());
+    for (string& a : args)
+      argv.push_back((char*)a.c_str());
+    argv.push_back(nullptr);
+    execv(mypl.c_str(), argv.data());
+    _exit(127);
+  }
+  return pid;
+}
+
+
+// wait for a server to create its socket
+bool wait_for(const string& socket)
+{
+  for (int i = 0; i < 100; ++i) {
+    int fd = CompileServer::connect_to(socket);
+    if (fd >= 0) {
+      close(fd);
+      return true;
+    }
+    usleep(50000);
+  }
+  return false;
+}
+
+
+// time runs calls of request (which returns the exit code)
+vector<double> time_requests(int runs, const function<int()>& request, int& code)
+{
+  vector<double> us;
+  for (int i = 0; i < runs; ++i) {
+    auto start = chrono::steady_clock::now();
+    code = request();
+    us.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+  }
+  return us;
+}
+
+
+int main(int argc, char* argv[])
+{
+  int runs = 200;
+  string mypl = "./mypl";
+  string program = "tests/hello.mypl";
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--runs" and i + 1 < argc)
+      runs = max(1, stoi(argv[++i]));
+    else if (arg == "--mypl" and i + 1 < argc)
+      mypl = argv[++i];
+    else
+      program = arg;
+  }
+  char resolved[PATH_MAX];
+  if (!realpath(program.c_str(), resolved)) {
+    printf("cannot open %s\n", program.c_str());
+    return 1;
+  }
+  program = resolved;
+
+  char dir_template[] = "/tmp/fork_bench.XXXXXX";
+  string dir = mkdtemp(dir_template);
+  string serve_socket = dir + "/serve.sock";
+  string fork_socket = dir + "/fork.sock";
+  pid_t daemon = start_mypl(mypl, {"--serve", serve_socket});
+  pid_t fork_server = start_mypl(mypl, {"--fork-server", fork_socket, program});
+  if (!wait_for(serve_socket) or !wait_for(fork_socket)) {
+    printf("servers did not start\n");
+    kill(daemon, SIGTERM);
+    kill(fork_server, SIGTERM);
+    return 1;
+  }
+  int null = open("/dev/null", O_RDWR);
+
+  int cold_code;
+  vector<double> cold = time_requests(runs, [&]() {
+      pid_t pid = start_mypl(mypl, {program});
+      int status;
+      waitpid(pid, &status, 0);
+      return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }, cold_code);
+
+  int daemon_code;
+  vector<double> served = time_requests(runs, [&]() {
+      int fd = CompileServer::connect_to(serve_socket);
+      string out, err, code = "-1";
+      CompileServer::write_frame(fd, program) and CompileServer::write_frame(fd, "")
+        and CompileServer::read_frame(fd, out) and CompileServer::read_frame(fd, err)
+        and CompileServer::read_frame(fd, code);
+      close(fd);
+      return stoi(code);
+    }, daemon_code);
+
+  int fork_code;
+  vector<double> forked = time_requests(runs, [&]() {
+      int fd = CompileServer::connect_to(fork_socket);
+      string code = "-1";
+      ForkServer::send_request(fd, program, null, null, null)
+        and CompileServer::read_frame(fd, code);
+      close(fd);
+      return stoi(code);
+    }, fork_code);
+
+  kill(daemon, SIGTERM);
+  kill(fork_server, SIGTERM);
+  waitpid(daemon, nullptr, 0);
+  waitpid(fork_server, nullptr, 0);
+  unlink(serve_socket.c_str());
+  unlink(fork_socket.c_str());
+  rmdir(dir.c_str());
+
+  printf("%-24s %12s %12s %6s\n", "startup", "median (us)", "p95 (us)", "exit");
+  printf("%-24s %12.1f %12.1f %6d\n", "cold mypl process", percentile(cold, 0.5),
+         percentile(cold, 0.95), cold_code);
+  printf("%-24s %12.1f %12.1f %6d\n", "compile daemon request", percentile(served, 0.5),
+         percentile(served, 0.95), daemon_code);
+  printf("%-24s %12.1f %12.1f %6d\n", "fork server dispatch", percentile(forked, 0.5),
+         percentile(forked, 0.95), fork_code);
+  return cold_code == daemon_code and cold_code == fork_code ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: frontend_bench.cpp
+// DATE: Spring 2021
+// DESC: Front-end scaling harness. For each program shape and size it
+//       generates a synthetic program (see program_generator.h) and
+//       times the Lexer (to a token vector), Parser::parse, and the
+//       TypeChecker separately. Each phase is reported in ms and ns per
+//       line; a per-line cost that grows with the program size (the
+//       "growth" column, relative to the smallest size) points at
+//       superlinear behavior. With --threads N, declarations are
+//       parsed and function bodies type checked on a pool of N threads
+//       (mypl --parallel-decls).
+//
+// usage: frontend_bench [--sizes N,N,...] [--shapes S,S,...] [--threads N]
+//   shapes: mixed, functions, nesting, exprs, types, strings
+//----------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../lexer.h"
+#include "../parser.h"
+#include "../type_checker.h"
+#include "program_generator.h"
+using namespace std;
+
+
+typedef chrono::steady_clock Clock;
+
+
+double ms_since(Clock::time_point start)
+{
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+
+vector<string> split(const string& list)
+{
+  vector<string> items;
+  stringstream in(list);
+  for (string item; getline(in, item, ','); )
+    if (!item.empty())
+      items.push_back(item);
+  return items;
+}
+
+
+int main(int argc, char* argv[])
+{
+  vector<string> sizes = {"1000", "10000", "100000"};
+  vector<string> shapes = {"mixed", "functions", "nesting", "exprs", "types", "strings"};
+  int threads = 0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    string arg = argv[i];
+    if (arg == "--sizes")
+      sizes = split(argv[i + 1]);
+    else if (arg == "--shapes")
+      shapes = split(argv[i + 1]);
+    else if (arg == "--threads")
+      threads = stoi(argv[i + 1]);
+    else {
+      fprintf(stderr, "unknown option '%s'\n", arg.c_str());
+      return 1;
+    }
+  }
+
+  ThreadPool* pool = threads > 0 ? new ThreadPool(threads) : nullptr;
+  printf("%-10s %9s %10s | %10s %8s %7s | %10s %8s %7s | %10s %8s %7s\n",
+         "shape", "lines", "tokens", "lex ms", "ns/line", "growth",
+         "parse ms", "ns/line", "growth", "check ms", "ns/line", "growth");
+  for (const string& shape : shapes) {
+    double base[3] = {0, 0, 0};
+    for (const string& size : sizes) {
+      GeneratorOptions options;
+      if (!options.set_shape(shape)) {
+        fprintf(stderr, "unknown shape '%s'\n", shape.c_str());
+        return 1;
+      }
+      options.lines = stol(size);
+      stringstream source;
+      long lines = ProgramGenerator(options).generate(source);
+
+      double ms[3];
+      vector<Token> tokens;
+      Program ast_root_node;
+      try {
+        Clock::time_point start = Clock::now();
+        Lexer lexer(source);
+        tokens.push_back(lexer.next_token());
+        while (tokens.back().type() != EOS)
+          tokens.push_back(lexer.next_token());
+        ms[0] = ms_since(start);
+        size_t token_count = tokens.size();
+
+        start = Clock::now();
+        Parser parser(std::move(tokens));
+        if (pool)
+          parser.parse(ast_root_node, *pool);
+        else
+          parser.parse(ast_root_node);
+        ms[1] = ms_since(start);
+
+        start = Clock::now();
+        TypeChecker type_checker;
+        if (pool)
+          type_checker.enable_parallel(*pool);
+        ast_root_node.accept(type_checker);
+        ms[2] = ms_since(start);
+
+        double ns_per_line[3];
+        for (int i = 0; i < 3; ++i) {
+          ns_per_line[i] = 1e6 * ms[i] / lines;
+          if (base[i] == 0)
+            base[i] = ns_per_line[i];
+        }
+        printf("%-10s %9ld %10zu | %10.1f %8.0f %6.2fx | %10.1f %8.0f %6.2fx | "
+               "%10.1f %8.0f %6.2fx\n", shape.c_str(), lines, token_count,
+               ms[0], ns_per_line[0], ns_per_line[0] / base[0],
+               ms[1], ns_per_line[1], ns_per_line[1] / base[1],
+               ms[2], ns_per_line[2], ns_per_line[2] / base[2]);
+        fflush(stdout);
+      }
+      catch (MyPLException& e) {
+        fprintf(stderr, "%s (%s program of %ld lines)\n", e.to_string().c_str(),
+                shape.c_str(), lines);
+        return 1;
+      }
+    }
+  }
+  delete pool;
+  return 0;
+}
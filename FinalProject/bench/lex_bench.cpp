@@ -0,0 +1,138 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: lex_bench.cpp
+// DATE: Spring 2021
+// DESC: Scaling of the parallel lexer (see parallel_lexer.h). Generates
+//       a synthetic program (see program_generator.h), lexes it once
+//       with the sequential Lexer, then with a ParallelLexer on pools of
+//       1 to N threads. Each parallel result must match the sequential
+//       tokens (type, lexeme, line, and column); the best of several
+//       runs is reported with the speedup over the sequential Lexer.
+//
+// usage: lex_bench [--lines N] [--shape S] [--threads N,N,...] [--runs N]
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../parallel_lexer.h"
+#include "program_generator.h"
+using namespace std;
+
+
+typedef chrono::steady_clock Clock;
+
+
+double ms_since(Clock::time_point start)
+{
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+
+bool same_tokens(const vector<Token>& a, const vector<Token>& b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i)
+    if (a[i].type() != b[i].type() or a[i].lexeme() != b[i].lexeme()
+        or a[i].line() != b[i].line() or a[i].column() != b[i].column())
+      return false;
+  return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+  GeneratorOptions options;
+  options.lines = 1000000;
+  int runs = 3;
+  vector<int> thread_counts;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    string arg = argv[i];
+    string val = argv[i + 1];
+    if (arg == "--lines")
+      options.lines = stol(val);
+    else if (arg == "--shape") {
+      if (!options.set_shape(val)) {
+        fprintf(stderr, "unknown shape '%s'\n", val.c_str());
+        return 1;
+      }
+    }
+    else if (arg == "--runs")
+      runs = max(1, stoi(val));
+    else if (arg == "--threads") {
+      stringstream in(val);
+      for (string item; getline(in, item, ','); )
+        if (!item.empty())
+          thread_counts.push_back(max(1, stoi(item)));
+    }
+    else {
+      fprintf(stderr, "unknown option '%s'\n", arg.c_str());
+      return 1;
+    }
+  }
+  // 1, 2, 4, ... up to the number of cores
+  if (thread_counts.empty()) {
+    int cores = max(1u, thread::hardware_concurrency());
+    for (int n = 1; n < cores; n *= 2)
+      thread_counts.push_back(n);
+    thread_counts.push_back(cores);
+  }
+
+  stringstream generated;
+  long lines = ProgramGenerator(options).generate(generated);
+  string source = generated.str();
+
+  vector<Token> expected;
+  double sequential = 0;
+  try {
+    for (int r = 0; r < runs; ++r) {
+      istringstream in(source);
+      Clock::time_point start = Clock::now();
+      Lexer lexer(in);
+      vector<Token> tokens;
+      do
+        tokens.push_back(lexer.next_token());
+      while (tokens.back().type() != EOS);
+      double ms = ms_since(start);
+      if (r == 0 or ms < sequential)
+        sequential = ms;
+      expected = std::move(tokens);
+    }
+  }
+  catch (MyPLException& e) {
+    fprintf(stderr, "%s\n", e.to_string().c_str());
+    return 1;
+  }
+  printf("%ld lines, %.1f MB, %zu tokens\n", lines, source.size() / 1e6, expected.size());
+  printf("%-12s %8s %10s %10s %9s\n", "lexer", "chunks", "ms", "MB/s", "speedup");
+  printf("%-12s %8d %10.1f %10.1f %8.2fx\n", "sequential", 1, sequential,
+         source.size() / 1e3 / sequential, 1.0);
+
+  int status = 0;
+  for (int n : thread_counts) {
+    ThreadPool pool(n);
+    ParallelLexer lexer(pool);
+    double best = 0;
+    bool same = true;
+    for (int r = 0; r < runs; ++r) {
+      Clock::time_point start = Clock::now();
+      vector<Token> tokens = lexer.tokenize(source);
+      double ms = ms_since(start);
+      if (r == 0 or ms < best)
+        best = ms;
+      same = same and same_tokens(tokens, expected);
+    }
+    string name = to_string(n) + (n == 1 ? " thread" : " threads");
+    printf("%-12s %8zu %10.1f %10.1f %8.2fx%s\n", name.c_str(), lexer.chunk_count(), best,
+           source.size() / 1e3 / best, sequential / best, same ? "" : "  MISMATCH");
+    fflush(stdout);
+    if (!same)
+      status = 1;
+  }
+  return status;
+}
@@ -0,0 +1,298 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: micro_bench.cpp
+// DATE: Spring 2021
+// DESC: Microbenchmarks for the runtime core classes: DataObject,
+//       SymbolTable, Heap, Lexer, and Token. Each benchmark runs a
+//       batch of operations a few times to warm up, then repeats the
+//       batch and reports the median and minimum nanoseconds per
+//       operation.
+//
+// usage: micro_bench [--reps N] [--warmup N] [NAME-FILTER ...]
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../data_object.h"
+#include "../symbol_table.h"
+#include "../heap.h"
+#include "../lexer.h"
+using namespace std;
+
+
+// keeps the compiler from discarding a value computed by a benchmark
+template <typename T>
+void keep(const T& value)
+{
+  asm volatile("" : : "r"(&value) : "memory");
+}
+
+
+class MicroBench
+{
+public:
+
+  MicroBench(int reps, int warmup, const vector<string>& filters)
+    : reps(reps), warmup(warmup), filters(filters)
+  {
+    printf("%-40s %12s %12s %12s\n", "benchmark", "ops/rep", "median ns/op", "min ns/op");
+  }
+
+  // time body(), which performs ops operations per call
+  void run(const string& name, long ops, const function<void()>& body)
+  {
+    if (!selected(name))
+      return;
+    for (int i = 0; i < warmup; ++i)
+      body();
+    vector<double> ns_per_op;
+    for (int i = 0; i < reps; ++i) {
+      auto start = chrono::steady_clock::now();
+      body();
+      auto end = chrono::steady_clock::now();
+      ns_per_op.push_back(chrono::duration<double, nano>(end - start).count() / ops);
+    }
+    sort(ns_per_op.begin(), ns_per_op.end());
+    printf("%-40s %12ld %12.2f %12.2f\n", name.c_str(), ops,
+           ns_per_op[ns_per_op.size() / 2], ns_per_op[0]);
+    fflush(stdout);
+  }
+
+private:
+  int reps;
+  int warmup;
+  vector<string> filters;
+
+  bool selected(const string& name) const
+  {
+    if (filters.empty())
+      return true;
+    for (const string& f : filters)
+      if (name.find(f) != string::npos)
+        return true;
+    return false;
+  }
+};
+
+
+//----------------------------------------------------------------------
+// DataObject
+//----------------------------------------------------------------------
+
+template <typename T>
+void data_object_benches(MicroBench& bench, const string& type, T value)
+{
+  const long N = 100000;
+  bench.run("DataObject/" + type + "/construct", N, [&]() {
+      for (long i = 0; i < N; ++i) {
+        DataObject d(value);
+        keep(d);
+      }
+    });
+  bench.run("DataObject/" + type + "/set", N, [&]() {
+      DataObject d;
+      for (long i = 0; i < N; ++i)
+        d.set(value);
+      keep(d);
+    });
+  bench.run("DataObject/" + type + "/copy", N, [&]() {
+      DataObject src(value);
+      DataObject dst;
+      for (long i = 0; i < N; ++i)
+        dst = src;
+      keep(dst);
+    });
+  bench.run("DataObject/" + type + "/value", N, [&]() {
+      DataObject d(value);
+      T v;
+      for (long i = 0; i < N; ++i)
+        d.value(v);
+      keep(v);
+    });
+}
+
+
+//----------------------------------------------------------------------
+// SymbolTable
+//----------------------------------------------------------------------
+
+void symbol_table_benches(MicroBench& bench)
+{
+  const long N = 20000;
+  bench.run("SymbolTable/push+pop", N, [&]() {
+      SymbolTable table;
+      for (long i = 0; i < N; ++i) {
+        table.push_environment();
+        table.pop_environment();
+      }
+    });
+  bench.run("SymbolTable/add_name+set_val_info", N, [&]() {
+      SymbolTable table;
+      table.push_environment();
+      DataObject val(1);
+      for (long i = 0; i < N; ++i) {
+        table.add_name("x");
+        table.set_val_info("x", val);
+      }
+      table.pop_environment();
+    });
+  // a lookup of a name declared depth environments further out
+  for (int depth : {1, 4, 16, 64}) {
+    SymbolTable table;
+    table.push_environment();
+    table.add_name("x");
+    table.set_val_info("x", DataObject(42));
+    for (int i = 1; i < depth; ++i) {
+      table.push_environment();
+      table.add_name("y" + to_string(i));
+      table.set_val_info("y" + to_string(i), DataObject(i));
+    }
+    bench.run("SymbolTable/get_val_info/depth=" + to_string(depth), N, [&]() {
+        DataObject val;
+        for (long i = 0; i < N; ++i)
+          table.get_val_info("x", val);
+        keep(val);
+      });
+    bench.run("SymbolTable/get_val_slot/depth=" + to_string(depth), N, [&]() {
+        DataObject* slot = nullptr;
+        for (long i = 0; i < N; ++i)
+          slot = table.get_val_slot("x");
+        keep(slot);
+      });
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Heap
+//----------------------------------------------------------------------
+
+void heap_benches(MicroBench& bench)
+{
+  const long N = 10000;
+  for (int fields : {1, 4, 16}) {
+    HeapObject obj;
+    for (int i = 0; i < fields; ++i)
+      obj.set_att("f" + to_string(i), DataObject(i));
+    string suffix = "/fields=" + to_string(fields);
+    bench.run("Heap/set_obj" + suffix, N, [&]() {
+        Heap heap;
+        for (long i = 0; i < N; ++i)
+          heap.set_obj(i, obj);
+        keep(heap);
+      });
+    Heap heap;
+    for (long i = 0; i < N; ++i)
+      heap.set_obj(i, obj);
+    bench.run("Heap/get_obj" + suffix, N, [&]() {
+        HeapObject copy;
+        for (long i = 0; i < N; ++i)
+          heap.get_obj(i, copy);
+        keep(copy);
+      });
+    bench.run("Heap/get_obj_slot+get_val" + suffix, N, [&]() {
+        DataObject val;
+        for (long i = 0; i < N; ++i)
+          heap.get_obj_slot(i)->get_val("f0", val);
+        keep(val);
+      });
+  }
+}
+
+
+//----------------------------------------------------------------------
+// Lexer and Token
+//----------------------------------------------------------------------
+
+// a synthetic program of the given number of lines, mixing the token
+// kinds of typical MyPL code
+string synthetic_source(int lines)
+{
+  const char* patterns[] = {
+    "var x%d: int = (a * 3) + %d\n",
+    "if x%d >= %d then print(\"value\") end\n",
+    "while i < %d do i = i + 1.5 end # %d\n",
+    "fun int f%d(n: int, s: string) return get(%d, s) end\n",
+  };
+  string source;
+  char buf[128];
+  for (int i = 0; i < lines; ++i) {
+    snprintf(buf, sizeof(buf), patterns[i % 4], i, i * 7);
+    source += buf;
+  }
+  return source;
+}
+
+
+void lexer_benches(MicroBench& bench)
+{
+  string source = synthetic_source(200);
+  long tokens = 0;
+  {
+    stringstream in(source);
+    Lexer lexer(in);
+    while (lexer.next_token().type() != EOS)
+      ++tokens;
+  }
+  bench.run("Lexer/next_token", tokens, [&]() {
+      stringstream in(source);
+      Lexer lexer(in);
+      while (lexer.next_token().type() != EOS)
+        ;
+    });
+
+  const long N = 2000;
+  bench.run("Token/construct", N, [&]() {
+      for (long i = 0; i < N; ++i) {
+        Token t(ID, "identifier", 10, 4);
+        keep(t);
+      }
+    });
+  Token token(STRING_VAL, "a string value", 10, 4);
+  bench.run("Token/copy", N, [&]() {
+      for (long i = 0; i < N; ++i) {
+        Token t = token;
+        keep(t);
+      }
+    });
+  bench.run("Token/lexeme", N, [&]() {
+      for (long i = 0; i < N; ++i) {
+        string s = token.lexeme();
+        keep(s);
+      }
+    });
+}
+
+
+int main(int argc, char* argv[])
+{
+  int reps = 15;
+  int warmup = 3;
+  vector<string> filters;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--reps" and i + 1 < argc)
+      reps = max(1, stoi(argv[++i]));
+    else if (arg == "--warmup" and i + 1 < argc)
+      warmup = max(0, stoi(argv[++i]));
+    else
+      filters.push_back(arg);
+  }
+
+  MicroBench bench(reps, warmup, filters);
+  data_object_benches(bench, "int", 42);
+  data_object_benches(bench, "double", 3.14);
+  data_object_benches(bench, "string", string("a short string"));
+  data_object_benches(bench, "char", 'c');
+  data_object_benches(bench, "bool", true);
+  data_object_benches(bench, "oid", (size_t)7);
+  symbol_table_benches(bench);
+  heap_benches(bench);
+  lexer_benches(bench);
+  return 0;
+}
@@ -0,0 +1,300 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: mypl_bench.cpp
+// DATE: Spring 2021
+// DESC: Benchmark runner for the programs in bench/. Each program is
+//       run N times as a separate mypl process (stdin from NAME.input
+//       if present); the runner reports the median and p95 wall time,
+//       instructions retired (when perf counters are available), and
+//       peak RSS, checks the output against NAME.expected, and can
+//       write the results as JSON for tracking regressions. With
+//       --hw-counters it reports the median of each hardware counter
+//       (see hw_counters.h) and runs each program once more with
+//       --phase-stats to break the counters down by phase.
+//
+// usage: mypl_bench [--runs N] [--mypl PATH] [--json FILE]
+//                   [--args "MYPL ARGS"] [--hw-counters]
+//                   [bench/NAME.mypl ...]
+//----------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "../hw_counters.h"
+using namespace std;
+
+
+// measurements of one run
+struct Run
+{
+  double wall_ms = 0;
+  HwCounters::Values hw;
+  long max_rss_kb = 0;
+  int status = 0;
+  string output;
+  string errors;
+};
+
+
+// summary of all runs of one benchmark
+struct Result
+{
+  string name;
+  int runs = 0;
+  double median_ms = 0;
+  double p95_ms = 0;
+  HwCounters::Values median_hw;
+  long max_rss_kb = 0;
+  bool output_ok = true;
+  bool failed = false;
+  string phases;                // --phase-stats=json output, if collected
+};
+
+
+string read_file(const string& path)
+{
+  ifstream in(path);
+  stringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+
+bool file_exists(const string& path)
+{
+  return access(path.c_str(), R_OK) == 0;
+}
+
+
+// run mypl once on the program, capturing its output and errors
+Run run_once(const string& mypl, const vector<string>& args,
+             const string& program, const string& input)
+{
+  Run run;
+  int out_pipe[2];
+  int go_pipe[2];
+  FILE* errors = tmpfile();
+  if (pipe(out_pipe) != 0 or pipe(go_pipe) != 0 or !errors) {
+    run.status = -1;
+    return run;
+  }
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    // wait until the parent has attached the counter
+    char c;
+    close(go_pipe[1]);
+    if (read(go_pipe[0], &c, 1) < 0)
+      _exit(127);
+    int in = open(input.empty() ? "/dev/null" : input.c_str(), O_RDONLY);
+    dup2(in, 0);
+    dup2(out_pipe[1], 1);
+    dup2(fileno(errors), 2);
+    close(out_pipe[0]);
+    vector<char*> argv;
+    argv.push_back((char*)mypl.c_str());
+    for (const string& a : args)
+      argv.push_back((char*)a.c_str());
+    argv.push_back((char*)program.c_str());
+    argv.push_back(nullptr);
+    execv(mypl.c_str(), argv.data());
+    _exit(127);
+  }
+
+  close(go_pipe[0]);
+  close(out_pipe[1]);
+  HwCounters counters(pid, true);
+  auto start = chrono::steady_clock::now();
+  if (write(go_pipe[1], "x", 1) < 0)
+    run.status = -1;
+  close(go_pipe[1]);
+
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(out_pipe[0], buf, sizeof(buf))) > 0)
+    run.output.append(buf, n);
+  close(out_pipe[0]);
+
+  int status;
+  rusage usage;
+  wait4(pid, &status, 0, &usage);
+  auto end = chrono::steady_clock::now();
+  run.wall_ms = chrono::duration<double, milli>(end - start).count();
+  run.max_rss_kb = usage.ru_maxrss;
+  run.status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  run.hw = counters.read();
+  rewind(errors);
+  while ((n = fread(buf, 1, sizeof(buf), errors)) > 0)
+    run.errors.append(buf, n);
+  fclose(errors);
+  return run;
+}
+
+
+// the value at the given fraction of the sorted values
+template <typename T>
+T percentile(vector<T> values, double fraction)
+{
+  sort(values.begin(), values.end());
+  size_t i = (size_t)(fraction * values.size() + 0.999999);
+  return values[min(values.size(), max<size_t>(i, 1)) - 1];
+}
+
+
+// the bench/*.mypl programs, in name order
+vector<string> default_programs(const string& dir)
+{
+  vector<string> programs;
+  DIR* d = opendir(dir.c_str());
+  if (!d)
+    return programs;
+  while (dirent* entry = readdir(d)) {
+    string name = entry->d_name;
+    if (name.size() > 5 and name.substr(name.size() - 5) == ".mypl")
+      programs.push_back(dir + "/" + name);
+  }
+  closedir(d);
+  sort(programs.begin(), programs.end());
+  return programs;
+}
+
+
+string json_results(const vector<Result>& results, const string& args)
+{
+  stringstream s;
+  s << "{\"args\": \"" << args << "\", \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "%s\n  {\"name\": \"%s\", \"runs\": %d, \"median_ms\": %.3f, "
+             "\"p95_ms\": %.3f, \"max_rss_kb\": %ld, \"output_ok\": %s, "
+             "\"failed\": %s, ",
+             i > 0 ? "," : "", r.name.c_str(), r.runs, r.median_ms, r.p95_ms,
+             r.max_rss_kb, r.output_ok ? "true" : "false",
+             r.failed ? "true" : "false");
+    s << buf << HwCounters::json(r.median_hw);
+    if (!r.phases.empty())
+      s << ", \"phases\": " << r.phases;
+    s << "}";
+  }
+  s << "\n]}\n";
+  return s.str();
+}
+
+
+int main(int argc, char* argv[])
+{
+  int runs = 5;
+  string mypl = "./mypl";
+  string json_file = "";
+  string mypl_args = "";
+  bool hw_counters = false;
+  vector<string> programs;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--runs" and i + 1 < argc)
+      runs = max(1, stoi(argv[++i]));
+    else if (arg == "--mypl" and i + 1 < argc)
+      mypl = argv[++i];
+    else if (arg == "--json" and i + 1 < argc)
+      json_file = argv[++i];
+    else if (arg == "--args" and i + 1 < argc)
+      mypl_args = argv[++i];
+    else if (arg == "--hw-counters")
+      hw_counters = true;
+    else
+      programs.push_back(arg);
+  }
+  if (programs.empty())
+    programs = default_programs("bench");
+  if (programs.empty()) {
+    cerr << "no benchmark programs found (run from FinalProject or list them)" << endl;
+    return 1;
+  }
+
+  vector<string> args;
+  stringstream split(mypl_args);
+  for (string a; split >> a; )
+    args.push_back(a);
+
+  vector<Result> results;
+  bool all_ok = true;
+  printf("%-16s %5s %12s %12s %16s %10s  %s\n", "benchmark", "runs",
+         "median (ms)", "p95 (ms)", "instructions", "rss (KB)", "output");
+  for (const string& program : programs) {
+    string base = program.substr(0, program.size() - 5);
+    string input = file_exists(base + ".input") ? base + ".input" : "";
+    string expected = file_exists(base + ".expected") ? read_file(base + ".expected") : "";
+
+    Result result;
+    result.name = base.substr(base.find_last_of('/') + 1);
+    result.runs = runs;
+    vector<double> times;
+    vector<int64_t> counts[HwCounters::COUNT];
+    for (int i = 0; i < runs; ++i) {
+      Run run = run_once(mypl, args, program, input);
+      times.push_back(run.wall_ms);
+      for (int c = 0; c < HwCounters::COUNT; ++c)
+        if (run.hw.count[c] >= 0)
+          counts[c].push_back(run.hw.count[c]);
+      result.max_rss_kb = max(result.max_rss_kb, run.max_rss_kb);
+      if (run.status != 0 and !result.failed) {
+        result.failed = true;
+        cerr << result.name << ": " << run.errors;
+      }
+      if (i == 0 and !expected.empty() and run.output != expected)
+        result.output_ok = false;
+    }
+    result.median_ms = percentile(times, 0.5);
+    result.p95_ms = percentile(times, 0.95);
+    for (int c = 0; c < HwCounters::COUNT; ++c)
+      if (!counts[c].empty())
+        result.median_hw.count[c] = percentile(counts[c], 0.5);
+    if (hw_counters) {
+      // one more (untimed) run for the per-phase counts
+      vector<string> phase_args = args;
+      phase_args.push_back("--phase-stats=json");
+      phase_args.push_back("--hw-counters");
+      Run run = run_once(mypl, phase_args, program, input);
+      // keep the array of phases from {"phases": [...]}
+      size_t first = run.errors.find("{\"phases\": [");
+      size_t last = run.errors.rfind(']');
+      if (first != string::npos and last != string::npos and last > first)
+        result.phases = run.errors.substr(first + 11, last - first - 10);
+    }
+    all_ok = all_ok and result.output_ok and !result.failed;
+    results.push_back(result);
+
+    int64_t instructions = result.median_hw.count[HwCounters::INSTRUCTIONS];
+    string instr = instructions >= 0 ? to_string(instructions) : "n/a";
+    printf("%-16s %5d %12.3f %12.3f %16s %10ld  %s\n", result.name.c_str(),
+           runs, result.median_ms, result.p95_ms, instr.c_str(),
+           result.max_rss_kb,
+           result.failed ? "FAILED" : (result.output_ok ? "ok" : "MISMATCH"));
+    fflush(stdout);
+  }
+
+  if (hw_counters) {
+    printf("\n%-16s%s\n", "benchmark", HwCounters::header().c_str());
+    for (const Result& r : results)
+      printf("%-16s%s\n", r.name.c_str(), HwCounters::report(r.median_hw).c_str());
+  }
+
+  if (!json_file.empty()) {
+    ofstream out(json_file);
+    out << json_results(results, mypl_args);
+  }
+  return all_ok ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: mypl_gen.cpp
+// DATE: Spring 2021
+// DESC: Writes a synthetic MyPL program to standard output (see
+//       program_generator.h).
+//
+// usage: mypl_gen [--lines N] [--shape SHAPE] [--fields N]
+//                 [--fun-stmts N] [--nesting N] [--expr-terms N]
+//                 [--string-length N] [--type-share PERCENT]
+//----------------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include "program_generator.h"
+using namespace std;
+
+
+int main(int argc, char* argv[])
+{
+  GeneratorOptions options;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    string arg = argv[i];
+    string val = argv[i + 1];
+    if (arg == "--shape") {
+      if (!options.set_shape(val)) {
+        cerr << "unknown shape '" << val << "'" << endl;
+        return 1;
+      }
+    }
+    else if (arg == "--lines")
+      options.lines = stol(val);
+    else if (arg == "--fields")
+      options.fields = stoi(val);
+    else if (arg == "--fun-stmts")
+      options.fun_stmts = stoi(val);
+    else if (arg == "--nesting")
+      options.nesting = stoi(val);
+    else if (arg == "--expr-terms")
+      options.expr_terms = stoi(val);
+    else if (arg == "--string-length")
+      options.string_length = stoi(val);
+    else if (arg == "--type-share")
+      options.type_share = stoi(val);
+    else {
+      cerr << "unknown option '" << arg << "'" << endl;
+      return 1;
+    }
+  }
+  ProgramGenerator generator(options);
+  generator.generate(cout);
+  return 0;
+}
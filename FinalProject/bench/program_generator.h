@@ -0,0 +1,228 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: program_generator.h
+// DATE: Spring 2021
+// DESC: Generates valid (lexes, parses, and type checks) synthetic MyPL
+//       programs of a requested size and shape, for measuring how the
+//       front end scales. A program is a sequence of user-defined
+//       types followed by functions, each calling the one before it,
+//       and a main function; the options control how many types and
+//       fields there are, how long function bodies, expressions, and
+//       string literals are, and how deeply blocks nest.
+//----------------------------------------------------------------------
+
+#ifndef PROGRAM_GENERATOR_H
+#define PROGRAM_GENERATOR_H
+
+#include <ostream>
+#include <string>
+
+
+struct GeneratorOptions
+{
+  long lines = 1000;            // approximate program length
+  int type_share = 10;          // percent of the lines in type declarations
+  int fields = 8;               // fields per type
+  int fun_stmts = 20;           // statements per function body
+  int nesting = 3;              // depth of nested while/if blocks
+  int expr_terms = 6;           // terms in generated arithmetic expressions
+  int string_length = 16;       // characters in string literals
+
+  // set the options for a named shape (mixed, functions, nesting,
+  // exprs, types, or strings); returns false for an unknown shape
+  bool set_shape(const std::string& shape);
+};
+
+
+class ProgramGenerator
+{
+public:
+
+  ProgramGenerator(const GeneratorOptions& options) : options(options) {}
+
+  // write a program to out; returns the number of lines written
+  long generate(std::ostream& out);
+
+private:
+  GeneratorOptions options;
+  std::ostream* out = nullptr;
+  long lines = 0;
+  long types = 0;
+  long functions = 0;
+  long vars = 0;
+
+  void line(int indent, const std::string& text);
+  std::string expr(const std::string& var);
+  std::string string_literal();
+  void type_decl();
+  void fun_decl(long budget);
+  void block(int indent, int depth, long& budget);
+  void main_decl();
+};
+
+
+bool GeneratorOptions::set_shape(const std::string& shape)
+{
+  if (shape == "mixed")
+    return true;
+  if (shape == "functions") {
+    fun_stmts = 3;
+    nesting = 1;
+  }
+  else if (shape == "nesting") {
+    nesting = 60;
+    fun_stmts = 200;
+  }
+  else if (shape == "exprs")
+    expr_terms = 200;
+  else if (shape == "types") {
+    type_share = 90;
+    fields = 40;
+  }
+  else if (shape == "strings")
+    string_length = 2000;
+  else
+    return false;
+  return true;
+}
+
+
+void ProgramGenerator::line(int indent, const std::string& text)
+{
+  *out << std::string(2 * indent, ' ') << text << "\n";
+  ++lines;
+}
+
+
+// an int expression of the configured length over var, such as
+// (v * 3) + ((v - 1) + 7); kept right-nested to match the grammar
+std::string ProgramGenerator::expr(const std::string& var)
+{
+  std::string e;
+  for (int i = options.expr_terms - 1; i >= 0; --i) {
+    std::string term;
+    switch (i % 4) {
+      case 0: term = var; break;
+      case 1: term = "(" + var + " * " + std::to_string(i % 7 + 2) + ")"; break;
+      case 2: term = "(" + var + " - 1)"; break;
+      default: term = std::to_string(i); break;
+    }
+    e = e.empty() ? term : term + " + " + e;
+  }
+  return e;
+}
+
+
+std::string ProgramGenerator::string_literal()
+{
+  std::string s = "\"";
+  for (int i = 0; i < options.string_length; ++i)
+    s += (char)('a' + (i * 7 + vars) % 26);
+  return s + "\"";
+}
+
+
+void ProgramGenerator::type_decl()
+{
+  std::string name = "T" + std::to_string(types);
+  line(0, "type " + name);
+  for (int i = 0; i < options.fields; ++i) {
+    std::string field = "  var f" + std::to_string(i);
+    switch (i % 5) {
+      case 0: line(0, field + " = " + std::to_string(i)); break;
+      case 1: line(0, field + ": double = " + std::to_string(i) + ".5"); break;
+      case 2: line(0, field + " = " + string_literal()); break;
+      case 3: line(0, field + ": bool = true"); break;
+      default:
+        // a reference to an earlier type (or this one)
+        line(0, field + ": T" + std::to_string(types > 0 ? types - 1 : 0) + " = nil");
+    }
+  }
+  line(0, "end");
+  line(0, "");
+  ++types;
+}
+
+
+void ProgramGenerator::fun_decl(long budget)
+{
+  std::string name = "f" + std::to_string(functions);
+  line(0, "fun int " + name + "(n: int, s: string)");
+  line(1, "var r = n");
+  budget -= 4;
+  while (budget > 0)
+    block(1, options.nesting, budget);
+  if (functions > 0)
+    line(1, "r = r + f" + std::to_string(functions - 1) + "(n - 1, s)");
+  line(1, "return r");
+  line(0, "end");
+  line(0, "");
+  ++functions;
+}
+
+
+// statements at the given indentation, with blocks nested up to depth
+// levels, consuming budget lines
+void ProgramGenerator::block(int indent, int depth, long& budget)
+{
+  std::string v = "v" + std::to_string(vars++);
+  line(indent, "var " + v + " = " + expr("n"));
+  line(indent, "var " + v + "s = " + string_literal());
+  line(indent, "r = r + (" + v + " % 97) + length(" + v + "s)");
+  budget -= 3;
+  if (types > 0 and vars % 4 == 0) {
+    std::string t = "T" + std::to_string(vars % types);
+    line(indent, "var " + v + "o: " + t + " = new " + t);
+    line(indent, "r = r + " + v + "o.f0");
+    budget -= 2;
+  }
+  if (depth > 1 and budget > 0) {
+    if (vars % 2 == 0) {
+      line(indent, "while " + v + " < 0 do");
+      line(indent + 1, v + " = " + v + " + 1");
+      block(indent + 1, depth - 1, budget);
+      line(indent, "end");
+    }
+    else {
+      line(indent, "if " + v + " > (n * 1000) then");
+      block(indent + 1, depth - 1, budget);
+      line(indent, "elseif " + v + " == 0 then");
+      line(indent + 1, "r = r + 1");
+      line(indent, "else");
+      line(indent + 1, "r = r - 1");
+      line(indent, "end");
+      budget -= 4;
+    }
+    budget -= 2;
+  }
+}
+
+
+void ProgramGenerator::main_decl()
+{
+  line(0, "fun int main()");
+  if (functions > 0)
+    line(1, "print(itos(f" + std::to_string(functions - 1) + "(3, \"x\")))");
+  line(1, "print(\"\\n\")");
+  line(1, "return 0");
+  line(0, "end");
+}
+
+
+long ProgramGenerator::generate(std::ostream& output)
+{
+  out = &output;
+  lines = types = functions = vars = 0;
+  long type_lines = options.lines * options.type_share / 100;
+  while (lines < type_lines)
+    type_decl();
+  long fun_lines = options.fun_stmts * 3 + 8;
+  while (lines + fun_lines < options.lines - 4)
+    fun_decl(fun_lines);
+  if (functions == 0)
+    fun_decl(fun_lines);
+  main_decl();
+  return lines;
+}
+
+#endif
@@ -0,0 +1,254 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: channel.h
+// DATE: Spring 2021
+// DESC: Bounded channels for passing values between MyPL tasks. A
+//       channel the type checker has shown to have one sending and one
+//       receiving side is a lock-free single-producer/single-consumer
+//       ring; any other channel is a lock-free bounded multi-producer/
+//       multi-consumer queue (D. Vyukov's design, with a sequence
+//       number per cell). Senders wait while the channel is full and
+//       receivers while it is empty (tasks park, other threads block).
+//       Values are moved in and out of the channel rather than copied.
+//----------------------------------------------------------------------
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <atomic>
+#include <vector>
+#include "data_object.h"
+#include "scheduler.h"
+
+
+class Channel
+{
+public:
+
+  // a channel of the given capacity (at least 1); spsc selects the
+  // ring, which is only safe with one sender and one receiver
+  static Channel* create(size_t capacity, bool spsc);
+
+  virtual ~Channel() {}
+
+  // add the value (moving from it), waiting while the channel is full;
+  // false if the channel is closed
+  bool send(DataObject& value);
+
+  // take the next value, waiting while the channel is empty; false once
+  // the channel is closed and empty
+  bool recv(DataObject& value);
+
+  // take the next value if one is ready
+  bool try_recv(DataObject& value);
+
+  // end the channel: sends fail and receivers drain what is left
+  void close();
+
+  bool closed() const {return is_closed.load();}
+  size_t capacity() const {return cap;}
+
+  // the capacity of new channel<T> without one
+  static const int DEFAULT_CAPACITY = 16;
+
+protected:
+
+  explicit Channel(size_t capacity) : cap(capacity), is_closed(false) {}
+
+  // non-waiting operations of the queue implementations; push moves
+  // from value only when it succeeds
+  virtual bool push(DataObject& value) = 0;
+  virtual bool pop(DataObject& value) = 0;
+  virtual bool full() const = 0;
+  virtual bool empty() const = 0;
+
+  size_t cap;
+
+private:
+  std::atomic<bool> is_closed;
+  WaitQueue not_full;
+  WaitQueue not_empty;
+};
+
+
+// single-producer/single-consumer ring: the sender only writes tail and
+// the receiver only writes head
+class SpscChannel : public Channel
+{
+public:
+  explicit SpscChannel(size_t capacity)
+    : Channel(capacity), slots(capacity), head(0), tail(0) {}
+
+protected:
+  bool push(DataObject& value);
+  bool pop(DataObject& value);
+  bool full() const {return tail.load() - head.load() == cap;}
+  bool empty() const {return tail.load() == head.load();}
+
+private:
+  std::vector<DataObject> slots;
+  std::atomic<size_t> head;             // next slot to receive from
+  std::atomic<size_t> tail;             // next slot to send to
+};
+
+
+// multi-producer/multi-consumer queue: senders and receivers claim
+// positions with compare-and-swap, and each cell's sequence number says
+// whether it is free for the position's sender (seq == 2 * pos) or holds
+// a value for its receiver (seq == 2 * pos + 1). Doubling keeps the two
+// apart from the next lap's free mark even with a single cell.
+class MpmcChannel : public Channel
+{
+public:
+  explicit MpmcChannel(size_t capacity);
+
+protected:
+  bool push(DataObject& value);
+  bool pop(DataObject& value);
+  bool full() const {return send_pos.load() - recv_pos.load() >= cap;}
+  bool empty() const {return send_pos.load() == recv_pos.load();}
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> seq;
+    DataObject value;
+  };
+  std::vector<Cell> cells;
+  std::atomic<size_t> send_pos;
+  std::atomic<size_t> recv_pos;
+};
+
+
+inline Channel* Channel::create(size_t capacity, bool spsc)
+{
+  if (spsc)
+    return new SpscChannel(capacity);
+  return new MpmcChannel(capacity);
+}
+
+
+inline bool Channel::send(DataObject& value)
+{
+  while (true) {
+    if (closed())
+      return false;
+    if (push(value)) {
+      not_empty.notify_all();
+      return true;
+    }
+    not_full.wait([this]() {return closed() or !full();});
+  }
+}
+
+
+inline bool Channel::recv(DataObject& value)
+{
+  while (true) {
+    if (pop(value)) {
+      not_full.notify_all();
+      return true;
+    }
+    // values sent before the close are still delivered
+    if (closed()) {
+      if (!pop(value))
+        return false;
+      not_full.notify_all();
+      return true;
+    }
+    not_empty.wait([this]() {return closed() or !empty();});
+  }
+}
+
+
+inline bool Channel::try_recv(DataObject& value)
+{
+  if (!pop(value))
+    return false;
+  not_full.notify_all();
+  return true;
+}
+
+
+inline void Channel::close()
+{
+  is_closed = true;
+  not_full.notify_all();
+  not_empty.notify_all();
+}
+
+
+inline bool SpscChannel::push(DataObject& value)
+{
+  size_t t = tail.load(std::memory_order_relaxed);
+  if (t - head.load(std::memory_order_acquire) == cap)
+    return false;
+  slots[t % cap] = std::move(value);
+  tail.store(t + 1, std::memory_order_release);
+  return true;
+}
+
+
+inline bool SpscChannel::pop(DataObject& value)
+{
+  size_t h = head.load(std::memory_order_relaxed);
+  if (tail.load(std::memory_order_acquire) == h)
+    return false;
+  value = std::move(slots[h % cap]);
+  head.store(h + 1, std::memory_order_release);
+  return true;
+}
+
+
+inline MpmcChannel::MpmcChannel(size_t capacity)
+  : Channel(capacity), cells(capacity), send_pos(0), recv_pos(0)
+{
+  for (size_t i = 0; i < capacity; ++i)
+    cells[i].seq.store(2 * i, std::memory_order_relaxed);
+}
+
+
+inline bool MpmcChannel::push(DataObject& value)
+{
+  size_t pos = send_pos.load(std::memory_order_relaxed);
+  while (true) {
+    Cell& cell = cells[pos % cap];
+    size_t seq = cell.seq.load(std::memory_order_acquire);
+    if (seq == 2 * pos) {
+      // the cell is free: claim the position
+      if (send_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        cell.value = std::move(value);
+        cell.seq.store(2 * pos + 1, std::memory_order_release);
+        return true;
+      }
+    }
+    else if (seq < 2 * pos)
+      return false;                     // still holds the value from a lap ago
+    else
+      pos = send_pos.load(std::memory_order_relaxed);
+  }
+}
+
+
+inline bool MpmcChannel::pop(DataObject& value)
+{
+  size_t pos = recv_pos.load(std::memory_order_relaxed);
+  while (true) {
+    Cell& cell = cells[pos % cap];
+    size_t seq = cell.seq.load(std::memory_order_acquire);
+    if (seq == 2 * pos + 1) {
+      if (recv_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        value = std::move(cell.value);
+        // free the cell for the sender one lap ahead
+        cell.seq.store(2 * (pos + cap), std::memory_order_release);
+        return true;
+      }
+    }
+    else if (seq < 2 * pos + 1)
+      return false;                     // not sent yet
+    else
+      pos = recv_pos.load(std::memory_order_relaxed);
+  }
+}
+
+#endif
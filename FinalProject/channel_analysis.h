@@ -0,0 +1,301 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: channel_analysis.h
+// DATE: Spring 2021
+// DESC: Finds channels that are provably used by one sending and one
+//       receiving task, so the interpreter can give them the lock-free
+//       single-producer/single-consumer ring (see channel.h). For each
+//       function, the analysis records how it uses its channel
+//       parameters (sends, receives, or spawns tasks that do), and for
+//       each `var c = new channel<T>(n)` it counts the tasks that send
+//       and receive on c. Any other use of the variable (assigning it,
+//       storing it, passing it to a function that does, spawning in a
+//       loop, or using it in a parallel for) leaves the channel MPMC.
+//       Functions are declared before use, so a function's callees are
+//       always analyzed before it.
+//----------------------------------------------------------------------
+
+#ifndef CHANNEL_ANALYSIS_H
+#define CHANNEL_ANALYSIS_H
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "ast.h"
+
+
+class ChannelAnalysis : public Visitor
+{
+public:
+
+  // how a function body uses one channel variable
+  struct Uses
+  {
+    bool sends = false;         // send or close in the running task
+    bool recvs = false;         // recv or try_recv in the running task
+    int producers = 0;          // other tasks that send (2 means many)
+    int consumers = 0;          // other tasks that receive (2 means many)
+    bool escapes = false;       // used in a way the analysis can't follow
+  };
+
+  // the uses of each function's parameters, by position
+  typedef std::map<std::string, std::vector<Uses>> Roles;
+
+  // the uses of each of the function's parameters (given the roles of
+  // the functions declared before it)
+  static std::vector<Uses> param_roles(FunDecl& fun, const Roles& roles);
+
+  // set spsc on the channels the function creates in a variable
+  // declaration that have at most one sending and one receiving task
+  static void mark_spsc(FunDecl& fun, const Roles& roles);
+
+  // top-level
+  void visit(Program&) {}
+  void visit(FunDecl&) {}
+  void visit(TypeDecl&) {}
+  // statements
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node) {node.expr->accept(*this);}
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  void visit(TryStmt& node);
+  void visit(CatchStmt& node);
+  void visit(ThrowStmt& node) {node.expr->accept(*this);}
+  // expressions
+  void visit(Expr& node);
+  void visit(QuickExpr& node) {visit((Expr&)node);}
+  void visit(SimpleTerm& node) {node.rvalue->accept(*this);}
+  void visit(ComplexTerm& node) {node.expr->accept(*this);}
+  // rvalues
+  void visit(SimpleRValue&) {}
+  void visit(NewRValue& node);
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node) {node.expr->accept(*this);}
+
+private:
+
+  ChannelAnalysis(const std::string& name, const Roles& roles)
+    : name(name), roles(roles) {}
+
+  std::string name;             // the channel variable
+  const Roles& roles;
+  Uses uses;
+  int decls = 0;                // declarations of name
+  int loops = 0;                // enclosing loops
+  int parallel_loops = 0;       // enclosing parallel for loops
+  // channel declarations found (var name, channel)
+  std::vector<std::pair<std::string,NewRValue*>> created;
+
+  void body(const std::list<Stmt*>& stmts);
+  bool is_name(Expr* e) const;
+  static void add(int& count, int n) {count = std::min(2, count + n);}
+};
+
+
+inline std::vector<ChannelAnalysis::Uses> ChannelAnalysis::param_roles(FunDecl& fun, const Roles& roles)
+{
+  std::vector<Uses> params;
+  for (FunDecl::FunParam& p : fun.params)
+  {
+    ChannelAnalysis a(p.id.lexeme(), roles);
+    a.body(fun.stmts);
+    //  A parameter redeclared in the body can't be told apart from it
+    if (a.decls > 0)
+      a.uses.escapes = true;
+    params.push_back(a.uses);
+  }
+  return params;
+}
+
+
+inline void ChannelAnalysis::mark_spsc(FunDecl& fun, const Roles& roles)
+{
+  ChannelAnalysis finder("", roles);
+  finder.body(fun.stmts);
+  for (std::pair<std::string,NewRValue*>& c : finder.created)
+  {
+    ChannelAnalysis a(c.first, roles);
+    a.body(fun.stmts);
+    int senders = (a.uses.sends ? 1 : 0) + a.uses.producers;
+    int receivers = (a.uses.recvs ? 1 : 0) + a.uses.consumers;
+    bool shadowed = a.decls > 1;
+    for (FunDecl::FunParam& p : fun.params)
+      if (p.id.lexeme() == c.first)
+        shadowed = true;
+    c.second->spsc = !a.uses.escapes && !shadowed && senders <= 1 && receivers <= 1;
+  }
+}
+
+
+inline void ChannelAnalysis::body(const std::list<Stmt*>& stmts)
+{
+  for (Stmt* s : stmts)
+    s->accept(*this);
+}
+
+
+// true if the expression is just the channel variable
+inline bool ChannelAnalysis::is_name(Expr* e) const
+{
+  if (e->negated || e->op)
+    return false;
+  SimpleTerm* t = dynamic_cast<SimpleTerm*>(e->first);
+  if (!t)
+    return false;
+  IDRValue* v = dynamic_cast<IDRValue*>(t->rvalue);
+  return v && v->path.size() == 1 && v->path.front().lexeme() == name;
+}
+
+
+inline void ChannelAnalysis::visit(VarDeclStmt& node)
+{
+  if (node.id.lexeme() == name)
+    ++decls;
+  //  Only a channel created straight into a variable can be followed
+  if (!node.expr->op && !node.expr->negated)
+    if (SimpleTerm* t = dynamic_cast<SimpleTerm*>(node.expr->first))
+      if (NewRValue* n = dynamic_cast<NewRValue*>(t->rvalue))
+        if (n->type_id.lexeme().find("channel<") == 0)
+          created.push_back(std::make_pair(node.id.lexeme(), n));
+  node.expr->accept(*this);
+}
+
+
+inline void ChannelAnalysis::visit(AssignStmt& node)
+{
+  if (node.lvalue_list.front().lexeme() == name)
+    uses.escapes = true;
+  node.expr->accept(*this);
+}
+
+
+inline void ChannelAnalysis::visit(IfStmt& node)
+{
+  node.if_part->expr->accept(*this);
+  body(node.if_part->stmts);
+  for (BasicIf* b : node.else_ifs)
+  {
+    b->expr->accept(*this);
+    body(b->stmts);
+  }
+  body(node.body_stmts);
+}
+
+
+inline void ChannelAnalysis::visit(WhileStmt& node)
+{
+  ++loops;
+  node.expr->accept(*this);
+  body(node.stmts);
+  --loops;
+}
+
+
+inline void ChannelAnalysis::visit(ForStmt& node)
+{
+  node.start->accept(*this);
+  node.end->accept(*this);
+  ++loops;
+  if (node.parallel)
+    ++parallel_loops;
+  body(node.stmts);
+  if (node.parallel)
+    --parallel_loops;
+  --loops;
+}
+
+
+inline void ChannelAnalysis::visit(TryStmt& node)
+{
+  body(node.stmts);
+  node.catch_stmt->accept(*this);
+}
+
+
+inline void ChannelAnalysis::visit(CatchStmt& node)
+{
+  if (node.catch_expr)
+    node.catch_expr->accept(*this);
+  body(node.stmts);
+}
+
+
+inline void ChannelAnalysis::visit(Expr& node)
+{
+  node.first->accept(*this);
+  if (node.rest)
+    node.rest->accept(*this);
+}
+
+
+inline void ChannelAnalysis::visit(NewRValue& node)
+{
+  if (node.capacity)
+    node.capacity->accept(*this);
+}
+
+
+inline void ChannelAnalysis::visit(CallExpr& node)
+{
+  std::string fun = node.function_id.lexeme();
+  size_t i = 0;
+  for (Expr* e : node.arg_list)
+  {
+    if (!is_name(e))
+      e->accept(*this);
+    //  Iterations of a parallel for run in several threads at once
+    else if (parallel_loops > 0)
+      uses.escapes = true;
+    else if (i == 0 && (fun == "send" || fun == "close"))
+      uses.sends = true;
+    else if (i == 0 && (fun == "recv" || fun == "try_recv"))
+      uses.recvs = true;
+    else
+    {
+      auto callee = roles.find(fun);
+      if (callee == roles.end() || i >= callee->second.size()
+          || callee->second[i].escapes)
+        uses.escapes = true;
+      else
+      {
+        //  A spawned callee is another task; a called one runs in this one
+        const Uses& p = callee->second[i];
+        int producers = p.producers;
+        int consumers = p.consumers;
+        if (node.spawn)
+        {
+          producers += p.sends ? 1 : 0;
+          consumers += p.recvs ? 1 : 0;
+        }
+        else
+        {
+          uses.sends = uses.sends || p.sends;
+          uses.recvs = uses.recvs || p.recvs;
+        }
+        //  Tasks started in a loop may be any number of tasks
+        if (loops > 0)
+        {
+          producers = producers ? 2 : 0;
+          consumers = consumers ? 2 : 0;
+        }
+        add(uses.producers, producers);
+        add(uses.consumers, consumers);
+      }
+    }
+    ++i;
+  }
+}
+
+
+inline void ChannelAnalysis::visit(IDRValue& node)
+{
+  //  Any use not handled by visit(CallExpr&)
+  if (node.path.front().lexeme() == name)
+    uses.escapes = true;
+}
+
+#endif
@@ -0,0 +1,402 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: compile_server.h
+// DATE: Spring 2021
+// DESC: A daemon that runs MyPL programs for clients over a Unix
+//       domain socket (mypl --serve) and the client for it (mypl
+//       --client). Programs are compiled once (see mypl_api.h) and
+//       cached by path with the source they came from, so a request for
+//       an unchanged program goes straight to running main, and an
+//       edited program replaces its old entry. Connections are handed
+//       to a fixed set of worker threads.
+//
+//       Each message is a sequence of frames: a 4-byte length (network
+//       order) followed by that many bytes. A request is two frames,
+//       the program's absolute path and its entire standard input; the
+//       reply is three, its standard output, its standard error, and
+//       its exit code as text. Errors mypl would print (front-end and
+//       runtime errors) are part of the standard output, as with mypl.
+//       A frame longer than MAX_FRAME bytes is refused and its
+//       connection closed, as is a connection whose request stops
+//       arriving for REQUEST_TIMEOUT_MS.
+//----------------------------------------------------------------------
+
+#ifndef COMPILE_SERVER_H
+#define COMPILE_SERVER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "mypl_api.h"
+
+
+class CompileServer
+{
+public:
+
+  // serve on the socket at path with the given number of workers (0
+  // for one per available core)
+  CompileServer(const std::string& path, int threads) : path(path), threads(threads) {}
+
+  // accept and run requests until the process is stopped; returns 1 if
+  // the socket cannot be opened or accepting connections fails for
+  // anything but a lack of resources (reported on log)
+  int serve(std::ostream& log);
+
+  // run one request for the program at path with the given source
+  // text, filling out and err, and return the exit code
+  int execute(const std::string& program_path, const std::string& source,
+              const std::string& input, std::string& out, std::string& err);
+
+  // the longest frame read_frame accepts (so a bad length can't make
+  // the reader allocate up to 4 GB)
+  static const uint32_t MAX_FRAME = 64 * 1024 * 1024;
+
+  // frame helpers for the server and clients; false if the other side
+  // closed the connection, the frame is incomplete, or (when reading)
+  // it is longer than MAX_FRAME
+  static bool write_frame(int fd, const std::string& data);
+  static bool read_frame(int fd, std::string& data);
+
+  // the exit code in a reply frame; false if it isn't a whole number
+  static bool parse_code(const std::string& text, int& code);
+
+  // a connected socket to the server at path, or -1
+  static int connect_to(const std::string& path);
+
+  // a socket listening at path that only this user can connect to, or
+  // -1 (reported on log)
+  static int listen_on(const std::string& path, std::ostream& log);
+
+  // after accept fails: wait a moment if out of descriptors or memory,
+  // and return false (reported on log) if the server should stop
+  static bool accept_failed(std::ostream& log);
+
+  // send the request for program (with the given input) to the server
+  // at path and copy the reply to out and err; returns the program's
+  // exit code, or 1 (with a message on err) if the server can't be reached
+  static int client(const std::string& path, const std::string& program,
+                    std::istream& in, std::ostream& out, std::ostream& err);
+
+private:
+
+  std::string path;
+  int threads;
+
+  // how long a client may leave its request unfinished; each
+  // connection holds a worker until its request is read
+  static const int REQUEST_TIMEOUT_MS = 2000;
+
+  // how long to wait before accepting again when out of descriptors
+  // or memory (retrying at once would spin until some are freed)
+  static const int ACCEPT_BACKOFF_MS = 100;
+
+  // compiled programs by absolute path, with the source they came from
+  // (one entry per program file); entries in use stay alive while
+  // replaced
+  struct Entry
+  {
+    std::string source;
+    std::shared_ptr<CompiledProgram> program;
+  };
+  std::mutex cache_lock;
+  std::unordered_map<std::string, Entry> cache;
+
+  // accepted connections waiting for a worker
+  std::mutex queue_lock;
+  std::condition_variable queue_ready;
+  std::deque<int> connections;
+
+  // the compiled program for the source of the program at path (throws
+  // a MyPLException)
+  std::shared_ptr<CompiledProgram> compiled(const std::string& program_path,
+                                            const std::string& source);
+
+  void handle(int fd);
+  void run_worker();
+};
+
+
+bool CompileServer::write_frame(int fd, const std::string& data)
+{
+  uint32_t length = htonl((uint32_t)data.size());
+  std::string frame((const char*)&length, sizeof(length));
+  frame += data;
+  size_t sent = 0;
+  while (sent < frame.size()) {
+    // no SIGPIPE if the other side has gone
+    ssize_t n = send(fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    sent += n;
+  }
+  return true;
+}
+
+
+bool CompileServer::read_frame(int fd, std::string& data)
+{
+  auto read_all = [fd](char* buffer, size_t size) {
+    size_t got = 0;
+    while (got < size) {
+      ssize_t n = read(fd, buffer + got, size - got);
+      if (n <= 0)
+        return false;
+      got += n;
+    }
+    return true;
+  };
+  uint32_t length;
+  if (!read_all((char*)&length, sizeof(length)) or ntohl(length) > MAX_FRAME)
+    return false;
+  data.resize(ntohl(length));
+  return data.empty() or read_all(&data[0], data.size());
+}
+
+
+bool CompileServer::parse_code(const std::string& text, int& code)
+{
+  char* end;
+  errno = 0;
+  long value = strtol(text.c_str(), &end, 10);
+  if (text.empty() or *end != '\0' or errno == ERANGE or value < INT_MIN or value > INT_MAX)
+    return false;
+  code = (int)value;
+  return true;
+}
+
+
+int CompileServer::connect_to(const std::string& path)
+{
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    return -1;
+  strcpy(addr.sun_path, path.c_str());
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+
+std::shared_ptr<CompiledProgram> CompileServer::compiled(const std::string& program_path,
+                                                        const std::string& source)
+{
+  {
+    std::lock_guard<std::mutex> guard(cache_lock);
+    auto entry = cache.find(program_path);
+    if (entry != cache.end() and entry->second.source == source)
+      return entry->second.program;
+  }
+  // compile outside the lock; two requests may race to compile the same
+  // program, which only costs the loser its work
+  std::shared_ptr<CompiledProgram> program(CompiledProgram::compile(source));
+  std::lock_guard<std::mutex> guard(cache_lock);
+  cache[program_path] = Entry{source, program};
+  return program;
+}
+
+
+int CompileServer::execute(const std::string& program_path, const std::string& source,
+                           const std::string& input, std::string& out, std::string& err)
+{
+  std::istringstream in(input);
+  std::ostringstream out_stream;
+  std::ostringstream err_stream;
+  int code;
+  try {
+    std::shared_ptr<CompiledProgram> program = compiled(program_path, source);
+    ExecutionContext context(*program, in, out_stream);
+    code = context.run();
+  }
+  catch (MyPLException& e) {
+    out_stream << e.to_string() << std::endl;
+    code = 1;
+  }
+  catch (std::exception& e) {
+    err_stream << e.what() << std::endl;
+    code = 1;
+  }
+  out = out_stream.str();
+  err = err_stream.str();
+  return code;
+}
+
+
+void CompileServer::handle(int fd)
+{
+  std::string program_path;
+  std::string input;
+  if (!read_frame(fd, program_path) or !read_frame(fd, input)) {
+    close(fd);
+    return;
+  }
+  std::string out;
+  std::string err;
+  int code;
+  std::ifstream file(program_path);
+  if (!file) {
+    err = "cannot open " + program_path + "\n";
+    code = 1;
+  }
+  else {
+    std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    code = execute(program_path, source, input, out, err);
+  }
+  write_frame(fd, out) and write_frame(fd, err) and write_frame(fd, std::to_string(code));
+  close(fd);
+}
+
+
+void CompileServer::run_worker()
+{
+  while (true) {
+    int fd;
+    {
+      std::unique_lock<std::mutex> guard(queue_lock);
+      queue_ready.wait(guard, [this]() {return !connections.empty();});
+      fd = connections.front();
+      connections.pop_front();
+    }
+    handle(fd);
+  }
+}
+
+
+int CompileServer::listen_on(const std::string& path, std::ostream& log)
+{
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    log << "socket path too long: " << path << std::endl;
+    return -1;
+  }
+  strcpy(addr.sun_path, path.c_str());
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  // a socket file left by an earlier server would make bind fail
+  unlink(path.c_str());
+  // clients run programs as the server's user, so other users must not
+  // be able to connect (the socket file is made with mode 0600)
+  mode_t old_mask = umask(0077);
+  bool bound = listener >= 0 and bind(listener, (sockaddr*)&addr, sizeof(addr)) == 0;
+  umask(old_mask);
+  if (!bound or listen(listener, 128) < 0) {
+    log << "cannot listen on " << path << std::endl;
+    if (listener >= 0)
+      close(listener);
+    return -1;
+  }
+  return listener;
+}
+
+
+bool CompileServer::accept_failed(std::ostream& log)
+{
+  switch (errno) {
+    case EINTR:
+    case ECONNABORTED:
+      return true;
+    case EMFILE:
+    case ENFILE:
+    case ENOBUFS:
+    case ENOMEM:
+      usleep(ACCEPT_BACKOFF_MS * 1000);
+      return true;
+    default:
+      log << "cannot accept connections: " << strerror(errno) << std::endl;
+      return false;
+  }
+}
+
+
+int CompileServer::serve(std::ostream& log)
+{
+  int listener = listen_on(path, log);
+  if (listener < 0)
+    return 1;
+
+  int count = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 0; i < count; ++i)
+    std::thread(&CompileServer::run_worker, this).detach();
+  while (true) {
+    int fd = accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      if (accept_failed(log))
+        continue;
+      close(listener);
+      return 1;
+    }
+    // a request that stalls is dropped (see handle)
+    timeval timeout;
+    timeout.tv_sec = REQUEST_TIMEOUT_MS / 1000;
+    timeout.tv_usec = REQUEST_TIMEOUT_MS % 1000 * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    {
+      std::lock_guard<std::mutex> guard(queue_lock);
+      connections.push_back(fd);
+    }
+    queue_ready.notify_one();
+  }
+}
+
+
+int CompileServer::client(const std::string& path, const std::string& program,
+                          std::istream& in, std::ostream& out, std::ostream& err)
+{
+  // the server may run in another directory
+  char resolved[PATH_MAX];
+  if (!realpath(program.c_str(), resolved)) {
+    err << "cannot open " << program << std::endl;
+    return 1;
+  }
+  int fd = connect_to(path);
+  if (fd < 0) {
+    err << "cannot connect to " << path << std::endl;
+    return 1;
+  }
+  std::string input((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  std::string reply_out;
+  std::string reply_err;
+  std::string code;
+  bool ok = write_frame(fd, resolved) and write_frame(fd, input) and read_frame(fd, reply_out)
+    and read_frame(fd, reply_err) and read_frame(fd, code);
+  close(fd);
+  if (!ok) {
+    err << "connection to " << path << " lost" << std::endl;
+    return 1;
+  }
+  out << reply_out;
+  err << reply_err;
+  int exit_code;
+  if (!parse_code(code, exit_code)) {
+    err << "bad reply from " << path << std::endl;
+    return 1;
+  }
+  return exit_code;
+}
+
+#endif
@@ -0,0 +1,572 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: cpp_generator.h
+// DATE: Spring 2021
+// DESC: Backend visitor that translates a type-checked MyPL program into
+//       a standalone C++ translation unit. User-defined types become
+//       structs (held by pointer, like heap objects in the interpreter),
+//       primitives map to native C++ types, try/catch/throw map to C++
+//       exceptions, and built-ins call into mypl_runtime.h. User names
+//       are prefixed (t_ for types, f_ for functions, v_ for variables)
+//       so they cannot clash with C++ keywords.
+//----------------------------------------------------------------------
+
+#ifndef CPP_GENERATOR_H
+#define CPP_GENERATOR_H
+
+#include <iostream>
+#include <set>
+#include "ast.h"
+#include "mypl_exception.h"
+
+
+class CppGenerator : public Visitor
+{
+public:
+  // the generated code is written to the given output stream
+  CppGenerator(std::ostream& output_stream) : out(output_stream) {}
+
+  // top-level
+  void visit(Program& node);
+  void visit(FunDecl& node);
+  void visit(TypeDecl& node);
+  // statements
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node);
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  void visit(TryStmt& node);
+  void visit(CatchStmt& node);
+  void visit(ThrowStmt& node);
+  // expressions
+  void visit(Expr& node);
+  void visit(QuickExpr& node);
+  void visit(SimpleTerm& node);
+  void visit(ComplexTerm& node);
+  // rvalues
+  void visit(SimpleRValue& node);
+  void visit(NewRValue& node);
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node);
+
+private:
+  std::ostream& out;
+  int indent = 0;
+  // counter for generated temporaries
+  int temp_count = 0;
+  // return type of the function being generated
+  std::string return_type;
+  // built-in function names
+  const std::set<std::string> built_ins =
+    {"print", "read", "stoi", "itos", "stod", "dtos", "get", "length", "await"};
+
+  void inc_indent() {indent += 2;}
+  void dec_indent() {indent -= 2;}
+  std::string get_indent() {return std::string(indent, ' ');}
+
+  // the C++ type for a MyPL type name
+  std::string cpp_type(const std::string& type) const;
+  // report types the generated code has no counterpart for (channels)
+  void check_type(const std::string& type, const Token& token);
+  // the default value for a MyPL type (used for nil initializers)
+  std::string default_value(const std::string& type) const;
+  // generate the function header (for prototypes and definitions)
+  void fun_header(FunDecl& node);
+  // generate the constructor that initializes a type's fields
+  void type_constructor(TypeDecl& node);
+  // generate a block of statements
+  void body(const std::list<Stmt*>& stmts);
+  // a C++ string literal for a MyPL string token
+  std::string string_literal(const std::string& lexeme) const;
+  // a fresh temporary name
+  std::string temp();
+  // a variable or attribute path (x.y.z), checking each object for nil
+  std::string path(const std::list<Token>& ids) const;
+
+  void error(const std::string& msg, const Token& token);
+};
+
+
+void CppGenerator::error(const std::string& msg, const Token& token)
+{
+  throw MyPLException(SEMANTIC, msg, token.line(), token.column());
+}
+
+
+std::string CppGenerator::cpp_type(const std::string& type) const
+{
+  if (type == "int" or type == "double" or type == "bool" or type == "char")
+    return type;
+  else if (type == "string")
+    return "std::string";
+  else if (type == "nil")
+    return "void";
+  else if (type.find("task<") == 0)
+    return "mypl::task<" + cpp_type(type.substr(5, type.length() - 6)) + ">";
+  return "t_" + type + "*";
+}
+
+
+void CppGenerator::check_type(const std::string& type, const Token& token)
+{
+  if (type.find("channel<") != std::string::npos)
+    error("channels are not supported in generated C++", token);
+}
+
+
+std::string CppGenerator::default_value(const std::string& type) const
+{
+  if (type == "int" or type == "double" or type == "char")
+    return "0";
+  else if (type == "bool")
+    return "false";
+  else if (type == "string")
+    return "std::string()";
+  return "nullptr";
+}
+
+
+std::string CppGenerator::string_literal(const std::string& lexeme) const
+{
+  // the lexeme keeps escapes as written; print() interprets them
+  std::string s = "std::string(\"";
+  for (char c : lexeme) {
+    if (c == '\\' or c == '"')
+      s += '\\';
+    s += c;
+  }
+  return s + "\")";
+}
+
+
+std::string CppGenerator::path(const std::list<Token>& ids) const
+{
+  std::string s = "v_" + ids.front().lexeme();
+  for (auto it = std::next(ids.begin()); it != ids.end(); ++it) {
+    // same message as the interpreter
+    std::string msg = "Runtime Error: Runtime Error| Cannot access '" + it->lexeme()
+      + "' of a nil value at line " + std::to_string(it->line()) + " column "
+      + std::to_string(it->column());
+    s = "mypl::deref(" + s + ", \"" + msg + "\")->v_" + it->lexeme();
+  }
+  return s;
+}
+
+
+std::string CppGenerator::temp()
+{
+  return "tmp_" + std::to_string(temp_count++);
+}
+
+
+void CppGenerator::body(const std::list<Stmt*>& stmts)
+{
+  inc_indent();
+  for (Stmt* s : stmts) {
+    // a call statement is an expression statement in C++
+    if (CallExpr* c = dynamic_cast<CallExpr*>(s)) {
+      out << get_indent();
+      c->accept(*this);
+      out << ";\n";
+    }
+    else
+      s->accept(*this);
+  }
+  dec_indent();
+}
+
+
+//----------------------------------------------------------------------
+// Top-level declarations
+//----------------------------------------------------------------------
+
+void CppGenerator::visit(Program& node)
+{
+  out << "// generated from MyPL source\n";
+  out << "#include \"mypl_runtime.h\"\n\n";
+
+  // forward declare all types so fields and functions can refer to them
+  for (Decl* d : node.decls)
+    if (TypeDecl* t = dynamic_cast<TypeDecl*>(d))
+      out << "struct t_" << t->id.lexeme() << ";\n";
+  for (Decl* d : node.decls)
+    if (TypeDecl* t = dynamic_cast<TypeDecl*>(d))
+      t->accept(*this);
+
+  // prototypes allow calls in any order (including from constructors)
+  out << "\n";
+  for (Decl* d : node.decls)
+    if (FunDecl* f = dynamic_cast<FunDecl*>(d)) {
+      fun_header(*f);
+      out << ";\n";
+    }
+  out << "\n";
+  for (Decl* d : node.decls)
+    if (TypeDecl* t = dynamic_cast<TypeDecl*>(d))
+      type_constructor(*t);
+  for (Decl* d : node.decls)
+    if (FunDecl* f = dynamic_cast<FunDecl*>(d))
+      f->accept(*this);
+
+  // uncaught errors print the same message as the interpreter
+  out << "int main()\n{\n";
+  out << "  try {\n";
+  out << "    return f_main();\n";
+  out << "  } catch (const mypl::Error& e) {\n";
+  out << "    std::cout << e.what() << std::endl;\n";
+  out << "    return 1;\n";
+  out << "  }\n";
+  out << "}\n";
+}
+
+
+void CppGenerator::fun_header(FunDecl& node)
+{
+  check_type(node.return_type.lexeme(), node.return_type);
+  out << cpp_type(node.return_type.lexeme()) << " f_" << node.id.lexeme() << "(";
+  int i = 0;
+  for (FunDecl::FunParam p : node.params) {
+    check_type(p.type.lexeme(), p.type);
+    if (i++ > 0)
+      out << ", ";
+    out << cpp_type(p.type.lexeme()) << " v_" << p.id.lexeme();
+  }
+  out << ")";
+}
+
+
+void CppGenerator::visit(FunDecl& node)
+{
+  return_type = node.return_type.lexeme();
+  fun_header(node);
+  out << "\n{\n";
+  body(node.stmts);
+  // falling off the end returns the type's default (0 for main)
+  if (return_type != "nil")
+    out << "  return " << default_value(return_type) << ";\n";
+  out << "}\n\n";
+}
+
+
+void CppGenerator::visit(TypeDecl& node)
+{
+  out << "struct t_" << node.id.lexeme() << "\n{\n";
+  inc_indent();
+  for (VarDeclStmt* v : node.vdecls) {
+    std::string type = v->type ? v->type->lexeme() : v->expr->type;
+    check_type(type, v->id);
+    out << get_indent() << cpp_type(type) << " v_" << v->id.lexeme() << ";\n";
+  }
+  out << get_indent() << "t_" << node.id.lexeme() << "();\n";
+  dec_indent();
+  out << "};\n\n";
+}
+
+
+void CppGenerator::type_constructor(TypeDecl& node)
+{
+  std::string name = "t_" + node.id.lexeme();
+  out << name << "::" << name << "()\n{\n";
+  inc_indent();
+  for (VarDeclStmt* v : node.vdecls) {
+    std::string type = v->type ? v->type->lexeme() : v->expr->type;
+    out << get_indent() << "v_" << v->id.lexeme() << " = ";
+    if (v->expr->type == "nil")
+      out << default_value(type);
+    else
+      v->expr->accept(*this);
+    out << ";\n";
+  }
+  dec_indent();
+  out << "}\n\n";
+}
+
+
+//----------------------------------------------------------------------
+// Statements
+//----------------------------------------------------------------------
+
+void CppGenerator::visit(VarDeclStmt& node)
+{
+  std::string type = node.type ? node.type->lexeme() : node.expr->type;
+  check_type(type, node.id);
+  out << get_indent() << cpp_type(type) << " v_" << node.id.lexeme() << " = ";
+  if (node.expr->type == "nil")
+    out << default_value(type);
+  else
+    node.expr->accept(*this);
+  out << ";\n";
+}
+
+
+void CppGenerator::visit(AssignStmt& node)
+{
+  out << get_indent() << path(node.lvalue_list) << " = ";
+  node.expr->accept(*this);
+  out << ";\n";
+}
+
+
+void CppGenerator::visit(ReturnStmt& node)
+{
+  out << get_indent();
+  if (return_type == "nil") {
+    out << "return;\n";
+    return;
+  }
+  out << "return ";
+  if (node.expr->type == "nil")
+    out << default_value(return_type);
+  else
+    node.expr->accept(*this);
+  out << ";\n";
+}
+
+
+void CppGenerator::visit(IfStmt& node)
+{
+  out << get_indent() << "if (";
+  node.if_part->expr->accept(*this);
+  out << ") {\n";
+  body(node.if_part->stmts);
+  for (BasicIf* b : node.else_ifs) {
+    out << get_indent() << "} else if (";
+    b->expr->accept(*this);
+    out << ") {\n";
+    body(b->stmts);
+  }
+  if (!node.body_stmts.empty()) {
+    out << get_indent() << "} else {\n";
+    body(node.body_stmts);
+  }
+  out << get_indent() << "}\n";
+}
+
+
+void CppGenerator::visit(WhileStmt& node)
+{
+  out << get_indent() << "while (";
+  node.expr->accept(*this);
+  out << ") {\n";
+  body(node.stmts);
+  out << get_indent() << "}\n";
+}
+
+
+void CppGenerator::visit(ForStmt& node)
+{
+  // the start is evaluated before the loop variable is in scope and
+  // the end after; both are evaluated once. A parallel loop is
+  // generated as a sequential one, which gives the same reductions
+  std::string start = temp();
+  std::string end = temp();
+  std::string var = "v_" + node.var_id.lexeme();
+  out << get_indent() << "{\n";
+  inc_indent();
+  out << get_indent() << "int " << start << " = ";
+  node.start->accept(*this);
+  out << ";\n";
+  out << get_indent() << "int " << var << " = " << start << ";\n";
+  out << get_indent() << "int " << end << " = ";
+  node.end->accept(*this);
+  out << ";\n";
+  //  Test for the last value before incrementing, so an end of INT_MAX
+  //  doesn't overflow the loop var
+  out << get_indent() << "for (; " << var << " <= " << end << "; ++" << var << ") {\n";
+  body(node.stmts);
+  inc_indent();
+  out << get_indent() << "if (" << var << " >= " << end << ") break;\n";
+  dec_indent();
+  out << get_indent() << "}\n";
+  dec_indent();
+  out << get_indent() << "}\n";
+}
+
+
+void CppGenerator::visit(TryStmt& node)
+{
+  out << get_indent() << "try {\n";
+  body(node.stmts);
+  node.catch_stmt->accept(*this);
+}
+
+
+void CppGenerator::visit(CatchStmt& node)
+{
+  std::string id = node.error_id.lexeme();
+  if (id == "ZeroDivision")
+    out << get_indent() << "} catch (const mypl::ZeroDivisionError&) {\n";
+  else if (id == "IndexOutOfBounds")
+    out << get_indent() << "} catch (const mypl::IndexOutOfBoundsError&) {\n";
+  else if (node.catch_expr) {
+    // only a thrown value equal to the catch value is handled here
+    out << get_indent() << "} catch (const mypl::Thrown& e) {\n";
+    out << get_indent() << "  if (!e.matches(";
+    node.catch_expr->accept(*this);
+    out << "))\n";
+    out << get_indent() << "    throw;\n";
+  }
+  else if (id.empty())
+    out << get_indent() << "} catch (const mypl::Error&) {\n";
+  else
+    error("unknown error '" + id + "' in catch", node.error_id);
+  body(node.stmts);
+  out << get_indent() << "}\n";
+}
+
+
+void CppGenerator::visit(ThrowStmt& node)
+{
+  out << get_indent() << "throw mypl::Thrown(";
+  node.expr->accept(*this);
+  out << ");\n";
+}
+
+
+//----------------------------------------------------------------------
+// Expressions (fully parenthesized, keeping MyPL's right grouping)
+//----------------------------------------------------------------------
+
+void CppGenerator::visit(Expr& node)
+{
+  // a negated expression is just its negated first term
+  if (node.negated) {
+    out << "(!";
+    node.first->accept(*this);
+    out << ")";
+    return;
+  }
+  if (!node.op) {
+    node.first->accept(*this);
+    return;
+  }
+
+  std::string lhs_type = node.first->type;
+  std::string fun;
+  std::string op = node.op->lexeme();
+  switch (node.op->type())
+  {
+    case PLUS:
+      if (lhs_type == "string" or lhs_type == "char")
+        fun = "mypl::concat";
+      break;
+    case DIVIDE: fun = "mypl::div"; break;
+    case MODULO: fun = "mypl::mod"; break;
+    case AND: op = "&"; break;          // both sides are always evaluated
+    case OR: op = "|"; break;
+    case ASSIGN: op = "=="; break;
+    default: break;
+  }
+
+  if (!fun.empty()) {
+    out << fun << "(";
+    node.first->accept(*this);
+    out << ", ";
+    node.rest->accept(*this);
+    out << ")";
+  }
+  else {
+    bool logical = node.op->type() == AND or node.op->type() == OR;
+    out << (logical ? "((bool)(" : "(");
+    node.first->accept(*this);
+    out << " " << op << " ";
+    node.rest->accept(*this);
+    out << (logical ? "))" : ")");
+  }
+}
+
+void CppGenerator::visit(QuickExpr& node)
+{
+  visit((Expr&)node);
+}
+
+void CppGenerator::visit(SimpleTerm& node)
+{
+  node.rvalue->accept(*this);
+}
+
+void CppGenerator::visit(ComplexTerm& node)
+{
+  out << "(";
+  node.expr->accept(*this);
+  out << ")";
+}
+
+//----------------------------------------------------------------------
+// RValues
+//----------------------------------------------------------------------
+
+void CppGenerator::visit(SimpleRValue& node)
+{
+  switch (node.value.type())
+  {
+    case CHAR_VAL:
+      out << "'" << node.value.lexeme() << "'";
+      break;
+    case STRING_VAL:
+      out << string_literal(node.value.lexeme());
+      break;
+    case DOUBLE_VAL:
+    {
+      // keep a C++ double literal even for "3." or "3"
+      std::string d = node.value.lexeme();
+      if (d.back() == '.')
+        d += "0";
+      else if (d.find('.') == std::string::npos)
+        d += ".0";
+      out << d;
+      break;
+    }
+    case NIL:
+      out << "nullptr";
+      break;
+    default:
+      out << node.value.lexeme();
+      break;
+  }
+}
+
+void CppGenerator::visit(NewRValue& node)
+{
+  check_type(node.type_id.lexeme(), node.type_id);
+  out << "(new t_" << node.type_id.lexeme() << "())";
+}
+
+void CppGenerator::visit(CallExpr& node)
+{
+  std::string name = node.function_id.lexeme();
+  // a spawned call runs right away; its task keeps the result or error
+  // for await
+  if (node.spawn)
+    out << "mypl::spawn([&]() {return ";
+  if (built_ins.count(name))
+    out << "mypl::" << name << "(";
+  else
+    out << "f_" << name << "(";
+  int i = 0;
+  for (Expr* e : node.arg_list) {
+    if (i++ > 0)
+      out << ", ";
+    e->accept(*this);
+  }
+  out << ")";
+  if (node.spawn)
+    out << ";})";
+}
+
+void CppGenerator::visit(IDRValue& node)
+{
+  out << path(node.path);
+}
+
+void CppGenerator::visit(NegatedRValue& node)
+{
+  out << "(-";
+  node.expr->accept(*this);
+  out << ")";
+}
+
+#endif
@@ -12,6 +12,8 @@
 #define DATA_OBJECT_H
 
 #include <string>
+#include <utility>
+#include "runtime_stats.h"
 
 
 
@@ -35,6 +37,9 @@ public:
   // copying
   DataObject(const DataObject& rhs);
   DataObject& operator=(const DataObject& rhs);
+  // moving (takes the value's storage and leaves rhs nil)
+  DataObject(DataObject&& rhs);
+  DataObject& operator=(DataObject&& rhs);
   // set/update
   void set(int val);
   void set(double val);
@@ -72,43 +77,51 @@ public:
 // CONSTRUCTION
 //----------------------------------------------------------------------
 
-DataObject::DataObject()
+inline DataObject::DataObject()
 {
+  ++RuntimeStats::local().data_constructs;
   set_nil();
 }
 
-DataObject::DataObject(int val)
+inline DataObject::DataObject(int val)
 {
+  ++RuntimeStats::local().data_constructs;
   set(val);
 }
 
-DataObject::DataObject(double val)
+inline DataObject::DataObject(double val)
 {
+  ++RuntimeStats::local().data_constructs;
   set(val);
 }
 
-DataObject::DataObject(const char* val)
+inline DataObject::DataObject(const char* val)
 {
+  ++RuntimeStats::local().data_constructs;
   set(std::string(val));
 }
 
-DataObject::DataObject(const std::string& val)
+inline DataObject::DataObject(const std::string& val)
 {
+  ++RuntimeStats::local().data_constructs;
   set(val);
 }
 
-DataObject::DataObject(char val)
+inline DataObject::DataObject(char val)
 {
+  ++RuntimeStats::local().data_constructs;
   set(val);
 }
 
-DataObject::DataObject(bool val)
+inline DataObject::DataObject(bool val)
 {
+  ++RuntimeStats::local().data_constructs;
   set(val);
 }
 
-DataObject::DataObject(size_t val)
+inline DataObject::DataObject(size_t val)
 {
+  ++RuntimeStats::local().data_constructs;
   set(val);
 }
 
@@ -116,7 +129,7 @@ DataObject::DataObject(size_t val)
 //----------------------------------------------------------------------
 // DESTRUCTION
 //----------------------------------------------------------------------
-void DataObject::delete_obj()
+inline void DataObject::delete_obj()
 {
   if (value_type == DataType::INTEGER)
     delete (int*)value_ptr;
@@ -132,7 +145,7 @@ void DataObject::delete_obj()
     delete (size_t*)value_ptr;
 }
 
-DataObject::~DataObject()
+inline DataObject::~DataObject()
 {
   delete_obj();
 }
@@ -142,15 +155,17 @@ DataObject::~DataObject()
 // COPYING
 //----------------------------------------------------------------------
 
-DataObject::DataObject(const DataObject& rhs)
+inline DataObject::DataObject(const DataObject& rhs)
 {
+  ++RuntimeStats::local().data_constructs;
   *this = rhs;
 }
 
-DataObject& DataObject::operator=(const DataObject& rhs)
+inline DataObject& DataObject::operator=(const DataObject& rhs)
 {
   if (this == &rhs)
     return *this;
+  ++RuntimeStats::local().data_copies;
   if (rhs.is_integer()) {
     int v;
     rhs.value(v);
@@ -187,68 +202,119 @@ DataObject& DataObject::operator=(const DataObject& rhs)
   return *this;
 }
 
+inline DataObject::DataObject(DataObject&& rhs)
+{
+  ++RuntimeStats::local().data_constructs;
+  *this = std::move(rhs);
+}
+
+inline DataObject& DataObject::operator=(DataObject&& rhs)
+{
+  if (this == &rhs)
+    return *this;
+  ++RuntimeStats::local().data_moves;
+  delete_obj();
+  value_ptr = rhs.value_ptr;
+  value_type = rhs.value_type;
+  rhs.value_ptr = nullptr;
+  rhs.value_type = DataType::NIL;
+  return *this;
+}
+
 
 //----------------------------------------------------------------------
 // SET/UPDATE
 //----------------------------------------------------------------------
 
-void DataObject::set(int val)
+inline void DataObject::set(int val)
 {
+  // reuse the existing storage when the type is unchanged
+  if (value_type == DataType::INTEGER) {
+    *((int*)value_ptr) = val;
+    return;
+  }
   delete_obj();
   value_ptr = new int;
+  ++RuntimeStats::local().data_allocs;
   *((int*)value_ptr) = val;
   value_type = DataType::INTEGER;
 }
 
-void DataObject::set(double val)
+inline void DataObject::set(double val)
 {
+  if (value_type == DataType::DOUBLE) {
+    *((double*)value_ptr) = val;
+    return;
+  }
   delete_obj();
   value_ptr = new double;
+  ++RuntimeStats::local().data_allocs;
   *((double*)value_ptr) = val;
   value_type = DataType::DOUBLE;
 }
 
-void DataObject::set(const char* val)
+inline void DataObject::set(const char* val)
 {
   delete_obj();
   value_ptr = new std::string;
+  ++RuntimeStats::local().data_allocs;
   *((std::string*)value_ptr) = val;
   value_type = DataType::STRING;
 }
 
-void DataObject::set(const std::string& val)
+inline void DataObject::set(const std::string& val)
 {
+  if (value_type == DataType::STRING) {
+    *((std::string*)value_ptr) = val;
+    return;
+  }
   delete_obj();
   value_ptr = new std::string;
+  ++RuntimeStats::local().data_allocs;
   *((std::string*)value_ptr) = val;
   value_type = DataType::STRING;
 }
 
-void DataObject::set(char val)
+inline void DataObject::set(char val)
 {
+  if (value_type == DataType::CHAR) {
+    *((char*)value_ptr) = val;
+    return;
+  }
   delete_obj();
   value_ptr = new char;
+  ++RuntimeStats::local().data_allocs;
   *((char*)value_ptr) = val;
   value_type = DataType::CHAR;
 }
 
-void DataObject::set(bool val)
+inline void DataObject::set(bool val)
 {
+  if (value_type == DataType::BOOL) {
+    *((bool*)value_ptr) = val;
+    return;
+  }
   delete_obj();
   value_ptr = new bool;
+  ++RuntimeStats::local().data_allocs;
   *((bool*)value_ptr) = val;
   value_type = DataType::BOOL;
 }
 
-void DataObject::set(size_t val)
+inline void DataObject::set(size_t val)
 {
+  if (value_type == DataType::OID) {
+    *((size_t*)value_ptr) = val;
+    return;
+  }
   delete_obj();
   value_ptr = new size_t;
+  ++RuntimeStats::local().data_allocs;
   *((size_t*)value_ptr) = val;
   value_type = DataType::OID;
 }
 
-void DataObject::set_nil()
+inline void DataObject::set_nil()
 {
   delete_obj();
   value_ptr = nullptr;
@@ -260,42 +326,42 @@ void DataObject::set_nil()
 // GET TYPE
 //----------------------------------------------------------------------
 
-DataObject::DataType DataObject::type() const
+inline DataObject::DataType DataObject::type() const
 {
   return value_type;
 }
 
-bool DataObject::is_nil() const
+inline bool DataObject::is_nil() const
 {
   return type() == DataType::NIL;
 }
 
-bool DataObject::is_integer() const
+inline bool DataObject::is_integer() const
 {
   return type() == DataType::INTEGER;
 }
 
-bool DataObject::is_double() const
+inline bool DataObject::is_double() const
 {
   return type() == DataType::DOUBLE;
 }
 
-bool DataObject::is_string() const
+inline bool DataObject::is_string() const
 {
   return type() == DataType::STRING;
 }
 
-bool DataObject::is_char() const
+inline bool DataObject::is_char() const
 {
   return type() == DataType::CHAR;
 }
 
-bool DataObject::is_bool() const
+inline bool DataObject::is_bool() const
 {
   return type() == DataType::BOOL;
 }
 
-bool DataObject::is_oid() const
+inline bool DataObject::is_oid() const
 {
   return type() == DataType::OID;
 }
@@ -305,7 +371,7 @@ bool DataObject::is_oid() const
 // GET THE VALUE
 //----------------------------------------------------------------------
 
-bool DataObject::value(int& val) const
+inline bool DataObject::value(int& val) const
 {
   if (value_type != DataType::INTEGER or !value_ptr)
     return false;
@@ -313,7 +379,7 @@ bool DataObject::value(int& val) const
   return true;
 }
 
-bool DataObject::value(double& val) const
+inline bool DataObject::value(double& val) const
 {
   if (value_type != DataType::DOUBLE or !value_ptr)
     return false;
@@ -321,7 +387,7 @@ bool DataObject::value(double& val) const
   return true;
 }
 
-bool DataObject::value(std::string& val) const
+inline bool DataObject::value(std::string& val) const
 {
   if (value_type != DataType::STRING or !value_ptr)
     return false;
@@ -329,7 +395,7 @@ bool DataObject::value(std::string& val) const
   return true;
 }
 
-bool DataObject::value(char& val) const
+inline bool DataObject::value(char& val) const
 {
   if (value_type != DataType::CHAR or !value_ptr)
     return false;
@@ -337,7 +403,7 @@ bool DataObject::value(char& val) const
   return true;
 }
 
-bool DataObject::value(bool& val) const
+inline bool DataObject::value(bool& val) const
 {
   if (value_type != DataType::BOOL or !value_ptr)
     return false;
@@ -345,7 +411,7 @@ bool DataObject::value(bool& val) const
   return true;
 }
 
-bool DataObject::value(size_t& val) const
+inline bool DataObject::value(size_t& val) const
 {
   if (value_type != DataType::OID or !value_ptr)
     return false;
@@ -358,7 +424,7 @@ bool DataObject::value(size_t& val) const
 // GET A STRING REPRESENTATION
 //----------------------------------------------------------------------
 
-std::string DataObject::to_string() const
+inline std::string DataObject::to_string() const
 {
   if (!value_ptr or value_type == DataType::NIL)
     return "";
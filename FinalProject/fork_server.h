@@ -0,0 +1,295 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: fork_server.h
+// DATE: Spring 2021
+// DESC: A fork server for MyPL programs (mypl --fork-server) and its
+//       client (mypl --fork-client). The server compiles a set of
+//       programs when it starts (see mypl_api.h), then forks a child for
+//       each request; the child shares the compiled program with the
+//       server copy-on-write and runs main right away, reading from and
+//       printing to the client's own standard streams, which the client
+//       passes over the Unix domain socket (SCM_RIGHTS). The child
+//       sends back the exit code. The server itself never runs a
+//       program and has no other threads, so forking it is safe.
+//
+//       A request is one byte carrying the three descriptors, then a
+//       frame (see compile_server.h) with the program's absolute path;
+//       the reply is a frame with the exit code as text. A program that
+//       was not loaded, or whose file has changed, is compiled before
+//       the fork and kept for later requests. A connection whose request
+//       doesn't arrive within REQUEST_TIMEOUT_MS is closed.
+//----------------------------------------------------------------------
+
+#ifndef FORK_SERVER_H
+#define FORK_SERVER_H
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <limits.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "mypl_api.h"
+#include "compile_server.h"
+
+
+class ForkServer
+{
+public:
+
+  // serve on the socket at path
+  explicit ForkServer(const std::string& path) : path(path) {}
+  ~ForkServer();
+
+  // compile the program ahead of any request; false (with the error on
+  // log) if it can't be read or compiled
+  bool load(const std::string& program_file, std::ostream& log);
+
+  // accept and run requests until the process is stopped; returns 1 if
+  // the socket cannot be opened or accepting connections fails (see
+  // CompileServer::accept_failed; reported on log)
+  int serve(std::ostream& log);
+
+  // send a request to run program with the given standard streams to
+  // the server at path (on an open connection, see
+  // CompileServer::connect_to)
+  static bool send_request(int fd, const std::string& program, int in, int out, int err);
+
+  // have the server at path run program on this process's standard
+  // streams; returns the program's exit code, or 1 (with a message on
+  // err) if the server can't be reached
+  static int client(const std::string& path, const std::string& program, std::ostream& err);
+
+private:
+
+  // a loaded program, or the error compiling it
+  struct Entry
+  {
+    std::string source;
+    CompiledProgram* program = nullptr;
+    std::string error;
+  };
+
+  std::string path;
+  std::unordered_map<std::string, Entry> programs;     // by absolute path
+
+  // how long a client may take to send its request; the server reads
+  // requests one at a time, so a stalled client would hold up the rest
+  static const int REQUEST_TIMEOUT_MS = 2000;
+
+  // the entry for the file, compiling it if it is new or has changed
+  Entry& entry(const std::string& program_file);
+
+  // receive a request; false if it is incomplete
+  static bool recv_request(int fd, std::string& program, int fds[3]);
+
+  // in the child: run the program on the client's streams and exit
+  void run_child(int conn, const int fds[3], const Entry& entry);
+};
+
+
+ForkServer::~ForkServer()
+{
+  for (auto& p : programs)
+    delete p.second.program;
+}
+
+
+ForkServer::Entry& ForkServer::entry(const std::string& program_file)
+{
+  Entry& e = programs[program_file];
+  std::ifstream file(program_file);
+  std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (!file) {
+    delete e.program;
+    e = Entry();
+    e.error = "cannot open " + program_file;
+    return e;
+  }
+  if (e.source == source and (e.program or e.error != ""))
+    return e;
+  delete e.program;
+  e.program = nullptr;
+  e.error = "";
+  e.source = source;
+  try {
+    e.program = CompiledProgram::compile(source);
+  }
+  catch (MyPLException& ex) {
+    e.error = ex.to_string();
+  }
+  return e;
+}
+
+
+bool ForkServer::load(const std::string& program_file, std::ostream& log)
+{
+  char resolved[PATH_MAX];
+  if (!realpath(program_file.c_str(), resolved)) {
+    log << "cannot open " << program_file << std::endl;
+    return false;
+  }
+  Entry& e = entry(resolved);
+  if (e.error != "")
+    log << program_file << ": " << e.error << std::endl;
+  return e.error == "";
+}
+
+
+bool ForkServer::send_request(int fd, const std::string& program, int in, int out, int err)
+{
+  char byte = 0;
+  iovec iov = {&byte, 1};
+  char control[CMSG_SPACE(3 * sizeof(int))] = {};
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+  int fds[3] = {in, out, err};
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  if (sendmsg(fd, &msg, MSG_NOSIGNAL) != 1)
+    return false;
+  return CompileServer::write_frame(fd, program);
+}
+
+
+bool ForkServer::recv_request(int fd, std::string& program, int fds[3])
+{
+  char byte;
+  iovec iov = {&byte, 1};
+  char control[CMSG_SPACE(3 * sizeof(int))] = {};
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  if (recvmsg(fd, &msg, 0) != 1)
+    return false;
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg or cmsg->cmsg_type != SCM_RIGHTS)
+    return false;
+  if (cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+    // don't keep descriptors from a malformed request
+    int count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (int i = 0; i < count; ++i) {
+      int extra;
+      memcpy(&extra, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+      close(extra);
+    }
+    return false;
+  }
+  memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+  if (!CompileServer::read_frame(fd, program)) {
+    for (int i = 0; i < 3; ++i)
+      close(fds[i]);
+    return false;
+  }
+  return true;
+}
+
+
+void ForkServer::run_child(int conn, const int fds[3], const Entry& entry)
+{
+  signal(SIGCHLD, SIG_DFL);
+  for (int i = 0; i < 3; ++i) {
+    dup2(fds[i], i);
+    close(fds[i]);
+  }
+  int code = 1;
+  if (!entry.program)
+    std::cout << entry.error << std::endl;
+  else {
+    try {
+      ExecutionContext context(*entry.program, std::cin, std::cout);
+      code = context.run();
+    }
+    catch (MyPLException& e) {
+      std::cout << e.to_string() << std::endl;
+    }
+  }
+  std::cout.flush();
+  CompileServer::write_frame(conn, std::to_string(code));
+  _exit(code);
+}
+
+
+int ForkServer::serve(std::ostream& log)
+{
+  // only this user may connect (see CompileServer::listen_on)
+  int listener = CompileServer::listen_on(path, log);
+  if (listener < 0)
+    return 1;
+  // children are reaped automatically; they report to their clients
+  signal(SIGCHLD, SIG_IGN);
+
+  while (true) {
+    int conn = accept(listener, nullptr, nullptr);
+    if (conn < 0) {
+      if (CompileServer::accept_failed(log))
+        continue;
+      close(listener);
+      return 1;
+    }
+    // a request that doesn't arrive in time is dropped (its descriptors
+    // are closed by recv_request)
+    timeval timeout;
+    timeout.tv_sec = REQUEST_TIMEOUT_MS / 1000;
+    timeout.tv_usec = REQUEST_TIMEOUT_MS % 1000 * 1000;
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    std::string program;
+    int fds[3];
+    if (recv_request(conn, program, fds)) {
+      Entry& e = entry(program);
+      pid_t pid = fork();
+      if (pid == 0) {
+        close(listener);
+        run_child(conn, fds, e);
+      }
+      if (pid < 0)
+        CompileServer::write_frame(conn, "1");
+      for (int i = 0; i < 3; ++i)
+        close(fds[i]);
+    }
+    close(conn);
+  }
+}
+
+
+int ForkServer::client(const std::string& path, const std::string& program, std::ostream& err)
+{
+  char resolved[PATH_MAX];
+  if (!realpath(program.c_str(), resolved)) {
+    err << "cannot open " << program << std::endl;
+    return 1;
+  }
+  int fd = CompileServer::connect_to(path);
+  if (fd < 0) {
+    err << "cannot connect to " << path << std::endl;
+    return 1;
+  }
+  std::string code;
+  bool ok = send_request(fd, resolved, 0, 1, 2) and CompileServer::read_frame(fd, code);
+  close(fd);
+  if (!ok) {
+    err << "connection to " << path << " lost" << std::endl;
+    return 1;
+  }
+  int exit_code;
+  if (!CompileServer::parse_code(code, exit_code)) {
+    err << "bad reply from " << path << std::endl;
+    return 1;
+  }
+  return exit_code;
+}
+
+#endif
@@ -16,6 +16,7 @@
 
 #include <unordered_map>
 #include "data_object.h"
+#include "runtime_stats.h"
 
 
 class HeapObject
@@ -87,6 +88,16 @@ public:
   //----------------------------------------------------------------------
   bool get_obj(size_t oid, HeapObject& obj) const;
 
+  //----------------------------------------------------------------------
+  // Get the heap object stored for the given oid, to read or update it
+  // in place.
+  // Inputs:
+  //   oid -- the oid to look up
+  // Returns:
+  //   the heap object, or nullptr if the oid is not in the heap
+  //----------------------------------------------------------------------
+  HeapObject* get_obj_slot(size_t oid);
+
 private:
   std::unordered_map<size_t, HeapObject> heap_objs;
 };
@@ -96,17 +107,17 @@ private:
 // HeapObject Member Functions
 //----------------------------------------------------------------------
 
-void HeapObject::set_att(const std::string& att, const DataObject& obj)
+inline void HeapObject::set_att(const std::string& att, const DataObject& obj)
 {
   attribute_values[att] = obj;
 }
 
-bool HeapObject::has_att(const std::string& att) const
+inline bool HeapObject::has_att(const std::string& att) const
 {
   return attribute_values.count(att) > 0;
 }
 
-bool HeapObject::get_val(const std::string& att, DataObject& val)
+inline bool HeapObject::get_val(const std::string& att, DataObject& val)
 {
   if (!has_att(att))
     return false;
@@ -119,19 +130,21 @@ bool HeapObject::get_val(const std::string& att, DataObject& val)
 // Heap Member Functions
 //----------------------------------------------------------------------
 
-void Heap::set_obj(size_t oid, const HeapObject& obj)
+inline void Heap::set_obj(size_t oid, const HeapObject& obj)
 {
+  if (heap_objs.count(oid) == 0)
+    ++RuntimeStats::local().heap_created;
   heap_objs[oid] = obj;
 }
 
 
-bool Heap::has_obj(size_t oid) const
+inline bool Heap::has_obj(size_t oid) const
 {
   return heap_objs.count(oid) > 0;
 }
 
 
-bool Heap::get_obj(size_t oid, HeapObject& obj) const
+inline bool Heap::get_obj(size_t oid, HeapObject& obj) const
 {
   if (!has_obj(oid))
     return false;
@@ -140,4 +153,13 @@ bool Heap::get_obj(size_t oid, HeapObject& obj) const
 }
 
 
+inline HeapObject* Heap::get_obj_slot(size_t oid)
+{
+  auto it = heap_objs.find(oid);
+  if (it == heap_objs.end())
+    return nullptr;
+  return &it->second;
+}
+
+
 #endif
@@ -0,0 +1,220 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: hw_counters.h
+// DATE: Spring 2021
+// DESC: Hardware performance counters read through perf_event_open:
+//       cycles, instructions, branch misses, L1 data cache, last-level
+//       cache, and data TLB read misses. Each counter is opened on its
+//       own, so counters the machine (or a VM, or perf_event_paranoid)
+//       does not allow are simply left out; when the kernel multiplexes
+//       counters the counts are scaled by the share of time they ran.
+//----------------------------------------------------------------------
+
+#ifndef HW_COUNTERS_H
+#define HW_COUNTERS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+
+class HwCounters
+{
+public:
+
+  enum Counter {CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, LLC_MISSES,
+                DTLB_MISSES, COUNT};
+
+  // counts at one point in time (or the difference of two); -1 marks a
+  // counter that is not available
+  struct Values
+  {
+    int64_t count[COUNT];
+    Values() {for (int i = 0; i < COUNT; ++i) count[i] = -1;}
+    Values operator-(const Values& rhs) const;
+  };
+
+  // count the given process and the threads and processes it creates
+  // (0 for the calling process); when on_exec is set counting starts
+  // at the process's next exec
+  HwCounters(pid_t pid = 0, bool on_exec = false);
+  ~HwCounters();
+
+  // true if at least one counter could be opened
+  bool available() const;
+
+  // the current counts
+  Values read() const;
+
+  // a short name for the counter (e.g. "llc-misses")
+  static const char* name(int counter);
+
+  // instructions per cycle, or -1 if either count is missing
+  static double ipc(const Values& v);
+
+  // column headings for report()
+  static std::string header();
+
+  // the counts and IPC as table columns ("n/a" for missing counters)
+  static std::string report(const Values& v);
+
+  // the counts as JSON members ("name": value, null if missing)
+  static std::string json(const Values& v);
+
+private:
+  int fds[COUNT];
+};
+
+
+HwCounters::Values HwCounters::Values::operator-(const Values& rhs) const
+{
+  Values diff;
+  for (int i = 0; i < COUNT; ++i)
+    if (count[i] >= 0 and rhs.count[i] >= 0)
+      diff.count[i] = count[i] - rhs.count[i];
+  return diff;
+}
+
+
+HwCounters::HwCounters(pid_t pid, bool on_exec)
+{
+  // (type, config) of each counter, in Counter order
+  auto cache = [](uint64_t cache, uint64_t result) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+  };
+  const uint32_t types[COUNT] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+    PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE};
+  const uint64_t configs[COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS),
+    cache(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS),
+    cache(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_RESULT_MISS)};
+
+  for (int i = 0; i < COUNT; ++i) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = types[i];
+    attr.config = configs[i];
+    attr.disabled = on_exec ? 1 : 0;
+    attr.enable_on_exec = on_exec ? 1 : 0;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds[i] = syscall(__NR_perf_event_open, &attr, pid, -1, -1, 0);
+  }
+}
+
+
+HwCounters::~HwCounters()
+{
+  for (int i = 0; i < COUNT; ++i)
+    if (fds[i] >= 0)
+      close(fds[i]);
+}
+
+
+bool HwCounters::available() const
+{
+  for (int i = 0; i < COUNT; ++i)
+    if (fds[i] >= 0)
+      return true;
+  return false;
+}
+
+
+HwCounters::Values HwCounters::read() const
+{
+  Values v;
+  for (int i = 0; i < COUNT; ++i) {
+    // value, time enabled, time running
+    uint64_t data[3];
+    if (fds[i] < 0 or ::read(fds[i], data, sizeof(data)) != sizeof(data))
+      continue;
+    if (data[2] == 0)
+      v.count[i] = 0;
+    else if (data[2] < data[1])
+      v.count[i] = (int64_t)((double)data[0] * data[1] / data[2]);
+    else
+      v.count[i] = data[0];
+  }
+  return v;
+}
+
+
+const char* HwCounters::name(int counter)
+{
+  const char* names[COUNT] = {"cycles", "instructions", "branch-misses",
+                              "l1d-misses", "llc-misses", "dtlb-misses"};
+  return names[counter];
+}
+
+
+double HwCounters::ipc(const Values& v)
+{
+  if (v.count[CYCLES] <= 0 or v.count[INSTRUCTIONS] < 0)
+    return -1;
+  return (double)v.count[INSTRUCTIONS] / v.count[CYCLES];
+}
+
+
+std::string HwCounters::header()
+{
+  std::string s;
+  char buf[64];
+  for (int i = 0; i < COUNT; ++i) {
+    snprintf(buf, sizeof(buf), " %14s", name(i));
+    s += buf;
+  }
+  snprintf(buf, sizeof(buf), " %6s", "ipc");
+  return s + buf;
+}
+
+
+std::string HwCounters::report(const Values& v)
+{
+  std::string s;
+  char buf[64];
+  for (int i = 0; i < COUNT; ++i) {
+    if (v.count[i] >= 0)
+      snprintf(buf, sizeof(buf), " %14lld", (long long)v.count[i]);
+    else
+      snprintf(buf, sizeof(buf), " %14s", "n/a");
+    s += buf;
+  }
+  double i = ipc(v);
+  if (i >= 0)
+    snprintf(buf, sizeof(buf), " %6.2f", i);
+  else
+    snprintf(buf, sizeof(buf), " %6s", "n/a");
+  return s + buf;
+}
+
+
+std::string HwCounters::json(const Values& v)
+{
+  std::string s;
+  char buf[64];
+  for (int i = 0; i < COUNT; ++i) {
+    if (v.count[i] >= 0)
+      snprintf(buf, sizeof(buf), "\"%s\": %lld, ", name(i), (long long)v.count[i]);
+    else
+      snprintf(buf, sizeof(buf), "\"%s\": null, ", name(i));
+    s += buf;
+  }
+  double i = ipc(v);
+  if (i >= 0)
+    snprintf(buf, sizeof(buf), "\"ipc\": %.3f", i);
+  else
+    snprintf(buf, sizeof(buf), "\"ipc\": null");
+  return s + buf;
+}
+
+#endif
@@ -8,13 +8,28 @@
 #ifndef INTERPRETER_H
 #define INTERPRETER_H
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
 #include <iostream>
+#include <mutex>
 #include <unordered_map>
 #include <regex>
+#include <vector>
 #include "ast.h"
 #include "symbol_table.h"
 #include "data_object.h"
 #include "heap.h"
+#include "jit.h"
+#include "profiler.h"
+#include "line_profiler.h"
+#include "sample_profiler.h"
+#include "tracer.h"
+#include "thread_pool.h"
+#include "scheduler.h"
+#include "channel.h"
+#include "lazy_bodies.h"
 #include "mypl_exception.h"
 
 
@@ -42,6 +57,7 @@ public:
 
   // expressions
   void visit(Expr& node);
+  void visit(QuickExpr& node);
   void visit(SimpleTerm& node);
   void visit(ComplexTerm& node);
   // rvalues
@@ -51,32 +67,127 @@ public:
   void visit(IDRValue& node);
   void visit(NegatedRValue& node);
 
+  Interpreter();
+  ~Interpreter();
+
   // return code from calling main
   int return_code() const;
 
+  // wait for every spawned task, awaited or not, to finish (they use the
+  // program's AST, so this must happen before the program goes away)
+  void wait_for_tasks();
+
+  // run hot functions as native code once called threshold times
+  void enable_jit(int threshold);
+
+  // JIT statistics report (empty if the JIT is not enabled)
+  std::string jit_stats() const;
+
+  // record time and allocations for each user function call
+  void enable_profiler();
+
+  // the function profile (null if the profiler is not enabled)
+  const Profiler* profile() const;
+
+  // record executions and time for each statement's source line
+  void enable_line_profiler();
+
+  // the line profile (null if the line profiler is not enabled)
+  const LineProfiler* line_profile() const;
+
+  // sample the current function and line hz times per CPU second
+  void enable_sample_profiler(int hz);
+
+  // the sampling profiler (null if not enabled)
+  SampleProfiler* sample_profile();
+
+  // record calls and heap allocations as trace events
+  void set_tracer(Tracer* t);
+
+  // complete skimmed function bodies on their first call (see
+  // lazy_bodies.h)
+  void enable_lazy_bodies(LazyBodies* lazy) {lazy_bodies = lazy;}
+
+  // read from and print to the given streams instead of std::cin and
+  // std::cout (not owned)
+  void set_streams(std::istream& in, std::ostream& out);
+
 
 private:
 
   // return exception
   class MyPLReturnException : public std::exception {};
 
+  // exception raised by a throw statement, carrying the thrown value
+  // (reported as a runtime error if nothing catches it)
+  class MyPLThrowException : public MyPLException
+  {
+  public:
+    MyPLThrowException(const DataObject& val)
+      : MyPLException(RUNTIME, "uncaught exception '" + value_string(val) + "'"),
+        value(val) {}
+    // true if the catch value has the same type and value
+    bool matches(const DataObject& val) const;
+  private:
+    static std::string value_string(const DataObject& val);
+    DataObject value;
+  };
+
+  // how a catch clause selects the errors it handles
+  enum class CatchKind {NONE, ANY, ZERO_DIVISION, INDEX_OUT_OF_BOUNDS, VALUE};
+
+  // the resolved catch clause of each try statement
+  std::unordered_map<const CatchStmt*, CatchKind> handlers;
+
+  // true if the try statement's catch clause handles the error
+  bool handles(CatchStmt& node, const MyPLException& e);
+
   // the symbol table
   SymbolTable sym_table;
 
   // holds the previously computed value
   DataObject curr_val;
 
-  // the heap
-  Heap heap;
-
-  // the next oid
-  size_t next_oid = 0;
-
-  // the functions (all within the global environment)
-  std::unordered_map<std::string,FunDecl*> functions;
-
-  // the user-defined types (all within the global environment)
-  std::unordered_map<std::string,TypeDecl*> types;
+  // a spawned function call; its task handle is its index in spawned
+  struct Spawned
+  {
+    Task* task = nullptr;
+    DataObject result;
+    std::exception_ptr error;
+  };
+
+  // state shared by an interpreter and the workers running its
+  // parallel for loops and spawned tasks
+  struct Shared
+  {
+    Heap heap;
+    std::atomic<size_t> next_oid;
+    std::mutex heap_lock;
+    std::mutex io_lock;
+    std::atomic<int> concurrent;        // parallel loops and tasks running
+    std::deque<Spawned> spawned;
+    std::mutex spawn_lock;
+    // channels, by handle (like heap objects, they live until the end)
+    std::deque<Channel*> channels;
+    std::mutex channel_lock;
+    // the functions and types, by name
+    std::unordered_map<std::string,FunDecl*> functions;
+    std::unordered_map<std::string,TypeDecl*> types;
+    Shared() : next_oid(0), concurrent(0) {}
+    ~Shared() {for (Channel* c : channels) delete c;}
+  };
+
+  // the heap, next oid, and locks (owned unless this is a worker)
+  Shared* shared;
+
+  // true for the interpreters running parallel for iterations or tasks
+  bool worker = false;
+
+  // the functions and user-defined types (all within the global
+  // environment), kept in shared so the names workers pass to the
+  // tracer outlive the workers
+  std::unordered_map<std::string,FunDecl*>& functions;
+  std::unordered_map<std::string,TypeDecl*>& types;
 
   // the global environment id
   int global_env_id = 0;
@@ -84,42 +195,323 @@ private:
   // the program return code
   int ret_code = 0;
 
+  // user function calls in progress (see RuntimeStats::CallScope)
+  size_t call_depth = 0;
+
+  // the optional JIT tier
+  Jit* jit = nullptr;
+
+  // completes skimmed function bodies (with lazy parsing)
+  LazyBodies* lazy_bodies = nullptr;
+
+  // the optional function profiler
+  Profiler* profiler = nullptr;
+
+  // the optional statement (line) profiler
+  LineProfiler* line_profiler = nullptr;
+
+  // the optional sampling profiler
+  SampleProfiler* sampler = nullptr;
+
+  // the optional event tracer (not owned)
+  Tracer* tracer = nullptr;
+
+  // the streams read and print use (not owned)
+  std::istream* in_stream = &std::cin;
+  std::ostream* out_stream = &std::cout;
+
+  // execute a block of statements in order
+  void exec_stmts(const std::list<Stmt*>& stmts);
+
+  // a worker for the parent's parallel for loop or spawned task (shares
+  // its functions, types, heap, and tracer)
+  explicit Interpreter(Interpreter* parent);
+
+  // call a user-defined function with the given argument values
+  void call_function(const std::string& fun_name, std::list<DataObject>& params);
+
+  // start a task calling the function and return its handle
+  int spawn(const std::string& fun_name, const std::list<DataObject>& params);
+
+  // wait for the task with the given handle and set curr_val to its result
+  void await(int handle, const Token& token);
+
+  // evaluate the call's first argument to the channel it refers to
+  Channel* channel_arg(CallExpr& node);
+
+  // lock the heap (or the output streams) while workers are running
+  std::unique_lock<std::mutex> heap_guard();
+  std::unique_lock<std::mutex> io_guard();
+
+  // run the iterations of a parallel for on the thread pool
+  void parallel_for(ForStmt& node, int first, int last);
+
+  // set up a worker's environment for the loop: the captured variables,
+  // the private reduction variables, and the loop variable
+  void start_worker(ForStmt& node,
+                    const std::vector<std::pair<std::string,DataObject>>& captured,
+                    const std::vector<DataObject>& start_vals);
+
+  // run iterations first to last of the loop body in a worker
+  void run_iterations(ForStmt& node, long first, long last);
+
+  // combine a worker's partial result into a reduction's total
+  static void reduce(const std::string& op, DataObject& total, const DataObject& part);
+
+  // the heap object holding the last attribute of a path (x.y.z)
+  HeapObject* path_object(const std::list<Token>& path);
+
+  // run a compiled function on the evaluated arguments, returning
+  // false if an argument cannot be passed to native code
+  bool call_native(JitEntry* entry, FunDecl* fun, const std::list<DataObject>& params);
+
   // error message
   void error(const std::string& msg, const Token& token);
   void zerodiv_error(const std::string& msg);
   void index_error(const std::string& msg);
   void error(const std::string& msg);
+
+  // type-specialized expression helpers (by operand type)
+  void quick_int(QuickExpr& node);
+  void quick_double(QuickExpr& node);
+  void quick_string(QuickExpr& node);
+  void quick_bool(QuickExpr& node);
+  void quick_nil(QuickExpr& node, bool lhs_nil, bool rhs_nil);
 };
 
 
-int Interpreter::return_code() const
+inline bool Interpreter::MyPLThrowException::matches(const DataObject& val) const
+{
+  if (val.type() != value.type())
+    return false;
+  if (value.is_integer()) {
+    int x, y;
+    value.value(x);
+    val.value(y);
+    return x == y;
+  }
+  else if (value.is_double()) {
+    double x, y;
+    value.value(x);
+    val.value(y);
+    return x == y;
+  }
+  else if (value.is_bool()) {
+    bool x, y;
+    value.value(x);
+    val.value(y);
+    return x == y;
+  }
+  return false;
+}
+
+inline std::string Interpreter::MyPLThrowException::value_string(const DataObject& val)
+{
+  bool b;
+  if (val.is_bool() and val.value(b))
+    return b ? "true" : "false";
+  return val.to_string();
+}
+
+inline Interpreter::Interpreter()
+  : shared(new Shared), functions(shared->functions), types(shared->types)
+{
+}
+
+inline Interpreter::Interpreter(Interpreter* parent)
+  : shared(parent->shared), worker(true), functions(parent->functions),
+    types(parent->types), lazy_bodies(parent->lazy_bodies), tracer(parent->tracer),
+    in_stream(parent->in_stream), out_stream(parent->out_stream)
+{
+}
+
+inline Interpreter::~Interpreter()
+{
+  if (!worker)
+  {
+    //  Tasks still running use the shared heap, so let them finish
+    wait_for_tasks();
+    for (Spawned& s : shared->spawned)
+      delete s.task;
+    delete shared;
+  }
+  delete jit;
+  delete profiler;
+  delete line_profiler;
+  delete sampler;
+}
+
+inline void Interpreter::wait_for_tasks()
+{
+  //  A task may spawn more while we wait, so recheck the count each time
+  for (size_t i = 0; ; ++i)
+  {
+    Task* task;
+    {
+      std::lock_guard<std::mutex> guard(shared->spawn_lock);
+      if (i >= shared->spawned.size())
+        return;
+      task = shared->spawned[i].task;
+    }
+    Scheduler::global().await(task);
+  }
+}
+
+inline int Interpreter::return_code() const
 {
   return ret_code;
 }
 
-void Interpreter::error(const std::string& msg, const Token& token)
+inline void Interpreter::enable_jit(int threshold)
+{
+  delete jit;
+  jit = new Jit(functions, threshold);
+}
+
+inline std::string Interpreter::jit_stats() const
+{
+  if (!jit)
+    return "";
+  return jit->stats();
+}
+
+inline void Interpreter::enable_profiler()
+{
+  if (!profiler)
+    profiler = new Profiler;
+}
+
+inline const Profiler* Interpreter::profile() const
+{
+  return profiler;
+}
+
+inline void Interpreter::enable_line_profiler()
+{
+  if (!line_profiler)
+    line_profiler = new LineProfiler;
+}
+
+inline const LineProfiler* Interpreter::line_profile() const
+{
+  return line_profiler;
+}
+
+inline void Interpreter::enable_sample_profiler(int hz)
+{
+  if (!sampler)
+    sampler = new SampleProfiler(hz);
+}
+
+inline SampleProfiler* Interpreter::sample_profile()
+{
+  return sampler;
+}
+
+inline void Interpreter::set_tracer(Tracer* t)
+{
+  tracer = t;
+}
+
+inline void Interpreter::set_streams(std::istream& in, std::ostream& out)
+{
+  in_stream = &in;
+  out_stream = &out;
+}
+
+inline HeapObject* Interpreter::path_object(const std::list<Token>& path)
+{
+  DataObject val;
+  sym_table.get_val_info(path.front().lexeme(), val);
+  auto it = std::next(path.begin());
+  while (true)
+  {
+    size_t oid;
+    if (!val.value(oid))
+      error("Runtime Error| Cannot access '" + it->lexeme() + "' of a nil value", *it);
+    HeapObject* obj = shared->heap.get_obj_slot(oid);
+    if (std::next(it) == path.end())
+      return obj;
+    obj->get_val(it->lexeme(), val);
+    ++it;
+  }
+}
+
+inline void Interpreter::exec_stmts(const std::list<Stmt*>& stmts)
+{
+  //  Only pay for a profiler check once per block when it is disabled
+  if (!line_profiler and !sampler) {
+    for (Stmt* s : stmts)
+      s->accept(*this);
+    return;
+  }
+  for (Stmt* s : stmts) {
+    if (sampler)
+      sampler->set_line(s->line);
+    if (line_profiler) {
+      LineProfiler::Scope scope(line_profiler, s->line);
+      s->accept(*this);
+    }
+    else
+      s->accept(*this);
+  }
+}
+
+inline bool Interpreter::call_native(JitEntry* entry, FunDecl* fun,
+                              const std::list<DataObject>& params)
+{
+  std::vector<long> args;
+  for (const DataObject& p : params)
+  {
+    int i;
+    bool b;
+    if (p.value(i))
+      args.push_back(i);
+    else if (p.value(b))
+      args.push_back(b);
+    else
+      return false;
+  }
+
+  long result;
+  JitContext::ErrorCode code;
+  if (!jit->run(entry, args.data(), result, code))
+  {
+    if (code == JitContext::ZERO_DIVISION)
+      zerodiv_error("Runtime Error| Division by Zero error");
+    error("Runtime Error| Maximum recursion depth exceeded", fun->id);
+  }
+
+  if (fun->return_type.lexeme() == "bool")
+    curr_val.set(result != 0);
+  else
+    curr_val.set((int)result);
+  return true;
+}
+
+inline void Interpreter::error(const std::string& msg, const Token& token)
 {
   throw MyPLException(RUNTIME, msg, token.line(), token.column());
 }
 
-void Interpreter::error(const std::string& msg)
+inline void Interpreter::error(const std::string& msg)
 {
   throw MyPLException(RUNTIME, msg);
 }
 
 //  Final project error methods
-void Interpreter::zerodiv_error(const std::string& msg)
+inline void Interpreter::zerodiv_error(const std::string& msg)
 {
   throw MyPLException(ZERODIVISION, msg);
 }
 
-void Interpreter::index_error(const std::string& msg)
+inline void Interpreter::index_error(const std::string& msg)
 {
   throw MyPLException(INDEXOUTOFBOUNDS, msg);
 }
 
 // top-level
-void Interpreter::visit(Program& node)
+inline void Interpreter::visit(Program& node)
 {
   //  Push global environment
   sym_table.push_environment();
@@ -139,128 +531,41 @@ void Interpreter::visit(Program& node)
 }
 
 //  FunDecl visitor
-void Interpreter::visit(FunDecl& node)
+inline void Interpreter::visit(FunDecl& node)
 {
-  //  Declare new FunDecl
-  FunDecl* temp = new FunDecl;
-  temp = &node;
   //  Add the key value pair of the function id and the node to the function map
-  functions[node.id.lexeme()] = temp;
+  functions[node.id.lexeme()] = &node;
 }
 
 //  TypeDecl visitor
-void Interpreter::visit(TypeDecl& node)
+inline void Interpreter::visit(TypeDecl& node)
 {
-  //  Declare new TypeDecl
-  TypeDecl* temp = new TypeDecl;
-  temp = &node;
   //  Add the key value pair of the type id and the node to the type map
-  types[node.id.lexeme()] = temp;
+  types[node.id.lexeme()] = &node;
 }
 
 //  stmts
 //  VarDeclStmt visitor
-void Interpreter::visit(VarDeclStmt& node)
+inline void Interpreter::visit(VarDeclStmt& node)
 {
-  //  Get curr type from the expression
+  //  Get the initial value (of any type, including oids and nil) and
+  //  declare the variable with it
   node.expr->accept(*this);
-  //  Find type of curr_val
-  if (curr_val.is_integer())
-  {
-    int v;
-    curr_val.value(v);
-    DataObject new_val(v);
-    sym_table.add_name(node.id.lexeme());
-    sym_table.set_val_info(node.id.lexeme(), new_val);
-  }
-
-  else if (curr_val.is_double())
-  {
-    double v;
-    curr_val.value(v);
-    DataObject new_val(v);
-    sym_table.add_name(node.id.lexeme());
-    sym_table.set_val_info(node.id.lexeme(), new_val);
-  }
-
-  else if (curr_val.is_char())
-  {
-    char v;
-    curr_val.value(v);
-    DataObject new_val(v);
-    sym_table.add_name(node.id.lexeme());
-    sym_table.set_val_info(node.id.lexeme(), new_val);
-  }
-
-  else if (curr_val.is_string())
-  {
-    std::string v;
-    curr_val.value(v);
-    DataObject new_val(v);
-    sym_table.add_name(node.id.lexeme());
-    sym_table.set_val_info(node.id.lexeme(), new_val);
-  }
-
-  else if (curr_val.is_bool())
-  {
-    bool v;
-    curr_val.value(v);
-    DataObject new_val(v);
-    sym_table.add_name(node.id.lexeme());
-    sym_table.set_val_info(node.id.lexeme(), new_val);
-  }
-
-  else if (curr_val.is_nil())
-  {
-    //  Set the data object to nil
-    DataObject new_val = new DataObject();
-    new_val.set_nil();
-    sym_table.add_name(node.id.lexeme());
-    sym_table.set_val_info(node.id.lexeme(), new_val);
-  }
+  sym_table.add_name(node.id.lexeme());
+  sym_table.set_val_info(node.id.lexeme(), curr_val);
 }
 
 //  AssignStmt visitor
-void Interpreter::visit(AssignStmt& node)
+inline void Interpreter::visit(AssignStmt& node)
 {
   //  Get value of the right hand side type
   node.expr->accept(*this);
 
-  //  Treat the assignment as an idr val
+  //  Assign into the attribute of an object
   if (node.lvalue_list.size() > 1)
   {
-    DataObject head_val;
-    if (sym_table.has_val_info(node.lvalue_list.front().lexeme()))
-      sym_table.get_val_info(node.lvalue_list.front().lexeme(), head_val);
-
-    //  Check for assignment into a var that is defined as nil
-    if (head_val.is_nil())
-      error ("Runtime Error| Cannot assign into a value that is declared as nil");
-
-    //  Copy token path for iteration and pop head element
-    std::list<Token> node_path = node.lvalue_list;
-    node_path.pop_front();
-
-    while (node_path.size() > 1)
-    {
-      //  Get value of heap obj
-      HeapObject obj;
-      size_t oid;
-      head_val.value(oid);
-      heap.get_obj(oid, obj);
-
-      //  Check if the object has a value stored in the heap
-      if (obj.has_att(node_path.front().lexeme()))
-        obj.get_val(node_path.front().lexeme(), head_val);
-      node_path.pop_front();
-    }
-
-    HeapObject new_val;
-    size_t new_oid;
-    head_val.value(new_oid);
-    heap.get_obj(new_oid, new_val);
-    if (new_val.has_att(node_path.front().lexeme()))
-      new_val.set_att(node_path.front().lexeme(), curr_val);
+    std::unique_lock<std::mutex> guard = heap_guard();
+    path_object(node.lvalue_list)->set_att(node.lvalue_list.back().lexeme(), curr_val);
   }
 
   //  Assign into the a single variable
@@ -269,14 +574,14 @@ void Interpreter::visit(AssignStmt& node)
 }
 
 //  Return stmt visitor
-void Interpreter::visit(ReturnStmt& node)
+inline void Interpreter::visit(ReturnStmt& node)
 {
   node.expr->accept(*this);
   throw new MyPLReturnException;
 }
 
 //  If Stmt visitor
-void Interpreter::visit(IfStmt& node)
+inline void Interpreter::visit(IfStmt& node)
 {
   node.if_part->expr->accept(*this);
   bool val;
@@ -287,8 +592,7 @@ void Interpreter::visit(IfStmt& node)
   if (val)
   {
     sym_table.push_environment();
-    for (Stmt* s : node.if_part->stmts)
-      s->accept(*this);
+    exec_stmts(node.if_part->stmts);
     sym_table.pop_environment();
     condition = true;
   }
@@ -305,11 +609,11 @@ void Interpreter::visit(IfStmt& node)
       if (val)
       {
         sym_table.push_environment();
-        for (Stmt* s : new_if->stmts)
-          s->accept(*this);
+        exec_stmts(new_if->stmts);
         sym_table.pop_environment();
         condition = true;
       }
+      elseifs.pop_front();
     }
   }
 
@@ -317,15 +621,14 @@ void Interpreter::visit(IfStmt& node)
   if (condition == false && node.body_stmts.size() > 0)
   {
     sym_table.push_environment();
-    for (Stmt* s : node.body_stmts)
-      s->accept(*this);
+    exec_stmts(node.body_stmts);
     sym_table.pop_environment();
     condition = true;
   }
 }
 
 //  WhileStmt visitor
-void Interpreter::visit(WhileStmt& node)
+inline void Interpreter::visit(WhileStmt& node)
 {
   //  Get value of the boolean loop continue flag
   node.expr->accept(*this);
@@ -337,8 +640,7 @@ void Interpreter::visit(WhileStmt& node)
   while (val)
   {
     //  Get value of each statement
-    for (Stmt* s : node.stmts)
-      s->accept(*this);
+    exec_stmts(node.stmts);
 
     //  Check if the loop should continue
     node.expr->accept(*this);
@@ -348,29 +650,45 @@ void Interpreter::visit(WhileStmt& node)
 }
 
 //  ForStmt visitor
-void Interpreter::visit(ForStmt& node)
+inline void Interpreter::visit(ForStmt& node)
 {
-  int start_val;
-  int end_val;
-  //  Push new environment and add loop var to sym table
+  int start_val = 0;
+  int end_val = 0;
+  std::string var = node.var_id.lexeme();
+  //  Push new environment for the loop var and evaluate start (once)
   sym_table.push_environment();
   node.start->accept(*this);
-  //  Add loop var's value to the symbol table
   curr_val.value(start_val);
-  sym_table.add_name(node.var_id.lexeme());
-  sym_table.set_val_info(node.var_id.lexeme(), curr_val);
+  sym_table.add_name(var);
+  sym_table.set_val_info(var, DataObject(start_val));
+  //  Evaluate end expr (once, with the loop var in scope)
   node.end->accept(*this);
-  //  Evaluate end expr
   curr_val.value(end_val);
 
+  //  Iterations of a parallel loop run on the thread pool (loops
+  //  nested in a worker run sequentially)
+  if (node.parallel && !worker && end_val > start_val)
+  {
+    parallel_for(node, start_val, end_val);
+    sym_table.pop_environment();
+    return;
+  }
+
+  //  The loop var stays in a fixed slot for the whole loop, so each
+  //  iteration writes the native counter straight into it
+  DataObject* slot = sym_table.get_val_slot(var);
+
   //  Push loop environment
   sym_table.push_environment();
-  for (int i = start_val; i < end_val; i++)
+  for (int i = start_val; i <= end_val; ++i)
   {
-    //  All statements in loop to be iterated through
-    std::list<Stmt*> stmt_list = node.stmts;
-    for (Stmt* s: stmt_list)
-      s->accept(*this);
+    slot->set(i);
+    exec_stmts(node.stmts);
+    //  Pick up any assignment the body made to the loop var
+    slot->value(i);
+    //  Stop before the increment could overflow (end_val == INT_MAX)
+    if (i >= end_val)
+      break;
   }
   //  Pop loop environment
   sym_table.pop_environment();
@@ -378,151 +696,254 @@ void Interpreter::visit(ForStmt& node)
   sym_table.pop_environment();
 }
 
-//  Final project declarations
+inline std::unique_lock<std::mutex> Interpreter::heap_guard()
+{
+  std::unique_lock<std::mutex> guard(shared->heap_lock, std::defer_lock);
+  if (shared->concurrent)
+    guard.lock();
+  return guard;
+}
 
-void Interpreter::visit(TryStmt& node)
+inline std::unique_lock<std::mutex> Interpreter::io_guard()
 {
-  //  Flag to indicate an error was triggered or a value was thrown
-  bool flag_raised = false;
-  bool raise_bool = false;
-  bool raise_int = false;
-  bool raise_double = false;
-  //  If a catch stmt exists, store the value of the catch expression and ensure it isnt reached
-  DataObject catch_val;
-
-  //  Check if catch stmt exists
-  if (node.catch_stmt->catch_expr)
+  std::unique_lock<std::mutex> guard(shared->io_lock, std::defer_lock);
+  if (shared->concurrent)
+    guard.lock();
+  return guard;
+}
+
+inline void Interpreter::parallel_for(ForStmt& node, int first, int last)
+{
+  //  Workers start from copies of the variables the body reads and of
+  //  the reduction variables
+  std::vector<std::pair<std::string,DataObject>> captured;
+  for (const std::string& name : node.captures)
   {
-    //  Get value of catch stmt
-    node.catch_stmt->catch_expr->accept(*this);
-    //  If the value is an integer, store it
-    if (curr_val.is_integer())
-    {
-      raise_int = true;
-      int val;
-      curr_val.value(val);
-      catch_val.set(val);
-    }
+    DataObject val;
+    sym_table.get_val_info(name, val);
+    captured.push_back(std::make_pair(name, val));
+  }
+  std::vector<DataObject> start_vals;
+  for (const ForStmt::Reduction& r : node.reductions)
+  {
+    DataObject val;
+    sym_table.get_val_info(r.var_id.lexeme(), val);
+    start_vals.push_back(val);
+  }
 
-    //  If the value is an double, store it
-    else if(curr_val.is_double())
-    {
-      raise_double = true;
-      double val;
-      curr_val.value(val);
-      catch_val.set(val);
-    }
+  //  One worker interpreter per pool thread, created by the thread
+  //  itself when it runs its first chunk
+  ThreadPool& pool = ThreadPool::global();
+  std::vector<Interpreter*> workers(pool.size(), nullptr);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::mutex error_lock;
+  ++shared->concurrent;
+  pool.parallel_for(first, last, 0, [&](int id, long lo, long hi) {
+      //  After an error the remaining chunks are skipped
+      if (failed)
+        return;
+      try
+      {
+        if (!workers[id])
+        {
+          workers[id] = new Interpreter(this);
+          workers[id]->start_worker(node, captured, start_vals);
+        }
+        workers[id]->run_iterations(node, lo, hi);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> guard(error_lock);
+        if (!failed)
+          error = std::current_exception();
+        failed = true;
+      }
+    });
+  --shared->concurrent;
 
-    //  If the value is an boolean, store it
-    else if(curr_val.is_bool())
+  //  Combine the workers' partial results into the reduction variables
+  if (!failed)
+  {
+    int i = 0;
+    for (const ForStmt::Reduction& r : node.reductions)
     {
-      raise_bool = true;
-      bool val;
-      curr_val.value(val);
-      catch_val.set(val);
+      DataObject total = start_vals[i++];
+      for (Interpreter* w : workers)
+      {
+        if (!w)
+          continue;
+        DataObject part;
+        w->sym_table.get_val_info(r.var_id.lexeme(), part);
+        reduce(r.op.lexeme(), total, part);
+      }
+      sym_table.set_val_info(r.var_id.lexeme(), total);
     }
   }
+  for (Interpreter* w : workers)
+    delete w;
+  if (failed)
+    std::rethrow_exception(error);
+}
 
-  //  Iterate through stmts and check that a the throw value isn't ever thrown, or
-  //  the specified error is reached
-
-  //  push a temp environment
+inline void Interpreter::start_worker(ForStmt& node,
+                               const std::vector<std::pair<std::string,DataObject>>& captured,
+                               const std::vector<DataObject>& start_vals)
+{
+  sym_table.push_environment();
+  global_env_id = sym_table.get_environment_id();
   sym_table.push_environment();
-  //  Copy all stmts
-  std::list<Stmt*> try_stmts = node.stmts;
-  //  Iterate through all stmts
-  while (try_stmts.size() > 0)
+  for (const std::pair<std::string,DataObject>& c : captured)
   {
-    try
+    sym_table.add_name(c.first);
+    sym_table.set_val_info(c.first, c.second);
+  }
+  //  Sums start from zero; min and max from the value before the loop
+  int i = 0;
+  for (const ForStmt::Reduction& r : node.reductions)
+  {
+    DataObject start = start_vals[i++];
+    if (r.op.lexeme() == "sum")
     {
-      try_stmts.front()->accept(*this);
-    } catch (MyPLException e) {
-      //  If an exception exists, check that it matches the id of the error in CatchStmt
-      //  then stop iterating if it is the same
-      flag_raised = true;
-      if (e.get_type() == ZERODIVISION && node.catch_stmt->error_id.lexeme() == "ZeroDivision")
-        break;
-      else if (e.get_type() == INDEXOUTOFBOUNDS && node.catch_stmt->error_id.lexeme() == "IndexOutOfBounds")
-        break;
+      if (start.is_integer())
+        start.set(0);
       else
-        throw e;
+        start.set(0.0);
     }
+    sym_table.add_name(r.var_id.lexeme());
+    sym_table.set_val_info(r.var_id.lexeme(), start);
+  }
+  sym_table.add_name(node.var_id.lexeme());
+  sym_table.set_val_info(node.var_id.lexeme(), DataObject(0));
+  //  The body environment, shared by all iterations as in a sequential loop
+  sym_table.push_environment();
+}
 
-    //  Check if the int value is equal to the value to be raised
-    if (raise_int && curr_val.is_integer())
-    {
-      int cth_val;
-      int stmt_val;
-      catch_val.value(cth_val);
-      curr_val.value(stmt_val);
+inline void Interpreter::run_iterations(ForStmt& node, long first, long last)
+{
+  DataObject* slot = sym_table.get_val_slot(node.var_id.lexeme());
+  for (long i = first; i <= last; ++i)
+  {
+    slot->set((int)i);
+    exec_stmts(node.stmts);
+  }
+}
 
-      //  If it is, break the evaluation loop and move to catch stmt handling
-      if (cth_val == stmt_val)
-      {
-        flag_raised = true;
-        break;
-      }
-    }
+inline void Interpreter::reduce(const std::string& op, DataObject& total, const DataObject& part)
+{
+  if (total.is_integer())
+  {
+    int x, y;
+    total.value(x);
+    part.value(y);
+    if (op == "sum")
+      total.set(x + y);
+    else if (op == "min")
+      total.set(std::min(x, y));
+    else
+      total.set(std::max(x, y));
+  }
+  else
+  {
+    double x, y;
+    total.value(x);
+    part.value(y);
+    if (op == "sum")
+      total.set(x + y);
+    else if (op == "min")
+      total.set(std::min(x, y));
+    else
+      total.set(std::max(x, y));
+  }
+}
 
-    //  Check if the double value is equal to the value to be raised
-    if (raise_double && curr_val.is_double())
-    {
-      double cth_val;
-      double stmt_val;
-      catch_val.value(cth_val);
-      curr_val.value(stmt_val);
+//  Final project declarations
 
-      //  If it is, break the evaluation loop and move to catch stmt handling
-      if (cth_val == stmt_val)
-      {
-        flag_raised = true;
-        break;
-      }
-    }
+inline void Interpreter::visit(TryStmt& node)
+{
+  //  The body runs inside a single C++ try, so it costs nothing unless
+  //  an error or a thrown value actually reaches this statement
+  sym_table.push_environment();
+  int try_env = sym_table.get_environment_id();
+  try
+  {
+    exec_stmts(node.stmts);
+  } catch (MyPLException& e) {
+    //  Pop any block environments the error jumped out of
+    while (sym_table.get_environment_id() != try_env)
+      sym_table.pop_environment();
+    sym_table.pop_environment();
+    if (!handles(*node.catch_stmt, e))
+      throw;
+    node.catch_stmt->accept(*this);
+    return;
+  }
+  sym_table.pop_environment();
+}
 
-    //  Check if the bool value is equal to the value to be raised
-    if (raise_bool && curr_val.is_bool())
-    {
-      bool cth_val;
-      bool stmt_val;
-      catch_val.value(cth_val);
-      curr_val.value(stmt_val);
+inline bool Interpreter::handles(CatchStmt& node, const MyPLException& e)
+{
+  //  Resolve the clause once, on the first error that reaches it
+  auto entry = handlers.find(&node);
+  if (entry == handlers.end())
+  {
+    CatchKind kind = CatchKind::NONE;
+    if (node.catch_expr)
+      kind = CatchKind::VALUE;
+    else if (node.error_id.lexeme() == "ZeroDivision")
+      kind = CatchKind::ZERO_DIVISION;
+    else if (node.error_id.lexeme() == "IndexOutOfBounds")
+      kind = CatchKind::INDEX_OUT_OF_BOUNDS;
+    else if (node.error_id.lexeme() == "")
+      kind = CatchKind::ANY;
+    entry = handlers.insert({&node, kind}).first;
+  }
 
-      //  If it is, break the evaluation loop and move to catch stmt handling
-      if (cth_val == stmt_val)
-      {
-        flag_raised = true;
-        break;
-      }
-    }
+  //  Front-end errors from a body parsed on its first call (see
+  //  lazy_bodies.h) end the program, as they would have before it ran
+  if (e.get_type() == SYNTAX || e.get_type() == SEMANTIC)
+    return false;
 
-    try_stmts.pop_front();
+  switch (entry->second)
+  {
+    case CatchKind::ANY:
+      return true;
+    case CatchKind::ZERO_DIVISION:
+      return e.get_type() == ZERODIVISION;
+    case CatchKind::INDEX_OUT_OF_BOUNDS:
+      return e.get_type() == INDEXOUTOFBOUNDS;
+    case CatchKind::VALUE:
+    {
+      //  Only thrown values can match, and the catch value is only
+      //  evaluated once one arrives
+      const MyPLThrowException* t = dynamic_cast<const MyPLThrowException*>(&e);
+      if (!t)
+        return false;
+      node.catch_expr->accept(*this);
+      return t->matches(curr_val);
+    }
+    default:
+      return false;
   }
-  sym_table.pop_environment();
-
-  //  If an error was triggered properly or a value was raised that matches, evaluate the
-  //  Catch stmt
-  if (flag_raised)
-    node.catch_stmt->accept(*this);
 }
 
-void Interpreter::visit(CatchStmt& node)
+inline void Interpreter::visit(CatchStmt& node)
 {
   sym_table.push_environment();
-  for (Stmt* s : node.stmts)
-    s->accept(*this);
+  exec_stmts(node.stmts);
   sym_table.pop_environment();
 }
 
-void Interpreter::visit(ThrowStmt& node)
+inline void Interpreter::visit(ThrowStmt& node)
 {
-  //  Get value of expression in throw stmt
+  //  Raise the value of the expression to the nearest matching catch
   node.expr->accept(*this);
+  throw MyPLThrowException(curr_val);
 }
 
 // expressions
 //  Expr Visitor
-void Interpreter::visit(Expr& node)
+inline void Interpreter::visit(Expr& node)
 {
   //  Negated Expression
   if (node.negated)
@@ -547,8 +968,15 @@ void Interpreter::visit(Expr& node)
       TokenType op = node.op->type();
 
       /*  Check all operators and their value cases */
+      //  Comparisons with nil (nil only equals nil)
+      if ((op == EQUAL or op == NOT_EQUAL) and (lhs_val.is_nil() or rhs_val.is_nil()))
+      {
+        bool same = lhs_val.is_nil() and rhs_val.is_nil();
+        curr_val.set(op == EQUAL ? same : !same);
+      }
+
       //  PLUS operator
-      if (op == PLUS)
+      else if (op == PLUS)
       {
         //  If integer --> curr_val = int + int
         if (lhs_val.is_integer())
@@ -1067,15 +1495,171 @@ void Interpreter::visit(Expr& node)
   }
 }
 
+//  QuickExpr visitor: the operand types were fixed by the type checker,
+//  so operands are read straight into native values
+inline void Interpreter::visit(QuickExpr& node)
+{
+  switch (node.quick_op)
+  {
+    case QuickExpr::INT_ADD: case QuickExpr::INT_SUB: case QuickExpr::INT_MUL:
+    case QuickExpr::INT_DIV: case QuickExpr::INT_MOD:
+    case QuickExpr::INT_LESS: case QuickExpr::INT_LESS_EQUAL:
+    case QuickExpr::INT_GREATER: case QuickExpr::INT_GREATER_EQUAL:
+    case QuickExpr::INT_EQUAL: case QuickExpr::INT_NOT_EQUAL:
+      quick_int(node);
+      break;
+    case QuickExpr::STRING_CONCAT: case QuickExpr::STRING_EQUAL:
+    case QuickExpr::STRING_NOT_EQUAL:
+      quick_string(node);
+      break;
+    case QuickExpr::BOOL_AND: case QuickExpr::BOOL_OR:
+      quick_bool(node);
+      break;
+    default:
+      quick_double(node);
+      break;
+  }
+}
+
+inline void Interpreter::quick_int(QuickExpr& node)
+{
+  int x1;
+  int x2;
+  node.first->accept(*this);
+  bool has_x1 = curr_val.value(x1);
+  node.rest->accept(*this);
+  bool has_x2 = curr_val.value(x2);
+  if (!has_x1 or !has_x2)
+  {
+    quick_nil(node, !has_x1, !has_x2);
+    return;
+  }
+
+  switch (node.quick_op)
+  {
+    case QuickExpr::INT_ADD: curr_val.set(x1+x2); break;
+    case QuickExpr::INT_SUB: curr_val.set(x1-x2); break;
+    case QuickExpr::INT_MUL: curr_val.set(x1*x2); break;
+    case QuickExpr::INT_DIV:
+      if (x2 == 0)
+        zerodiv_error("Runtime Error| Division by Zero error");
+      curr_val.set(x1/x2);
+      break;
+    case QuickExpr::INT_MOD:
+      if (x2 == 0)
+        zerodiv_error("Runtime Error| Division by Zero error");
+      curr_val.set(x1%x2);
+      break;
+    case QuickExpr::INT_LESS: curr_val.set(x1<x2); break;
+    case QuickExpr::INT_LESS_EQUAL: curr_val.set(x1<=x2); break;
+    case QuickExpr::INT_GREATER: curr_val.set(x1>x2); break;
+    case QuickExpr::INT_GREATER_EQUAL: curr_val.set(x1>=x2); break;
+    case QuickExpr::INT_EQUAL: curr_val.set(x1==x2); break;
+    case QuickExpr::INT_NOT_EQUAL: curr_val.set(x1!=x2); break;
+    default: break;
+  }
+}
+
+inline void Interpreter::quick_double(QuickExpr& node)
+{
+  double x1;
+  double x2;
+  node.first->accept(*this);
+  bool has_x1 = curr_val.value(x1);
+  node.rest->accept(*this);
+  bool has_x2 = curr_val.value(x2);
+  if (!has_x1 or !has_x2)
+  {
+    quick_nil(node, !has_x1, !has_x2);
+    return;
+  }
+
+  switch (node.quick_op)
+  {
+    case QuickExpr::DOUBLE_ADD: curr_val.set(x1+x2); break;
+    case QuickExpr::DOUBLE_SUB: curr_val.set(x1-x2); break;
+    case QuickExpr::DOUBLE_MUL: curr_val.set(x1*x2); break;
+    case QuickExpr::DOUBLE_DIV:
+      if (x2 == 0.0)
+        zerodiv_error("Runtime Error| Division by Zero error");
+      curr_val.set(x1/x2);
+      break;
+    case QuickExpr::DOUBLE_LESS: curr_val.set(x1<x2); break;
+    case QuickExpr::DOUBLE_LESS_EQUAL: curr_val.set(x1<=x2); break;
+    case QuickExpr::DOUBLE_GREATER: curr_val.set(x1>x2); break;
+    case QuickExpr::DOUBLE_GREATER_EQUAL: curr_val.set(x1>=x2); break;
+    case QuickExpr::DOUBLE_EQUAL: curr_val.set(x1==x2); break;
+    case QuickExpr::DOUBLE_NOT_EQUAL: curr_val.set(x1!=x2); break;
+    default: break;
+  }
+}
+
+inline void Interpreter::quick_string(QuickExpr& node)
+{
+  std::string x1;
+  std::string x2;
+  node.first->accept(*this);
+  bool has_x1 = curr_val.value(x1);
+  node.rest->accept(*this);
+  bool has_x2 = curr_val.value(x2);
+  if (!has_x1 or !has_x2)
+  {
+    quick_nil(node, !has_x1, !has_x2);
+    return;
+  }
+
+  if (node.quick_op == QuickExpr::STRING_CONCAT)
+    curr_val.set(x1+x2);
+  else if (node.quick_op == QuickExpr::STRING_EQUAL)
+    curr_val.set(x1==x2);
+  else
+    curr_val.set(x1!=x2);
+}
+
+//  A nil operand: equality tests compare as the generic path does (nil
+//  only equals nil), every other operation is an error
+inline void Interpreter::quick_nil(QuickExpr& node, bool lhs_nil, bool rhs_nil)
+{
+  switch (node.quick_op)
+  {
+    case QuickExpr::INT_EQUAL: case QuickExpr::DOUBLE_EQUAL:
+    case QuickExpr::STRING_EQUAL:
+      curr_val.set(lhs_nil and rhs_nil);
+      break;
+    case QuickExpr::INT_NOT_EQUAL: case QuickExpr::DOUBLE_NOT_EQUAL:
+    case QuickExpr::STRING_NOT_EQUAL:
+      curr_val.set(!(lhs_nil and rhs_nil));
+      break;
+    default:
+      error("Runtime Error| Cannot assign nil value into a defined variable ");
+  }
+}
+
+inline void Interpreter::quick_bool(QuickExpr& node)
+{
+  bool x1;
+  bool x2;
+  node.first->accept(*this);
+  bool has_x1 = curr_val.value(x1);
+  node.rest->accept(*this);
+  if (!has_x1 or !curr_val.value(x2))
+    error("Runtime Error| Cannot assign nil value into a defined variable ");
+
+  if (node.quick_op == QuickExpr::BOOL_AND)
+    curr_val.set(x1 && x2);
+  else
+    curr_val.set(x1 || x2);
+}
+
 //  SimpleTerm Visitor
-void Interpreter::visit(SimpleTerm& node)
+inline void Interpreter::visit(SimpleTerm& node)
 {
   //  Get value of rval in curr_val
   node.rvalue->accept(*this);
 }
 
 //  ComplexTerm
-void Interpreter::visit(ComplexTerm& node)
+inline void Interpreter::visit(ComplexTerm& node)
 {
   //  Get value of expr in curr_val
   node.expr->accept(*this);
@@ -1083,7 +1667,7 @@ void Interpreter::visit(ComplexTerm& node)
 
 // rvalues
 //  SimpleRValue visitor implementation
-void Interpreter::visit(SimpleRValue& node)
+inline void Interpreter::visit(SimpleRValue& node)
 {
   switch (node.value.type())
   {
@@ -1116,30 +1700,51 @@ void Interpreter::visit(SimpleRValue& node)
 }
 
 //  NewRValue visitor
-void Interpreter::visit(NewRValue& node)
+inline void Interpreter::visit(NewRValue& node)
 {
+  //  A channel's value is its handle
+  if (node.type_id.lexeme().find("channel<") == 0)
+  {
+    int capacity = Channel::DEFAULT_CAPACITY;
+    if (node.capacity)
+    {
+      node.capacity->accept(*this);
+      if (curr_val.is_nil())
+        error("Runtime Error| Channel capacity cannot be nil", node.type_id);
+      curr_val.value(capacity);
+      if (capacity < 1)
+        error("Runtime Error| Channel capacity must be at least 1", node.type_id);
+    }
+    Channel* channel = Channel::create(capacity, node.spsc);
+    std::lock_guard<std::mutex> guard(shared->channel_lock);
+    curr_val.set((int)shared->channels.size());
+    shared->channels.push_back(channel);
+    return;
+  }
+
   //  set curr_val to value of the new UDT type being declared
-  TypeDecl* udt = types[node.type_id.lexeme()];
-  HeapObject new_udt_decl;
+  auto type_entry = types.find(node.type_id.lexeme());
+  TypeDecl* udt = type_entry->second;
+  if (tracer)
+    tracer->instant("alloc", "heap", type_entry->first.c_str());
 
-  //  iterate through var decls in udt and create new data object for
-  //  each decl in the udt implementation
+  //  initialize each attribute from its declaration
+  HeapObject new_udt_decl;
   for (VarDeclStmt* decl : udt->vdecls)
   {
-    //  Get type of expr and put it in curr_val
     decl->expr->accept(*this);
-    DataObject new_obj = DataObject(curr_val);
-    //  Get next oid and add heap obj to heap
-    heap.set_obj(next_oid, new_udt_decl);
-    next_oid++;
+    new_udt_decl.set_att(decl->id.lexeme(), curr_val);
   }
 
-  //  Set current value to oid of heap object
-  curr_val.set(next_oid);
+  //  Add the object to the heap and set curr_val to its oid
+  size_t oid = shared->next_oid++;
+  std::unique_lock<std::mutex> guard = heap_guard();
+  shared->heap.set_obj(oid, new_udt_decl);
+  curr_val.set(oid);
 }
 
 //  CallExpr visitor
-void Interpreter::visit(CallExpr& node)
+inline void Interpreter::visit(CallExpr& node)
 {
   std::string fun_name = node.function_id.lexeme();
 
@@ -1147,21 +1752,32 @@ void Interpreter::visit(CallExpr& node)
   //  print
   if (fun_name == "print")
   {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::PRINT];
     //  Null function so no value needs to be stored
     node.arg_list.front()->accept(*this);
     std::string s = curr_val.to_string();
     //  Regex replace \n and \t chars
     s = std::regex_replace(s, std::regex("\\\\n"), "\n");
     s = std::regex_replace(s, std::regex("\\\\t"), "\t");
-    std::cout << s << std::endl;
+    std::unique_lock<std::mutex> guard = io_guard();
+    *out_stream << s << std::endl;
   }
 
   //  read
   else if (fun_name == "read")
   {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::READ];
     //  Non-null function, save value into curr_value
     std::string user_input;
-    std::cin >> user_input;
+    auto read_input = [&]() {
+      std::unique_lock<std::mutex> guard = io_guard();
+      *in_stream >> user_input;
+    };
+    //  A task parks instead of holding up a scheduler worker
+    if (Scheduler::current())
+      Scheduler::global().blocking(read_input);
+    else
+      read_input();
     DataObject obj(user_input);
     curr_val = obj;
   }
@@ -1169,6 +1785,7 @@ void Interpreter::visit(CallExpr& node)
   //  stoi
   else if (fun_name == "stoi")
   {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::STOI];
     //  Retrieve string and convert it to an integer
     node.arg_list.front()->accept(*this);
     std::string s;
@@ -1181,6 +1798,7 @@ void Interpreter::visit(CallExpr& node)
   // itos
   else if (fun_name == "itos")
   {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::ITOS];
     //  Retrive integer and convert it to a string
     node.arg_list.front()->accept(*this);
     std::string new_str = curr_val.to_string();
@@ -1191,6 +1809,7 @@ void Interpreter::visit(CallExpr& node)
   //  stod
   else if (fun_name == "stod")
   {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::STOD];
     //  Retrieve string and turn it into double
     node.arg_list.front()->accept(*this);
     std::string s;
@@ -1203,6 +1822,7 @@ void Interpreter::visit(CallExpr& node)
   //  dtos
   else if (fun_name == "dtos")
   {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::DTOS];
     //  Retrieve double and convert it to a string
     node.arg_list.front()->accept(*this);
     std::string new_str = curr_val.to_string();
@@ -1213,6 +1833,7 @@ void Interpreter::visit(CallExpr& node)
   //  get
   else if (fun_name == "get")
   {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::GET];
     std::list<Expr*> expr_list = node.arg_list;
     //  Get value of index and store it
     expr_list.front()->accept(*this);
@@ -1237,17 +1858,64 @@ void Interpreter::visit(CallExpr& node)
   //  length
   else if (fun_name == "length")
   {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::LENGTH];
     node.arg_list.front()->accept(*this);
     std::string curr_str;
     curr_val.value(curr_str);
-    DataObject obj(curr_str.length());
+    DataObject obj((int)curr_str.length());
     curr_val = obj;
   }
 
+  //  await
+  else if (fun_name == "await")
+  {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::AWAIT];
+    node.arg_list.front()->accept(*this);
+    int handle;
+    curr_val.value(handle);
+    await(handle, node.function_id);
+  }
+
+  //  send (the value moves into the channel)
+  else if (fun_name == "send")
+  {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::SEND];
+    Channel* channel = channel_arg(node);
+    node.arg_list.back()->accept(*this);
+    if (!channel->send(curr_val))
+      error("Runtime Error| Send on a closed channel", node.function_id);
+    curr_val.set_nil();
+  }
+
+  //  recv (nil once the channel is closed and empty)
+  else if (fun_name == "recv")
+  {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::RECV];
+    Channel* channel = channel_arg(node);
+    if (!channel->recv(curr_val))
+      curr_val.set_nil();
+  }
+
+  //  try_recv (nil if no value is ready)
+  else if (fun_name == "try_recv")
+  {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::TRY_RECV];
+    Channel* channel = channel_arg(node);
+    if (!channel->try_recv(curr_val))
+      curr_val.set_nil();
+  }
+
+  //  close
+  else if (fun_name == "close")
+  {
+    ++RuntimeStats::local().built_in_calls[RuntimeCounters::CLOSE];
+    channel_arg(node)->close();
+    curr_val.set_nil();
+  }
+
   //  All other function calls
   else
   {
-    FunDecl* fun_node = functions[fun_name];
     std::list<Expr*> expr_list = node.arg_list;
     std::list<DataObject> params;
     //  Iterate through all params, create a new dataobject for each, and then
@@ -1262,74 +1930,150 @@ void Interpreter::visit(CallExpr& node)
       expr_list.pop_front();
     }
 
-    //  Save curr environment
-    int old_env = sym_table.get_environment_id();
-    //  Go to global environment
-    sym_table.set_environment_id(global_env_id);
-    sym_table.push_environment();
-    FunDecl* function = functions[fun_name];
-    for (FunDecl::FunParam param : function->params)
-    {
-      //  Get name of param, then add the id and corresponding dataobj to env
-      sym_table.add_name(param.id.lexeme());
-      sym_table.set_val_info(param.id.lexeme(), params.front());
-      params.pop_front();
-    }
+    //  A spawned call runs as a task and its value is the task handle
+    if (node.spawn)
+      curr_val.set(spawn(fun_name, params));
+    else
+      call_function(fun_name, params);
+  }
+}
 
-    //  Evaluate each statement in the function and check for return code
-    try {
-      for (Stmt* s : fun_node->stmts)
-        s->accept(*this);
-    }
-    catch (MyPLReturnException* r)
-    {
-      //  If the function name is main, store val of curr_val in ret_code
-      if (fun_name == "main")
-        curr_val.value(ret_code);
-    }
+inline void Interpreter::call_function(const std::string& fun_name, std::list<DataObject>& params)
+{
+  auto fun_entry = functions.find(fun_name);
+  FunDecl* fun_node = fun_entry->second;
+
+  //  Profile the call (including native code) until it returns or fails
+  Profiler::Scope profile_scope(profiler, fun_name);
+  SampleProfiler::Frame sample_frame(sampler, &fun_entry->first);
+  Tracer::Span trace_span(tracer, fun_entry->first.c_str(), "call");
+  RuntimeStats::CallScope call_stats(call_depth);
+
+  //  A skimmed body is parsed and checked on the function's first call
+  if (fun_node->skimmed.load(std::memory_order_acquire))
+  {
+    if (!lazy_bodies)
+      throw MyPLException(RUNTIME, "body of '" + fun_name + "' was not parsed");
+    lazy_bodies->complete(*fun_node);
+  }
 
+  //  Hot functions run as native code when the JIT tier is enabled
+  if (jit)
+  {
+    JitEntry* native = jit->on_call(fun_node);
+    if (native and call_native(native, fun_node, params))
+      return;
+  }
+
+  //  Save curr environment
+  int old_env = sym_table.get_environment_id();
+  //  Go to global environment
+  sym_table.set_environment_id(global_env_id);
+  sym_table.push_environment();
+  int fun_env = sym_table.get_environment_id();
+  FunDecl* function = fun_node;
+  for (FunDecl::FunParam param : function->params)
+  {
+    //  Get name of param, then add the id and corresponding dataobj to env
+    sym_table.add_name(param.id.lexeme());
+    sym_table.set_val_info(param.id.lexeme(), params.front());
+    params.pop_front();
+  }
+
+  //  Evaluate each statement in the function and check for return code
+  try {
+    exec_stmts(fun_node->stmts);
+  }
+  catch (MyPLReturnException* r)
+  {
+    delete r;
+    //  Pop any block environments the return jumped out of
+    while (sym_table.get_environment_id() != fun_env)
+      sym_table.pop_environment();
+    //  If the function name is main, store val of curr_val in ret_code
+    if (fun_name == "main")
+      curr_val.value(ret_code);
+  }
+  catch (MyPLException& e)
+  {
+    //  Restore the caller's environment before the error propagates
+    while (sym_table.get_environment_id() != fun_env)
+      sym_table.pop_environment();
     sym_table.pop_environment();
-    //  Return to old environment
     sym_table.set_environment_id(old_env);
+    throw;
   }
+
+  sym_table.pop_environment();
+  //  Return to old environment
+  sym_table.set_environment_id(old_env);
+}
+
+inline int Interpreter::spawn(const std::string& fun_name, const std::list<DataObject>& params)
+{
+  //  The task gets its own interpreter (and so its own frame stack), made
+  //  now since the spawning one may be gone before the task runs
+  Interpreter* task_interp = new Interpreter(this);
+  Shared* state = shared;
+  std::lock_guard<std::mutex> guard(state->spawn_lock);
+  int handle = (int)state->spawned.size();
+  state->spawned.push_back(Spawned());
+  Spawned* spawned = &state->spawned.back();
+  ++state->concurrent;
+  spawned->task = Scheduler::global().spawn([=]() {
+      try
+      {
+        task_interp->sym_table.push_environment();
+        task_interp->global_env_id = task_interp->sym_table.get_environment_id();
+        std::list<DataObject> args = params;
+        task_interp->call_function(fun_name, args);
+        spawned->result = task_interp->curr_val;
+      }
+      catch (...)
+      {
+        //  Errors reach the program when the task is awaited
+        spawned->error = std::current_exception();
+      }
+      delete task_interp;
+      --state->concurrent;
+    });
+  return handle;
+}
+
+inline void Interpreter::await(int handle, const Token& token)
+{
+  Spawned* spawned;
+  {
+    std::lock_guard<std::mutex> guard(shared->spawn_lock);
+    if (handle < 0 || handle >= (int)shared->spawned.size())
+      error("Runtime Error| Invalid task handle", token);
+    spawned = &shared->spawned[handle];
+  }
+  Scheduler::global().await(spawned->task);
+  if (spawned->error)
+    std::rethrow_exception(spawned->error);
+  curr_val = spawned->result;
+}
+
+inline Channel* Interpreter::channel_arg(CallExpr& node)
+{
+  node.arg_list.front()->accept(*this);
+  if (curr_val.is_nil())
+    error("Runtime Error| Channel is nil", node.function_id);
+  int handle;
+  curr_val.value(handle);
+  std::lock_guard<std::mutex> guard(shared->channel_lock);
+  return shared->channels[handle];
 }
 
 //  IDRValue visitor
-void Interpreter::visit(IDRValue& node)
+inline void Interpreter::visit(IDRValue& node)
 {
   //  IDRValue path exists
   if (node.path.size() > 1)
   {
-    std::list<Token> path = node.path;
-    DataObject curr_object;
-    //  Get oid of object in the head of the path
-    if (sym_table.has_val_info(path.front().lexeme()))
-      sym_table.get_val_info(path.front().lexeme(), curr_object);
-
-    //  Remove first token from the list
-    path.pop_front();
-    //  Iterate through all nodes in path
-    while (path.size() > 1)
-    {
-      HeapObject obj;
-      size_t oid;
-      curr_object.value(oid);
-      if (obj.has_att(path.front().lexeme()))
-        obj.get_val(path.front().lexeme(), curr_object);
-      path.pop_front();
-    }
-
-    //  Set curr_val to the value of the path object
-    HeapObject obj;
-    size_t oid;
-    curr_object.value(oid);
-    heap.get_obj(oid, obj);
-    if (obj.has_att(path.front().lexeme()))
-    {
-      DataObject value;
-      obj.get_val(path.front().lexeme(), value);
-      curr_val = value;
-    }
+    std::unique_lock<std::mutex> guard = heap_guard();
+    path_object(node.path)->get_val(node.path.back().lexeme(), curr_val);
   }
 
   //  Single IDRValue object
@@ -1345,7 +2089,7 @@ void Interpreter::visit(IDRValue& node)
 }
 
 //  Negated R Value
-void Interpreter::visit(NegatedRValue& node)
+inline void Interpreter::visit(NegatedRValue& node)
 {
   //  Get value of expr in curr_val
   node.expr->accept(*this);
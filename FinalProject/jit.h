@@ -0,0 +1,850 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: jit.h
+// DATE: Spring 2021
+// DESC: Optional template JIT tier for the MyPL interpreter. Calls are
+//       counted per FunDecl, and once a function is hot it (and every
+//       function it can reach) is translated statement by statement
+//       into x86-64 machine code placed in mmap'd executable memory.
+//       Only functions whose parameters, locals, and return values are
+//       int or bool (and whose bodies use plain arithmetic, comparisons,
+//       conditionals, loops, and calls to other such functions) are
+//       compiled; anything else stays in the interpreter.
+//
+//       Compiled code uses the signature
+//         long fn(const long* args, JitContext* ctx)
+//       and keeps every local in a stack slot. Runtime errors set
+//       ctx->error and return straight to the interpreter, which
+//       raises the matching MyPLException.
+//----------------------------------------------------------------------
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include "ast.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define MYPL_JIT_SUPPORTED 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+
+// shared state between the interpreter and compiled code
+struct JitContext
+{
+  enum ErrorCode {NONE = 0, ZERO_DIVISION = 1, STACK_DEPTH = 2};
+  long error = NONE;            // set by compiled code on a runtime error
+  long depth = 0;               // current native call depth
+};
+
+
+// per-function JIT state
+struct JitEntry
+{
+  FunDecl* decl = nullptr;
+  std::string name;             // function name (for reporting)
+  void* code = nullptr;         // native entry point (once compiled)
+  long calls = 0;               // calls dispatched through the interpreter
+  long native_calls = 0;        // of those, calls that ran native code
+  bool tried = false;           // compilation was attempted
+  size_t code_size = 0;         // bytes of machine code
+  double compile_us = 0;        // time spent generating code
+  std::string reason;           // why the function stayed interpreted
+};
+
+
+class Jit : public Visitor
+{
+public:
+
+  // the interpreter's function table (filled in before any calls)
+  Jit(const std::unordered_map<std::string,FunDecl*>& functions, int threshold);
+  ~Jit();
+
+  // true if this build can generate native code
+  static bool supported();
+
+  // count a call to the function, compiling it once it becomes hot;
+  // returns the entry if native code is available, else nullptr
+  JitEntry* on_call(FunDecl* fun);
+
+  // run compiled code (args holds one value per parameter); returns
+  // false and sets error if a runtime error occurred
+  bool run(JitEntry* entry, const long* args, long& result,
+           JitContext::ErrorCode& error);
+
+  // human readable per-function statistics
+  std::string stats() const;
+
+  // code generation (one visit per AST node type)
+  void visit(Program& node);
+  void visit(FunDecl& node);
+  void visit(TypeDecl& node);
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node);
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  void visit(TryStmt& node);
+  void visit(CatchStmt& node);
+  void visit(ThrowStmt& node);
+  void visit(Expr& node);
+  void visit(QuickExpr& node);
+  void visit(SimpleTerm& node);
+  void visit(ComplexTerm& node);
+  void visit(SimpleRValue& node);
+  void visit(NewRValue& node);
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node);
+
+private:
+
+  // thrown by the code generator for unsupported constructs
+  struct Unsupported
+  {
+    std::string reason;
+  };
+
+  // a forward-referenced code position
+  struct Label
+  {
+    int pos = -1;
+    std::vector<int> fixups;
+  };
+
+  const std::unordered_map<std::string,FunDecl*>& functions;
+  int threshold;
+  JitContext ctx;
+  std::unordered_map<FunDecl*,JitEntry> entries;
+  // executable regions (for cleanup)
+  std::vector<std::pair<void*,size_t>> regions;
+
+  // maximum native call depth before giving up
+  const long max_depth = 20000;
+
+  // code generation state for the function being compiled
+  std::vector<unsigned char> code;
+  std::vector<std::map<std::string,int>> scopes;
+  int slot_count = 0;
+  Label* epilogue = nullptr;
+  Label* error_exit = nullptr;
+
+  JitEntry& entry_for(FunDecl* fun);
+  void compile(FunDecl* fun);
+  void collect_callees(FunDecl* fun, std::vector<FunDecl*>& found);
+  void generate(FunDecl& fun);
+  void unsupported(const std::string& reason);
+  bool is_native_type(const std::string& type) const;
+
+  // variable slots
+  int add_slot(const std::string& name);
+  int find_slot(const std::string& name);
+  int slot_disp(int slot) const;
+  void stmts(const std::list<Stmt*>& body);
+
+  // machine code emission
+  void emit(std::initializer_list<unsigned char> bytes);
+  void emit32(int value);
+  void emit64(long value);
+  void bind(Label& label);
+  void jump(unsigned char opcode, Label& label);      // jmp rel32
+  void jump_if(unsigned char condition, Label& label); // jcc rel32
+  void load_slot(int slot);
+  void store_slot(int slot);
+};
+
+
+//----------------------------------------------------------------------
+// Construction and dispatch
+//----------------------------------------------------------------------
+
+inline Jit::Jit(const std::unordered_map<std::string,FunDecl*>& functions, int threshold)
+  : functions(functions), threshold(threshold)
+{
+}
+
+
+inline Jit::~Jit()
+{
+#ifdef MYPL_JIT_SUPPORTED
+  for (std::pair<void*,size_t> r : regions)
+    munmap(r.first, r.second);
+#endif
+}
+
+
+inline bool Jit::supported()
+{
+#ifdef MYPL_JIT_SUPPORTED
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+inline JitEntry& Jit::entry_for(FunDecl* fun)
+{
+  JitEntry& e = entries[fun];
+  if (!e.decl) {
+    e.decl = fun;
+    e.name = fun->id.lexeme();
+  }
+  return e;
+}
+
+
+inline JitEntry* Jit::on_call(FunDecl* fun)
+{
+  JitEntry& e = entry_for(fun);
+  ++e.calls;
+  if (!e.code and !e.tried and e.calls >= threshold)
+    compile(fun);
+  return e.code ? &e : nullptr;
+}
+
+
+inline bool Jit::run(JitEntry* entry, const long* args, long& result,
+              JitContext::ErrorCode& error)
+{
+  typedef long (*NativeFun)(const long*, JitContext*);
+  ctx.error = JitContext::NONE;
+  ctx.depth = 0;
+  ++entry->native_calls;
+  result = ((NativeFun)entry->code)(args, &ctx);
+  error = (JitContext::ErrorCode)ctx.error;
+  return error == JitContext::NONE;
+}
+
+
+inline std::string Jit::stats() const
+{
+  std::vector<const JitEntry*> sorted;
+  for (const std::pair<FunDecl* const,JitEntry>& p : entries)
+    sorted.push_back(&p.second);
+  std::sort(sorted.begin(), sorted.end(),
+            [](const JitEntry* a, const JitEntry* b) {return a->calls > b->calls;});
+
+  std::string s = "JIT statistics (threshold " + std::to_string(threshold) + ")\n";
+  for (const JitEntry* e : sorted) {
+    s += "  " + e->name + ": " + std::to_string(e->calls) + " calls";
+    if (e->code)
+      s += ", native (" + std::to_string(e->native_calls) + " native entries, " +
+        std::to_string(e->code_size) + " bytes, " +
+        std::to_string((long)e->compile_us) + " us to compile)";
+    else if (e->tried)
+      s += ", interpreted (" + e->reason + ")";
+    else
+      s += ", interpreted (not hot)";
+    s += "\n";
+  }
+  return s;
+}
+
+
+//----------------------------------------------------------------------
+// Compilation driver
+//----------------------------------------------------------------------
+
+inline void Jit::compile(FunDecl* fun)
+{
+  JitEntry& root = entry_for(fun);
+  root.tried = true;
+  if (!supported()) {
+    root.reason = "JIT not supported on this platform";
+    return;
+  }
+
+  // a function is compiled together with everything it can call, so
+  // native code only ever calls other native code
+  std::vector<FunDecl*> group;
+  collect_callees(fun, group);
+
+  std::vector<std::pair<FunDecl*,std::vector<unsigned char>>> generated;
+  for (FunDecl* f : group) {
+    JitEntry& e = entry_for(f);
+    if (e.code)
+      continue;
+    auto start = std::chrono::steady_clock::now();
+    try {
+      generate(*f);
+    } catch (Unsupported u) {
+      e.tried = true;
+      e.reason = u.reason;
+      if (f != fun)
+        root.reason = "calls " + f->id.lexeme() + " (" + u.reason + ")";
+      return;
+    }
+    auto stop = std::chrono::steady_clock::now();
+    e.compile_us = std::chrono::duration<double,std::micro>(stop - start).count();
+    generated.push_back(std::make_pair(f, code));
+  }
+
+#ifdef MYPL_JIT_SUPPORTED
+  // copy into one writable region, then flip it to executable
+  size_t total = 0;
+  for (auto& g : generated)
+    total += g.second.size();
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t size = ((total + page - 1) / page) * page;
+  if (size == 0)
+    return;
+  void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    root.reason = "could not map executable memory";
+    return;
+  }
+  size_t offset = 0;
+  std::vector<std::pair<FunDecl*,size_t>> offsets;
+  for (auto& g : generated) {
+    std::copy(g.second.begin(), g.second.end(), (unsigned char*)mem + offset);
+    offsets.push_back(std::make_pair(g.first, offset));
+    offset += g.second.size();
+  }
+  if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(mem, size);
+    root.reason = "could not protect executable memory";
+    return;
+  }
+  regions.push_back(std::make_pair(mem, size));
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    JitEntry& e = entry_for(offsets[i].first);
+    e.tried = true;
+    e.code = (unsigned char*)mem + offsets[i].second;
+    e.code_size = generated[i].second.size();
+  }
+#endif
+}
+
+
+inline void Jit::collect_callees(FunDecl* fun, std::vector<FunDecl*>& found)
+{
+  // depth-first walk over the call expressions in the function body
+  struct CallFinder : public Visitor
+  {
+    std::list<std::string> names;
+    void body(const std::list<Stmt*>& stmts) {for (Stmt* s : stmts) s->accept(*this);}
+    void visit(Program&) {}
+    void visit(FunDecl& node) {body(node.stmts);}
+    void visit(TypeDecl&) {}
+    void visit(VarDeclStmt& node) {node.expr->accept(*this);}
+    void visit(AssignStmt& node) {node.expr->accept(*this);}
+    void visit(ReturnStmt& node) {node.expr->accept(*this);}
+    void visit(IfStmt& node)
+    {
+      node.if_part->expr->accept(*this);
+      body(node.if_part->stmts);
+      for (BasicIf* b : node.else_ifs) {b->expr->accept(*this); body(b->stmts);}
+      body(node.body_stmts);
+    }
+    void visit(WhileStmt& node) {node.expr->accept(*this); body(node.stmts);}
+    void visit(ForStmt& node)
+    {
+      node.start->accept(*this);
+      node.end->accept(*this);
+      body(node.stmts);
+    }
+    void visit(TryStmt&) {}
+    void visit(CatchStmt&) {}
+    void visit(ThrowStmt&) {}
+    void visit(Expr& node) {node.first->accept(*this); if (node.rest) node.rest->accept(*this);}
+    void visit(QuickExpr& node) {visit((Expr&)node);}
+    void visit(SimpleTerm& node) {node.rvalue->accept(*this);}
+    void visit(ComplexTerm& node) {node.expr->accept(*this);}
+    void visit(SimpleRValue&) {}
+    void visit(NewRValue&) {}
+    void visit(CallExpr& node)
+    {
+      names.push_back(node.function_id.lexeme());
+      for (Expr* e : node.arg_list) e->accept(*this);
+    }
+    void visit(IDRValue&) {}
+    void visit(NegatedRValue& node) {node.expr->accept(*this);}
+  };
+
+  if (std::find(found.begin(), found.end(), fun) != found.end())
+    return;
+  found.push_back(fun);
+  CallFinder finder;
+  fun->accept(finder);
+  for (const std::string& name : finder.names) {
+    auto it = functions.find(name);
+    if (it != functions.end())
+      collect_callees(it->second, found);
+  }
+}
+
+
+inline void Jit::unsupported(const std::string& reason)
+{
+  throw Unsupported {reason};
+}
+
+
+inline bool Jit::is_native_type(const std::string& type) const
+{
+  return type == "int" or type == "bool";
+}
+
+
+//----------------------------------------------------------------------
+// Function code generation
+//----------------------------------------------------------------------
+
+inline void Jit::generate(FunDecl& fun)
+{
+  if (fun.skimmed)
+    unsupported("body not parsed yet (lazy parsing)");
+  if (!is_native_type(fun.return_type.lexeme()))
+    unsupported("returns " + fun.return_type.lexeme());
+  for (FunDecl::FunParam p : fun.params)
+    if (!is_native_type(p.type.lexeme()))
+      unsupported("parameter '" + p.id.lexeme() + "' is " + p.type.lexeme());
+  // falling off the end returns whatever was last computed in the
+  // interpreter, so only functions ending in a return are compiled
+  if (fun.stmts.empty() or !dynamic_cast<ReturnStmt*>(fun.stmts.back()))
+    unsupported("does not end with a return");
+
+  code.clear();
+  scopes.clear();
+  slot_count = 0;
+  Label done;
+  Label errors;
+  epilogue = &done;
+  error_exit = &errors;
+
+  // push rbp; mov rbp, rsp; push rbx; mov rbx, rsi; sub rsp, <frame>
+  emit({0x55, 0x48, 0x89, 0xE5, 0x53, 0x48, 0x89, 0xF3, 0x48, 0x81, 0xEC});
+  int frame_patch = code.size();
+  emit32(0);
+  // inc qword [rbx+8]; cmp qword [rbx+8], max_depth; jg errors
+  emit({0x48, 0xFF, 0x43, 0x08, 0x48, 0x81, 0x7B, 0x08});
+  emit32(max_depth);
+  Label depth_ok;
+  jump_if(0x8E, depth_ok);                      // jle depth_ok
+  // mov qword [rbx], STACK_DEPTH
+  emit({0x48, 0xC7, 0x03});
+  emit32(JitContext::STACK_DEPTH);
+  jump(0xE9, errors);
+  bind(depth_ok);
+
+  // copy the arguments into their slots: mov rax, [rdi+8*i]
+  scopes.push_back(std::map<std::string,int>());
+  int i = 0;
+  for (FunDecl::FunParam p : fun.params) {
+    emit({0x48, 0x8B, 0x87});
+    emit32(8 * i++);
+    store_slot(add_slot(p.id.lexeme()));
+  }
+
+  stmts(fun.stmts);
+
+  // runtime errors and normal returns share the epilogue
+  bind(errors);
+  bind(done);
+  // dec qword [rbx+8]; mov rbx, [rbp-8]; leave; ret
+  emit({0x48, 0xFF, 0x4B, 0x08, 0x48, 0x8B, 0x5D, 0xF8, 0xC9, 0xC3});
+
+  // frame size keeps rsp 16-byte aligned after the rbx push
+  int frame = 8 * slot_count;
+  if ((frame + 8) % 16 != 0)
+    frame += 8;
+  for (int b = 0; b < 4; ++b)
+    code[frame_patch + b] = (frame >> (8 * b)) & 0xFF;
+  epilogue = nullptr;
+  error_exit = nullptr;
+}
+
+
+inline void Jit::stmts(const std::list<Stmt*>& body)
+{
+  scopes.push_back(std::map<std::string,int>());
+  for (Stmt* s : body)
+    s->accept(*this);
+  scopes.pop_back();
+}
+
+
+inline int Jit::add_slot(const std::string& name)
+{
+  scopes.back()[name] = slot_count;
+  return slot_count++;
+}
+
+
+inline int Jit::find_slot(const std::string& name)
+{
+  for (size_t i = scopes.size(); i > 0; --i) {
+    auto it = scopes[i-1].find(name);
+    if (it != scopes[i-1].end())
+      return it->second;
+  }
+  unsupported("uses non-local '" + name + "'");
+  return -1;
+}
+
+
+// slots live below the saved rbp and rbx
+inline int Jit::slot_disp(int slot) const
+{
+  return -16 - 8 * slot;
+}
+
+
+//----------------------------------------------------------------------
+// Machine code emission helpers
+//----------------------------------------------------------------------
+
+inline void Jit::emit(std::initializer_list<unsigned char> bytes)
+{
+  code.insert(code.end(), bytes.begin(), bytes.end());
+}
+
+
+inline void Jit::emit32(int value)
+{
+  for (int b = 0; b < 4; ++b)
+    code.push_back((value >> (8 * b)) & 0xFF);
+}
+
+
+inline void Jit::emit64(long value)
+{
+  for (int b = 0; b < 8; ++b)
+    code.push_back((value >> (8 * b)) & 0xFF);
+}
+
+
+inline void Jit::bind(Label& label)
+{
+  label.pos = code.size();
+  for (int fixup : label.fixups) {
+    int rel = label.pos - (fixup + 4);
+    for (int b = 0; b < 4; ++b)
+      code[fixup + b] = (rel >> (8 * b)) & 0xFF;
+  }
+  label.fixups.clear();
+}
+
+
+inline void Jit::jump(unsigned char opcode, Label& label)
+{
+  code.push_back(opcode);
+  int at = code.size();
+  emit32(label.pos >= 0 ? label.pos - (at + 4) : 0);
+  if (label.pos < 0)
+    label.fixups.push_back(at);
+}
+
+
+inline void Jit::jump_if(unsigned char condition, Label& label)
+{
+  code.push_back(0x0F);
+  jump(condition, label);
+}
+
+
+inline void Jit::load_slot(int slot)
+{
+  // mov rax, [rbp+disp32]
+  emit({0x48, 0x8B, 0x85});
+  emit32(slot_disp(slot));
+}
+
+
+inline void Jit::store_slot(int slot)
+{
+  // mov [rbp+disp32], rax
+  emit({0x48, 0x89, 0x85});
+  emit32(slot_disp(slot));
+}
+
+
+//----------------------------------------------------------------------
+// Declarations and statements (each leaves no values on the stack)
+//----------------------------------------------------------------------
+
+inline void Jit::visit(Program&)
+{
+  unsupported("program");
+}
+
+inline void Jit::visit(FunDecl&)
+{
+  unsupported("nested function");
+}
+
+inline void Jit::visit(TypeDecl&)
+{
+  unsupported("type declaration");
+}
+
+inline void Jit::visit(VarDeclStmt& node)
+{
+  std::string type = node.type ? node.type->lexeme() : node.expr->type;
+  if (!is_native_type(type) or node.expr->type != type)
+    unsupported("variable '" + node.id.lexeme() + "' is not an int or bool");
+  node.expr->accept(*this);
+  store_slot(add_slot(node.id.lexeme()));
+}
+
+inline void Jit::visit(AssignStmt& node)
+{
+  if (node.lvalue_list.size() != 1)
+    unsupported("assigns through a path");
+  int slot = find_slot(node.lvalue_list.front().lexeme());
+  node.expr->accept(*this);
+  store_slot(slot);
+}
+
+inline void Jit::visit(ReturnStmt& node)
+{
+  node.expr->accept(*this);
+  jump(0xE9, *epilogue);
+}
+
+inline void Jit::visit(IfStmt& node)
+{
+  Label end;
+  std::list<BasicIf*> parts = node.else_ifs;
+  parts.push_front(node.if_part);
+  for (BasicIf* part : parts) {
+    Label next;
+    part->expr->accept(*this);
+    emit({0x85, 0xC0});                         // test eax, eax
+    jump_if(0x84, next);                        // jz next
+    stmts(part->stmts);
+    jump(0xE9, end);
+    bind(next);
+  }
+  stmts(node.body_stmts);
+  bind(end);
+}
+
+inline void Jit::visit(WhileStmt& node)
+{
+  Label top;
+  Label end;
+  bind(top);
+  node.expr->accept(*this);
+  emit({0x85, 0xC0});                           // test eax, eax
+  jump_if(0x84, end);                           // jz end
+  stmts(node.stmts);
+  jump(0xE9, top);
+  bind(end);
+}
+
+inline void Jit::visit(ForStmt& node)
+{
+  // same semantics as the interpreter: start and end are evaluated
+  // once and the body may update the loop variable
+  if (node.parallel)
+    unsupported("uses a parallel for loop");
+  scopes.push_back(std::map<std::string,int>());
+  node.start->accept(*this);
+  int var = add_slot(node.var_id.lexeme());
+  store_slot(var);
+  node.end->accept(*this);
+  int end_slot = slot_count++;
+  store_slot(end_slot);
+
+  Label top;
+  Label done;
+  bind(top);
+  load_slot(end_slot);
+  emit({0x89, 0xC1});                           // mov ecx, eax
+  load_slot(var);
+  emit({0x39, 0xC8});                           // cmp eax, ecx
+  jump_if(0x8F, done);                          // jg done
+  stmts(node.stmts);
+  //  Leave before the increment could overflow (end == INT_MAX)
+  load_slot(end_slot);
+  emit({0x89, 0xC1});                           // mov ecx, eax
+  load_slot(var);
+  emit({0x39, 0xC8});                           // cmp eax, ecx
+  jump_if(0x8D, done);                          // jge done
+  emit({0xFF, 0xC0});                           // inc eax
+  store_slot(var);
+  jump(0xE9, top);
+  bind(done);
+  scopes.pop_back();
+}
+
+inline void Jit::visit(TryStmt&)
+{
+  unsupported("uses try");
+}
+
+inline void Jit::visit(CatchStmt&)
+{
+  unsupported("uses catch");
+}
+
+inline void Jit::visit(ThrowStmt&)
+{
+  unsupported("uses throw");
+}
+
+//----------------------------------------------------------------------
+// Expressions (each leaves its value in eax)
+//----------------------------------------------------------------------
+
+inline void Jit::visit(Expr& node)
+{
+  if (!node.type.empty() and !is_native_type(node.type))
+    unsupported("uses a " + node.type + " expression");
+  node.first->accept(*this);
+
+  // a negated expression is only its (boolean) first term
+  if (node.negated) {
+    emit({0x83, 0xF0, 0x01});                   // xor eax, 1
+    return;
+  }
+  if (!node.op)
+    return;
+
+  if (node.first->type != "int" and node.first->type != "bool")
+    unsupported("uses a " + node.first->type + " operand");
+  emit({0x50});                                 // push rax
+  node.rest->accept(*this);
+  emit({0x89, 0xC1, 0x58});                     // mov ecx, eax; pop rax
+
+  switch (node.op->type())
+  {
+    case PLUS: emit({0x01, 0xC8}); break;       // add eax, ecx
+    case MINUS: emit({0x29, 0xC8}); break;      // sub eax, ecx
+    case MULTIPLY: emit({0x0F, 0xAF, 0xC1}); break;
+    case DIVIDE: case MODULO:
+    {
+      Label nonzero;
+      emit({0x85, 0xC9});                       // test ecx, ecx
+      jump_if(0x85, nonzero);                   // jnz nonzero
+      emit({0x48, 0xC7, 0x03});                 // mov qword [rbx], ZERO_DIVISION
+      emit32(JitContext::ZERO_DIVISION);
+      jump(0xE9, *error_exit);
+      bind(nonzero);
+      emit({0x99, 0xF7, 0xF9});                 // cdq; idiv ecx
+      if (node.op->type() == MODULO)
+        emit({0x89, 0xD0});                     // mov eax, edx
+      break;
+    }
+    case AND: emit({0x21, 0xC8}); break;        // and eax, ecx
+    case OR: emit({0x09, 0xC8}); break;         // or eax, ecx
+    case LESS: case LESS_EQUAL: case GREATER: case GREATER_EQUAL:
+    case EQUAL: case NOT_EQUAL:
+    {
+      unsigned char setcc = 0x94;
+      switch (node.op->type()) {
+        case LESS: setcc = 0x9C; break;
+        case LESS_EQUAL: setcc = 0x9E; break;
+        case GREATER: setcc = 0x9F; break;
+        case GREATER_EQUAL: setcc = 0x9D; break;
+        case NOT_EQUAL: setcc = 0x95; break;
+        default: break;
+      }
+      // cmp eax, ecx; setcc al; movzx eax, al
+      emit({0x39, 0xC8, 0x0F, setcc, 0xC0, 0x0F, 0xB6, 0xC0});
+      break;
+    }
+    default:
+      unsupported("uses operator '" + node.op->lexeme() + "'");
+  }
+}
+
+inline void Jit::visit(QuickExpr& node)
+{
+  visit((Expr&)node);
+}
+
+inline void Jit::visit(SimpleTerm& node)
+{
+  node.rvalue->accept(*this);
+}
+
+inline void Jit::visit(ComplexTerm& node)
+{
+  node.expr->accept(*this);
+}
+
+inline void Jit::visit(SimpleRValue& node)
+{
+  if (node.value.type() == INT_VAL) {
+    emit({0xB8});                               // mov eax, imm32
+    emit32(std::stoi(node.value.lexeme()));
+  }
+  else if (node.value.type() == BOOL_VAL) {
+    emit({0xB8});
+    emit32(node.value.lexeme() == "true" ? 1 : 0);
+  }
+  else
+    unsupported("uses a '" + node.value.lexeme() + "' literal");
+}
+
+inline void Jit::visit(NewRValue&)
+{
+  unsupported("creates objects");
+}
+
+inline void Jit::visit(CallExpr& node)
+{
+  if (node.spawn)
+    unsupported("spawns a task");
+  auto it = functions.find(node.function_id.lexeme());
+  if (it == functions.end())
+    unsupported("calls built-in " + node.function_id.lexeme());
+  JitEntry& callee = entry_for(it->second);
+  int argc = node.arg_list.size();
+  if (argc != (int)it->second->params.size())
+    unsupported("calls " + node.function_id.lexeme() + " with wrong arity");
+
+  // reserve an argument array on the stack, then fill it in order
+  int reserve = 8 * argc;
+  if (reserve % 16 != 0)
+    reserve += 8;
+  if (reserve > 0) {
+    emit({0x48, 0x81, 0xEC});                   // sub rsp, imm32
+    emit32(reserve);
+  }
+  int i = 0;
+  for (Expr* e : node.arg_list) {
+    e->accept(*this);
+    emit({0x48, 0x89, 0x84, 0x24});             // mov [rsp+disp32], rax
+    emit32(8 * i++);
+  }
+  // mov rdi, rsp; mov rsi, rbx; mov rax, &callee.code; call [rax]
+  emit({0x48, 0x89, 0xE7, 0x48, 0x89, 0xDE, 0x48, 0xB8});
+  emit64((long)&callee.code);
+  emit({0xFF, 0x10});
+  if (reserve > 0) {
+    emit({0x48, 0x81, 0xC4});                   // add rsp, imm32
+    emit32(reserve);
+  }
+  // cmp qword [rbx], 0; jne errors
+  emit({0x48, 0x83, 0x3B, 0x00});
+  jump_if(0x85, *error_exit);
+}
+
+inline void Jit::visit(IDRValue& node)
+{
+  if (node.path.size() != 1)
+    unsupported("reads through a path");
+  load_slot(find_slot(node.path.front().lexeme()));
+}
+
+inline void Jit::visit(NegatedRValue&)
+{
+  unsupported("uses neg");
+}
+
+#endif
@@ -0,0 +1,68 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: lazy_bodies.h
+// DATE: Spring 2021
+// DESC: Completes function bodies that were skimmed by the parser
+//       (mypl --lazy). A skimmed function has only its signature parsed
+//       and checked; its body is kept as tokens (FunDecl::body_tokens).
+//       On the function's first call the interpreter asks for it here,
+//       and the body is parsed, type checked as it would have been
+//       checked in order (see TypeChecker::check_deferred), and
+//       quickened. A syntax or type error in the body surfaces at that
+//       call and ends the program; functions that are never called are
+//       never parsed past their signature.
+//----------------------------------------------------------------------
+
+#ifndef LAZY_BODIES_H
+#define LAZY_BODIES_H
+
+#include <mutex>
+#include "ast.h"
+#include "parser.h"
+#include "type_checker.h"
+#include "quickener.h"
+
+
+class LazyBodies
+{
+public:
+
+  // check bodies against the checker that checked the program (which
+  // must outlive this), quickening them if quicken is set
+  LazyBodies(TypeChecker& checker, bool quicken) : checker(checker), quicken(quicken) {}
+
+  // parse, check, and quicken the function's body if it is still only
+  // skimmed (throws a MyPLException)
+  void complete(FunDecl& fun);
+
+  // the number of bodies completed so far
+  size_t completed() const {return count;}
+
+private:
+  TypeChecker& checker;
+  bool quicken;
+  // one body at a time; tasks and parallel loops may call a function
+  // for the first time at once
+  std::mutex lock;
+  size_t count = 0;
+};
+
+
+inline void LazyBodies::complete(FunDecl& fun)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  if (!fun.skimmed)
+    return;
+  Parser::parse_body(fun);
+  checker.check_deferred(fun);
+  if (quicken)
+  {
+    Quickener quickener;
+    fun.accept(quickener);
+  }
+  std::vector<Token>().swap(fun.body_tokens);
+  ++count;
+  fun.skimmed.store(false, std::memory_order_release);
+}
+
+#endif
@@ -21,6 +21,10 @@ public:
   // construct a new lexer from the input stream
   Lexer(std::istream& input_stream);
 
+  // construct a lexer for a stream that starts at the beginning of the
+  // given line of a larger source
+  Lexer(std::istream& input_stream, int first_line);
+
   // return the next available token in the input stream (including
   // EOS if at the end of the stream)
   Token next_token();
@@ -43,27 +47,33 @@ private:
 };
 
 
-Lexer::Lexer(std::istream& input_stream)
+inline Lexer::Lexer(std::istream& input_stream)
   : input_stream(input_stream), line(1), column(1)
 {
 }
 
-char Lexer::read()
+// columns as if the previous line's newline had just been read
+inline Lexer::Lexer(std::istream& input_stream, int first_line)
+  : input_stream(input_stream), line(first_line), column(0)
+{
+}
+
+inline char Lexer::read()
 {
   return input_stream.get();
 }
 
-char Lexer::peek()
+inline char Lexer::peek()
 {
   return input_stream.peek();
 }
 
-void Lexer::error(const std::string& msg, int line, int column) const
+inline void Lexer::error(const std::string& msg, int line, int column) const
 {
   throw MyPLException(LEXER, msg, line, column);
 }
 
-Token Lexer::next_token()
+inline Token Lexer::next_token()
 {
   //  Initialize the empty lexeme string
   string lexeme = "";
@@ -297,8 +307,9 @@ Token Lexer::next_token()
     ch = read();
     column++;
 
+    //  the empty string
     if (ch == '"')
-      return Token(STRING_VAL, "\"\"", line, start_col);
+      return Token(STRING_VAL, "", line, start_col);
 
     while (peek() != '"')
     {
@@ -330,13 +341,14 @@ Token Lexer::next_token()
 
     while (isdigit(peek()) || peek() == '.')
     {
+      ch = read();
+      column++;
+
       //  If the char is a dot, flag the lexeme as a double
       if (ch == '.')
         is_double = true;
 
       lexeme += ch;
-      ch = read();
-      column++;
     }
 
     if (isalpha(peek()))
@@ -362,9 +374,7 @@ Token Lexer::next_token()
         is_id = true;
 
       //  Stop reading if the character isn't a legal character
-      if (((!(isalpha(peek())) && !(isdigit(peek()))) && !is_id)
-      || peek() == ':' || peek() == '(' || peek() == ')'
-      || peek() == ',' || peek() == '=')
+      if (!(isalpha(peek())) && !(isdigit(peek())) && peek() != '_')
         break;
 
       ch = read();
@@ -393,6 +403,18 @@ Token Lexer::next_token()
     if (lexeme == "for")
       return Token(FOR, lexeme, line, start_col);
 
+    if (lexeme == "parallel")
+      return Token(PARALLEL, lexeme, line, start_col);
+
+    if (lexeme == "reduce")
+      return Token(REDUCE, lexeme, line, start_col);
+
+    if (lexeme == "spawn")
+      return Token(SPAWN, lexeme, line, start_col);
+
+    if (lexeme == "channel")
+      return Token(CHANNEL, lexeme, line, start_col);
+
     if (lexeme == "to")
       return Token(TO, lexeme, line, start_col);
 
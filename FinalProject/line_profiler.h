@@ -0,0 +1,137 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: line_profiler.h
+// DATE: Spring 2021
+// DESC: Statement-level profiler for MyPL programs (--line-profile).
+//       The interpreter opens a LineProfiler::Scope around every
+//       statement it executes; each source line collects the number of
+//       statements executed on it and their exclusive time (time spent
+//       in statements nested in a block or a called function goes to
+//       those statements' lines). The report is an annotated listing
+//       of the source followed by the hottest lines.
+//----------------------------------------------------------------------
+
+#ifndef LINE_PROFILER_H
+#define LINE_PROFILER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <istream>
+#include <string>
+#include <vector>
+
+
+class LineProfiler
+{
+public:
+
+  // records one statement execution for as long as the scope is alive
+  class Scope
+  {
+  public:
+    Scope(LineProfiler* p, int line) : profiler(p) {profiler->enter(line);}
+    ~Scope() {profiler->exit();}
+  private:
+    LineProfiler* profiler;
+  };
+
+  LineProfiler() {stack.reserve(1024);}
+
+  // annotated listing of the source (hits, time, and share of the
+  // total time per line) followed by the top hot lines
+  std::string report(std::istream& source, int top = 10) const;
+
+private:
+
+  typedef std::chrono::steady_clock Clock;
+
+  struct Line
+  {
+    long hits = 0;
+    double exclusive_us = 0;
+  };
+
+  struct Frame
+  {
+    int line;
+    Clock::time_point start;
+    double child_us;
+  };
+
+  std::vector<Line> lines;      // indexed by line number
+  std::vector<Frame> stack;
+
+  void enter(int line);
+  void exit();
+};
+
+
+inline void LineProfiler::enter(int line)
+{
+  if (line >= (int)lines.size())
+    lines.resize(line + 1);
+  ++lines[line].hits;
+  stack.push_back({line, Clock::now(), 0});
+}
+
+
+inline void LineProfiler::exit()
+{
+  Clock::time_point end = Clock::now();
+  Frame f = stack.back();
+  stack.pop_back();
+  double total_us = std::chrono::duration<double, std::micro>(end - f.start).count();
+  lines[f.line].exclusive_us += total_us - f.child_us;
+  if (!stack.empty())
+    stack.back().child_us += total_us;
+}
+
+
+inline std::string LineProfiler::report(std::istream& source, int top) const
+{
+  double total_us = 0;
+  for (const Line& l : lines)
+    total_us += l.exclusive_us;
+
+  std::string s;
+  char buf[128];
+  snprintf(buf, sizeof(buf), "%6s %12s %12s %7s  %s\n",
+           "line", "hits", "time (ms)", "time %", "source");
+  s += buf;
+  std::string text;
+  int line = 0;
+  while (std::getline(source, text)) {
+    ++line;
+    if (line < (int)lines.size() and lines[line].hits > 0) {
+      const Line& l = lines[line];
+      snprintf(buf, sizeof(buf), "%6d %12ld %12.3f %6.1f%%  ", line, l.hits,
+               l.exclusive_us / 1000,
+               total_us > 0 ? 100 * l.exclusive_us / total_us : 0.0);
+    }
+    else
+      snprintf(buf, sizeof(buf), "%6d %12s %12s %7s  ", line, "", "", "");
+    s += buf + text + "\n";
+  }
+
+  // the hottest lines by exclusive time
+  std::vector<int> hot;
+  for (int i = 0; i < (int)lines.size(); ++i)
+    if (lines[i].hits > 0)
+      hot.push_back(i);
+  std::sort(hot.begin(), hot.end(), [this](int a, int b) {
+      return lines[a].exclusive_us > lines[b].exclusive_us;
+    });
+  if ((int)hot.size() > top)
+    hot.resize(top);
+  s += "\nhot lines\n";
+  for (int i : hot) {
+    snprintf(buf, sizeof(buf), "%6d %12ld %12.3f %6.1f%%\n", i, lines[i].hits,
+             lines[i].exclusive_us / 1000,
+             total_us > 0 ? 100 * lines[i].exclusive_us / total_us : 0.0);
+    s += buf;
+  }
+  return s;
+}
+
+#endif
@@ -7,39 +7,315 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include "token.h"
 #include "mypl_exception.h"
 #include "lexer.h"
+#include "parallel_lexer.h"
 #include "parser.h"
 #include "ast.h"
 #include "type_checker.h"
+#include "quickener.h"
 #include "interpreter.h"
+#include "cpp_generator.h"
+#include "phase_stats.h"
+#include "alloc_hooks.h"
+#include "tracer.h"
+#include "batch_runner.h"
+#include "compile_server.h"
+#include "fork_server.h"
 using namespace std;
 
 int main(int argc, char* argv[])
 {
+  // command-line options (the remaining argument is the input file)
+  bool quicken = true;
+  bool jit = false;
+  bool jit_stats = false;
+  int jit_threshold = 100;
+  string cpp_file = "";
+  string phase_stats = "";
+  bool hw_counters = false;
+  bool profile = false;
+  string profile_file = "profile.folded";
+  bool line_profile = false;
+  int sample_hz = 0;
+  string trace_file = "";
+  bool runtime_stats = false;
+  int threads = 0;
+  bool parallel_lex = false;
+  bool parallel_decls = false;
+  bool lazy = false;
+  bool strict = false;
+  bool batch = false;
+  string out_dir = "";
+  string serve_socket = "";
+  string client_socket = "";
+  string fork_socket = "";
+  string fork_client_socket = "";
+  // the input file (the program), then any further files (--batch
+  // inputs or --fork-server programs)
+  vector<string> files;
+  string file_name = "";
+  // the whole number after an option's '=' (at least 0), or a usage
+  // error that ends the run
+  auto number = [](const string& arg, int& value) {
+    string text = arg.substr(arg.find('=') + 1);
+    char* end;
+    errno = 0;
+    long n = strtol(text.c_str(), &end, 10);
+    if (text.empty() or *end != '\0' or errno == ERANGE or n < 0 or n > INT_MAX) {
+      cerr << "mypl: " << arg << ": expected a whole number" << endl
+           << "usage: mypl [options] [file]" << endl;
+      exit(1);
+    }
+    value = (int)n;
+  };
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--no-quicken")
+      quicken = false;
+    else if (arg == "--jit")
+      jit = true;
+    else if (arg == "--jit-stats")
+      jit = jit_stats = true;
+    else if (arg.find("--jit-threshold=") == 0) {
+      jit = true;
+      number(arg, jit_threshold);
+    }
+    else if (arg == "--phase-stats")
+      phase_stats = "text";
+    else if (arg == "--phase-stats=json")
+      phase_stats = "json";
+    else if (arg == "--hw-counters") {
+      hw_counters = true;
+      if (phase_stats == "")
+        phase_stats = "text";
+    }
+    else if (arg == "--profile")
+      profile = true;
+    else if (arg.find("--profile=") == 0) {
+      profile = true;
+      profile_file = arg.substr(10);
+    }
+    else if (arg == "--line-profile")
+      line_profile = true;
+    else if (arg.find("--sample-profile=") == 0)
+      number(arg, sample_hz);
+    else if (arg == "--stats")
+      runtime_stats = true;
+    else if (arg.find("--threads=") == 0) {
+      number(arg, threads);
+      ThreadPool::set_global_size(threads);
+      Scheduler::set_global_size(threads);
+    }
+    else if (arg.find("--trace=") == 0)
+      trace_file = arg.substr(8);
+    else if (arg == "--emit-cpp" and i + 1 < argc)
+      cpp_file = argv[++i];
+    else if (arg == "--parallel-lex")
+      parallel_lex = true;
+    else if (arg == "--parallel-decls")
+      parallel_decls = true;
+    else if (arg == "--lazy")
+      lazy = true;
+    else if (arg == "--strict")
+      strict = true;
+    else if (arg == "--batch")
+      batch = true;
+    else if (arg.find("--out-dir=") == 0)
+      out_dir = arg.substr(10);
+    else if (arg == "--serve" and i + 1 < argc)
+      serve_socket = argv[++i];
+    else if (arg == "--client" and i + 1 < argc)
+      client_socket = argv[++i];
+    else if (arg == "--fork-server" and i + 1 < argc)
+      fork_socket = argv[++i];
+    else if (arg == "--fork-client" and i + 1 < argc)
+      fork_client_socket = argv[++i];
+    else
+      files.push_back(arg);
+  }
+  if (!files.empty())
+    file_name = files.front();
+  // generated C++ needs every body; --strict checks them all up front
+  if (strict or cpp_file != "")
+    lazy = false;
+
+  // run the program over each input file instead of standard input
+  if (batch) {
+    BatchRunner runner(threads, out_dir);
+    return runner.run(file_name, vector<string>(files.begin() + 1, files.end()), cerr);
+  }
+
+  // run programs for clients, or have the server run this one
+  if (serve_socket != "") {
+    CompileServer server(serve_socket, threads);
+    return server.serve(cerr);
+  }
+  if (client_socket != "")
+    return CompileServer::client(client_socket, file_name, cin, cout, cerr);
+
+  // fork a child per request from a server with the programs compiled
+  if (fork_socket != "") {
+    ForkServer server(fork_socket);
+    for (const string& f : files)
+      server.load(f, cerr);
+    return server.serve(cerr);
+  }
+  if (fork_client_socket != "")
+    return ForkServer::client(fork_client_socket, file_name, cerr);
+
   // use standard input if no input file given
   istream* input_stream = &cin;
-  if (argc == 2)
-    input_stream = new ifstream(argv[1]);
+  if (file_name != "")
+    input_stream = new ifstream(file_name);
+  // the line profile lists the source again, and standard input can
+  // only be read once, so keep a copy of it
+  string stdin_source;
+  if (file_name == "" and line_profile) {
+    stdin_source.assign(istreambuf_iterator<char>(cin), istreambuf_iterator<char>());
+    input_stream = new istringstream(stdin_source);
+  }
 
   // create the lexer
   Lexer lexer(*input_stream);
-  Parser parser(lexer);
   // read each token in the file until EOS or error
   Interpreter interpreter;
+  if (jit)
+    interpreter.enable_jit(jit_threshold);
+  if (profile)
+    interpreter.enable_profiler();
+  if (line_profile)
+    interpreter.enable_line_profiler();
+  if (sample_hz > 0)
+    interpreter.enable_sample_profiler(sample_hz);
+  PhaseStats stats;
+  // opened before any phase starts so the counters cover all of them
+  HwCounters* counters = nullptr;
+  if (hw_counters) {
+    counters = new HwCounters;
+    if (!counters->available())
+      cerr << "hardware counters are not available" << endl;
+    stats.set_hw_counters(counters);
+  }
+  Tracer* tracer = nullptr;
+  if (trace_file != "") {
+    tracer = new Tracer;
+    stats.set_tracer(tracer);
+    interpreter.set_tracer(tracer);
+  }
+  // reports requested on the command line (written even on errors)
+  auto reports = [&]() {
+    if (jit_stats)
+      cerr << interpreter.jit_stats();
+    if (phase_stats != "")
+      cerr << (phase_stats == "json" ? stats.json() : stats.report());
+    if (profile) {
+      cerr << interpreter.profile()->report();
+      ofstream folded(profile_file);
+      interpreter.profile()->write_collapsed(folded);
+    }
+    if (line_profile) {
+      // the listing re-reads the source (or the copy of standard input)
+      if (file_name == "") {
+        istringstream source(stdin_source);
+        cerr << interpreter.line_profile()->report(source);
+      }
+      else {
+        ifstream source(file_name);
+        cerr << interpreter.line_profile()->report(source);
+      }
+    }
+    if (sample_hz > 0) {
+      interpreter.sample_profile()->stop();
+      cerr << interpreter.sample_profile()->report();
+      ofstream folded("sample.folded");
+      interpreter.sample_profile()->write_collapsed(folded);
+    }
+    if (tracer) {
+      ofstream trace(trace_file);
+      tracer->write(trace);
+    }
+    if (runtime_stats)
+      cerr << RuntimeStats::report();
+  };
   try {
     Program ast_root_node;
-    parser.parse(ast_root_node);
+    if (phase_stats == "" and !tracer and !parallel_lex and !parallel_decls and !lazy) {
+      Parser parser(lexer);
+      parser.parse(ast_root_node);
+    }
+    else {
+      // lex the whole file first so lexing and parsing are timed apart
+      stats.begin("lex");
+      vector<Token> tokens;
+      if (parallel_lex) {
+        // buffer the source and lex chunks of it on the thread pool
+        string source((istreambuf_iterator<char>(*input_stream)), istreambuf_iterator<char>());
+        tokens = ParallelLexer(ThreadPool::global()).tokenize(source);
+      }
+      else {
+        do
+          tokens.push_back(lexer.next_token());
+        while (tokens.back().type() != EOS);
+      }
+      stats.begin("parse");
+      Parser parser(std::move(tokens));
+      if (lazy)
+        parser.enable_lazy_bodies();
+      if (parallel_decls)
+        parser.parse(ast_root_node, ThreadPool::global());
+      else
+        parser.parse(ast_root_node);
+    }
+    stats.begin("typecheck");
     TypeChecker type_checker;
+    if (parallel_decls)
+      type_checker.enable_parallel(ThreadPool::global());
     ast_root_node.accept(type_checker);
-    ast_root_node.accept(interpreter);
+    stats.end();
+    // skimmed bodies are completed as they are first called
+    LazyBodies lazy_bodies(type_checker, quicken);
+    if (lazy)
+      interpreter.enable_lazy_bodies(&lazy_bodies);
+    // translate to C++ instead of running the program
+    if (cpp_file != "") {
+      ofstream cpp_stream(cpp_file);
+      CppGenerator generator(cpp_stream);
+      ast_root_node.accept(generator);
+      return 0;
+    }
+    // specialize typed expressions before running
+    if (quicken) {
+      stats.begin("optimize");
+      Quickener quickener;
+      ast_root_node.accept(quickener);
+    }
+    stats.begin("execute");
+    try {
+      ast_root_node.accept(interpreter);
+    } catch (...) {
+      // tasks still running use the program, which goes with this scope
+      interpreter.wait_for_tasks();
+      throw;
+    }
+    interpreter.wait_for_tasks();
+    stats.end();
   } catch (MyPLException e) {
+    stats.end();
     cout << e.to_string() << endl;
+    reports();
     exit(1);
   }
+  reports();
   // clean up the input stream
   if (input_stream != &cin)
     delete input_stream;
+  delete tracer;
+  delete counters;
   return interpreter.return_code();
 }
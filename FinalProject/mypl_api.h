@@ -0,0 +1,116 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: mypl_api.h
+// DATE: Spring 2021
+// DESC: API for embedding MyPL in a C++ program. compile() lexes,
+//       parses, type checks, and quickens a program once; the result is
+//       never changed afterwards. An ExecutionContext runs a compiled
+//       program with its own interpreter (heap, environments, tasks, and
+//       channels) and its own input and output streams, so any number
+//       of contexts may run at once on different threads, including
+//       over the same CompiledProgram. The API (and every header it
+//       includes) may be included from any number of translation units.
+//
+//       CompiledProgram* rules = CompiledProgram::compile(source);
+//       std::istringstream in("...");
+//       std::ostringstream out;
+//       ExecutionContext context(*rules, in, out);
+//       int code = context.run();
+//----------------------------------------------------------------------
+
+#ifndef MYPL_API_H
+#define MYPL_API_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "lexer.h"
+#include "parser.h"
+#include "type_checker.h"
+#include "quickener.h"
+#include "interpreter.h"
+#include "mypl_exception.h"
+
+
+class CompiledProgram
+{
+public:
+
+  // compile the program (the caller owns the result); throws a
+  // MyPLException for lexer, syntax, and type errors
+  static CompiledProgram* compile(const std::string& source, bool quicken = true);
+  static CompiledProgram* compile(std::istream& source, bool quicken = true);
+
+private:
+
+  friend class ExecutionContext;
+
+  CompiledProgram() {}
+  CompiledProgram(const CompiledProgram&) = delete;
+  CompiledProgram& operator=(const CompiledProgram&) = delete;
+
+  // the checked (and quickened) AST; visitors take nodes by non-const
+  // reference, but running a program only reads them
+  mutable Program ast;
+};
+
+
+class ExecutionContext
+{
+public:
+
+  // a context running program with the given streams for read and print
+  // (the program and streams must outlive the context)
+  ExecutionContext(const CompiledProgram& program, std::istream& in, std::ostream& out)
+    : program(program), in(in), out(out) {}
+
+  // run the program's main function and return its result; each run
+  // starts from an empty heap. Throws a MyPLException for runtime
+  // errors and for values the program throws and does not catch.
+  int run();
+
+private:
+  const CompiledProgram& program;
+  std::istream& in;
+  std::ostream& out;
+};
+
+
+inline CompiledProgram* CompiledProgram::compile(const std::string& source, bool quicken)
+{
+  std::istringstream stream(source);
+  return compile(stream, quicken);
+}
+
+
+inline CompiledProgram* CompiledProgram::compile(std::istream& source, bool quicken)
+{
+  CompiledProgram* program = new CompiledProgram;
+  try {
+    Lexer lexer(source);
+    Parser parser(lexer);
+    parser.parse(program->ast);
+    TypeChecker type_checker;
+    program->ast.accept(type_checker);
+    if (quicken) {
+      Quickener quickener;
+      program->ast.accept(quickener);
+    }
+  }
+  catch (...) {
+    delete program;
+    throw;
+  }
+  return program;
+}
+
+
+inline int ExecutionContext::run()
+{
+  Interpreter interpreter;
+  interpreter.set_streams(in, out);
+  program.ast.accept(interpreter);
+  return interpreter.return_code();
+}
+
+#endif
@@ -11,6 +11,8 @@
 #ifndef MYPL_EXCEPTION
 #define MYPL_EXCEPTION
 
+#include "runtime_stats.h"
+
 
 // the compilation stage where the error occurred
 enum ExceptionType {LEXER, SYNTAX, SEMANTIC, RUNTIME, ZERODIVISION, INDEXOUTOFBOUNDS};
@@ -43,19 +45,21 @@ class MyPLException : public std::exception
 };
 
 
-MyPLException::MyPLException(ExceptionType t, const std::string& m, int l, int c)
+inline MyPLException::MyPLException(ExceptionType t, const std::string& m, int l, int c)
   : type(t), message(m), line(l), column(c), has_line_column(true)
 {
+  ++RuntimeStats::local().exceptions;
 }
 
 
-MyPLException::MyPLException(ExceptionType t, const std::string& m)
+inline MyPLException::MyPLException(ExceptionType t, const std::string& m)
   : type(t), message(m), has_line_column(false)
 {
+  ++RuntimeStats::local().exceptions;
 }
 
 
-std::string MyPLException::to_string() const
+inline std::string MyPLException::to_string() const
 {
   std::string s = "Lexer";
   switch(type) {
@@ -72,7 +76,7 @@ std::string MyPLException::to_string() const
   return s;
 }
 
-ExceptionType MyPLException::get_type() const
+inline ExceptionType MyPLException::get_type() const
 {
   return type;
 }
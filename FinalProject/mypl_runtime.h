@@ -0,0 +1,203 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: mypl_runtime.h
+// DATE: Spring 2021
+// DESC: Small runtime support library for C++ code generated from MyPL
+//       programs (see cpp_generator.h). Provides the MyPL built-in
+//       functions and the exceptions used for try/catch/throw, with
+//       the same behavior and error messages as the interpreter.
+//----------------------------------------------------------------------
+
+#ifndef MYPL_RUNTIME_H
+#define MYPL_RUNTIME_H
+
+#include <iostream>
+#include <string>
+#include <exception>
+
+namespace mypl {
+
+
+// base class for every error a MyPL catch block can handle
+class Error : public std::exception
+{
+public:
+  Error(const std::string& msg) : message(msg) {}
+  const char* what() const noexcept {return message.c_str();}
+private:
+  std::string message;
+};
+
+
+class ZeroDivisionError : public Error
+{
+public:
+  ZeroDivisionError()
+    : Error("Zero Division Error: Runtime Error| Division by Zero error") {}
+};
+
+
+class IndexOutOfBoundsError : public Error
+{
+public:
+  IndexOutOfBoundsError()
+    : Error("Index out of Bounds Error: Runtime Error| Index out of Bounds") {}
+};
+
+
+// a value raised by a MyPL throw statement (int, double, or bool)
+class Thrown : public Error
+{
+public:
+  enum Type {INT, DOUBLE, BOOL};
+  Thrown(int v) : Error(msg(std::to_string(v))), type(INT), int_val(v) {}
+  Thrown(double v) : Error(msg(std::to_string(v))), type(DOUBLE), double_val(v) {}
+  Thrown(bool v) : Error(msg(v ? "true" : "false")), type(BOOL), bool_val(v) {}
+  // true if the thrown value equals the catch value
+  bool matches(int v) const {return type == INT and int_val == v;}
+  bool matches(double v) const {return type == DOUBLE and double_val == v;}
+  bool matches(bool v) const {return type == BOOL and bool_val == v;}
+private:
+  static std::string msg(const std::string& v)
+  {
+    return "Runtime Error: uncaught exception '" + v + "'";
+  }
+  Type type;
+  int int_val = 0;
+  double double_val = 0;
+  bool bool_val = false;
+};
+
+
+//----------------------------------------------------------------------
+// Operators that can fail at runtime
+//----------------------------------------------------------------------
+
+inline int div(int x, int y)
+{
+  if (y == 0)
+    throw ZeroDivisionError();
+  return x / y;
+}
+
+inline double div(double x, double y)
+{
+  if (y == 0.0)
+    throw ZeroDivisionError();
+  return x / y;
+}
+
+inline int mod(int x, int y)
+{
+  if (y == 0)
+    throw ZeroDivisionError();
+  return x % y;
+}
+
+inline std::string concat(const std::string& x, const std::string& y) {return x + y;}
+inline std::string concat(const std::string& x, char y) {return x + y;}
+inline std::string concat(char x, const std::string& y) {return x + y;}
+inline std::string concat(char x, char y) {return std::string(1, x) + y;}
+
+
+// the object an attribute path refers to (an error if it is nil)
+template <typename T>
+inline T* deref(T* obj, const char* msg)
+{
+  if (!obj)
+    throw Error(msg);
+  return obj;
+}
+
+
+//----------------------------------------------------------------------
+// Built-in functions
+//----------------------------------------------------------------------
+
+inline void print(std::string s)
+{
+  // escape sequences are kept as written until printed
+  std::string out;
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '\\' and i + 1 < s.size() and (s[i+1] == 'n' or s[i+1] == 't')) {
+      out += s[i+1] == 'n' ? '\n' : '\t';
+      ++i;
+    }
+    else
+      out += s[i];
+  }
+  std::cout << out << std::endl;
+}
+
+inline std::string read()
+{
+  std::string s;
+  std::cin >> s;
+  return s;
+}
+
+inline int stoi(const std::string& s) {return std::stoi(s);}
+inline std::string itos(int x) {return std::to_string(x);}
+inline double stod(const std::string& s) {return std::stod(s);}
+inline std::string dtos(double x) {return std::to_string(x);}
+inline int length(const std::string& s) {return (int)s.length();}
+
+inline char get(int idx, const std::string& s)
+{
+  if (idx < 0 or idx > (int)s.length() - 1)
+    throw IndexOutOfBoundsError();
+  return s[idx];
+}
+
+// a spawned call, which generated code runs to completion as soon as it
+// is spawned; its error (if any) is raised by await, as in the
+// interpreter
+template <typename T>
+struct task
+{
+  T value;
+  std::exception_ptr error;
+};
+
+template <>
+struct task<void>
+{
+  std::exception_ptr error;
+};
+
+template <typename T, typename F>
+inline void run(task<T>& t, F& call) {t.value = call();}
+
+template <typename F>
+inline void run(task<void>& t, F& call) {call();}
+
+template <typename F>
+inline auto spawn(F call) -> task<decltype(call())>
+{
+  task<decltype(call())> t;
+  try {
+    run(t, call);
+  }
+  catch (...) {
+    t.error = std::current_exception();
+  }
+  return t;
+}
+
+template <typename T>
+inline T await(const task<T>& t)
+{
+  if (t.error)
+    std::rethrow_exception(t.error);
+  return t.value;
+}
+
+inline void await(const task<void>& t)
+{
+  if (t.error)
+    std::rethrow_exception(t.error);
+}
+
+}
+
+#endif
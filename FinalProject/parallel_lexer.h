@@ -0,0 +1,147 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: parallel_lexer.h
+// DATE: Spring 2021
+// DESC: Lexes a large source on a thread pool (mypl --parallel-lex).
+//       A quick pre-scan over the buffered source tracks string
+//       literals and # comments and picks chunk boundaries just after
+//       newlines that are in neither, near evenly spaced offsets. Each
+//       chunk then starts at the beginning of a line, so a Lexer
+//       started on that line (see Lexer(istream&, int)) produces
+//       exactly the tokens, lines, and columns the sequential Lexer
+//       would. The chunks' tokens are stitched together in order with
+//       a single EOS at the end; if any chunk fails, the error of the
+//       first failing chunk is thrown, which is the one the sequential
+//       Lexer would have reported.
+//----------------------------------------------------------------------
+
+#ifndef PARALLEL_LEXER_H
+#define PARALLEL_LEXER_H
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "thread_pool.h"
+
+
+class ParallelLexer
+{
+public:
+
+  // lex on the given pool, in chunks of at least min_chunk bytes
+  explicit ParallelLexer(ThreadPool& pool, size_t min_chunk = 64 * 1024)
+    : pool(pool), min_chunk(std::max<size_t>(1, min_chunk)) {}
+
+  // the tokens of the source, ending with EOS (throws a MyPLException)
+  std::vector<Token> tokenize(const std::string& source);
+
+  // the number of chunks the last source was split into
+  size_t chunk_count() const {return chunks.size();}
+
+private:
+
+  struct Chunk
+  {
+    size_t start;
+    size_t end;
+    int line;                                 // the line it starts on
+    std::vector<Token> tokens;
+    std::unique_ptr<MyPLException> error;
+  };
+
+  ThreadPool& pool;
+  size_t min_chunk;
+  std::vector<Chunk> chunks;
+
+  // split the source into chunks that start at the beginning of a line
+  void split(const std::string& source);
+
+  void lex(const std::string& source, Chunk& chunk);
+};
+
+
+void ParallelLexer::split(const std::string& source)
+{
+  chunks.clear();
+  size_t wanted = std::min<size_t>(4 * pool.size(), source.size() / min_chunk);
+  wanted = std::max<size_t>(wanted, 1);
+  size_t step = source.size() / wanted;
+  chunks.push_back(Chunk{0, source.size(), 1, {}, nullptr});
+
+  // the line count follows the Lexer's: newlines inside a string
+  // literal don't start a new line
+  int line = 1;
+  bool in_string = false;
+  bool in_comment = false;
+  size_t next = step;
+  for (size_t i = 0; i < source.size() and chunks.size() < wanted; ++i) {
+    char ch = source[i];
+    if (in_string) {
+      if (ch == '"')
+        in_string = false;
+    }
+    else if (ch == '\n') {
+      ++line;
+      in_comment = false;
+      if (i + 1 >= next and i + 1 < source.size()) {
+        chunks.back().end = i + 1;
+        chunks.push_back(Chunk{i + 1, source.size(), line, {}, nullptr});
+        next = i + 1 + step;
+      }
+    }
+    else if (in_comment)
+      continue;
+    else if (ch == '"')
+      in_string = true;
+    else if (ch == '#')
+      in_comment = true;
+  }
+}
+
+
+void ParallelLexer::lex(const std::string& source, Chunk& chunk)
+{
+  std::istringstream in(source.substr(chunk.start, chunk.end - chunk.start));
+  std::unique_ptr<Lexer> lexer(chunk.start == 0 ? new Lexer(in) : new Lexer(in, chunk.line));
+  try {
+    do
+      chunk.tokens.push_back(lexer->next_token());
+    while (chunk.tokens.back().type() != EOS);
+  }
+  catch (MyPLException& e) {
+    chunk.error.reset(new MyPLException(e));
+  }
+}
+
+
+std::vector<Token> ParallelLexer::tokenize(const std::string& source)
+{
+  split(source);
+  pool.parallel_for(0, (long)chunks.size() - 1, 1, [&](int /*worker*/, long lo, long hi) {
+      for (long i = lo; i <= hi; ++i)
+        lex(source, chunks[i]);
+    });
+
+  size_t count = 0;
+  for (Chunk& chunk : chunks) {
+    if (chunk.error)
+      throw *chunk.error;
+    count += chunk.tokens.size();
+  }
+  // every chunk but the last ends with an EOS to drop
+  std::vector<Token> tokens;
+  tokens.reserve(count);
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    std::vector<Token>& part = chunks[i].tokens;
+    if (i + 1 < chunks.size())
+      part.pop_back();
+    for (Token& t : part)
+      tokens.push_back(std::move(t));
+    std::vector<Token>().swap(part);
+  }
+  return tokens;
+}
+
+#endif
@@ -8,10 +8,12 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <vector>
 #include "token.h"
 #include "lexer.h"
 #include "ast.h"
 #include "mypl_exception.h"
+#include "thread_pool.h"
 
 
 class Parser
@@ -21,12 +23,39 @@ public:
   // create a new recursive descent parser
   Parser(const Lexer& program_lexer);
 
+  // create a parser over an already lexed token list (ending in EOS)
+  Parser(std::vector<Token> program_tokens);
+
+  ~Parser();
+
   // run the parser
   void parse(Program& root_node);
 
+  // skim function bodies instead of parsing them: fdecl keeps the body's
+  // tokens for parse_body, as long as its blocks balance (only with
+  // pre-lexed tokens)
+  void enable_lazy_bodies() {lazy = true;}
+
+  // parse the body of a function whose body was skimmed
+  static void parse_body(FunDecl& node);
+
+  // run the parser over pre-lexed tokens with each top-level
+  // declaration (from a FUN or TYPE token to the next one) parsed on
+  // the pool; if any of them fails, parses in order to report the error
+  // as parse would
+  void parse(Program& root_node, ThreadPool& pool);
+
 private:
-  Lexer lexer;
+  Lexer* lexer = nullptr;       // token source (if not pre-lexed)
+  std::vector<Token> tokens;    // pre-lexed tokens (if no lexer)
+  size_t next_token = 0;
   Token curr_token;
+  bool lazy = false;
+
+  // with lazy parsing, keep the tokens of the function body that starts
+  // at curr_token; false (with nothing consumed) if its blocks don't
+  // balance before the next declaration, so it gets parsed instead
+  bool skim_body(FunDecl& node);
 
   // helper functions-
   void advance();
@@ -34,6 +63,7 @@ private:
   void error(std::string err_msg);
   bool is_operator(TokenType t);
   void dtype();
+  Token type_token();
   void pval(SimpleRValue& node);
 
   /// --- AST tree building functions --- ///
@@ -54,6 +84,7 @@ private:
   void try_stmt(TryStmt& node);
   void catch_stmt(CatchStmt& node);
   void throw_stmt(ThrowStmt& node);
+  void spawn_expr(CallExpr& node);
 
   //  Expressions
   void expr(Expr& node);
@@ -62,17 +93,29 @@ private:
 
 
 // constructor
-Parser::Parser(const Lexer& program_lexer) : lexer(program_lexer)
+inline Parser::Parser(const Lexer& program_lexer) : lexer(new Lexer(program_lexer))
+{
+}
+
+inline Parser::Parser(std::vector<Token> program_tokens) : tokens(std::move(program_tokens))
+{
+}
+
+inline Parser::~Parser()
 {
+  delete lexer;
 }
 
 // Helper functions
-void Parser::advance()
+inline void Parser::advance()
 {
-  curr_token = lexer.next_token();
+  if (lexer)
+    curr_token = lexer->next_token();
+  else if (next_token < tokens.size())
+    curr_token = tokens[next_token++];
 }
 
-void Parser::eat(TokenType t, std::string err_msg)
+inline void Parser::eat(TokenType t, std::string err_msg)
 {
   if (curr_token.type() == t)
     advance();
@@ -80,7 +123,7 @@ void Parser::eat(TokenType t, std::string err_msg)
     error(err_msg);
 }
 
-void Parser::error(std::string err_msg)
+inline void Parser::error(std::string err_msg)
 {
   std::string s = err_msg + "found '" + curr_token.lexeme() + "'";
   int line = curr_token.line();
@@ -88,14 +131,14 @@ void Parser::error(std::string err_msg)
   throw MyPLException(SYNTAX, s, line, col);
 }
 
-bool Parser::is_operator(TokenType t)
+inline bool Parser::is_operator(TokenType t)
 {
   return t == PLUS or t == MINUS or t == DIVIDE or t == MULTIPLY or
     t == MODULO or t == AND or t == OR or t == EQUAL or t == LESS or
     t == GREATER or t == LESS_EQUAL or t == GREATER_EQUAL or t == NOT_EQUAL;
 }
 
-void Parser::dtype()
+inline void Parser::dtype()
 {
   if (curr_token.type() == INT_TYPE)
     eat(INT_TYPE, "Expected INT_TYPE ");
@@ -119,8 +162,25 @@ void Parser::dtype()
     error("Expected type declaration ");
 }
 
+// the type in a declaration: a primitive type, a type ID, or a channel
+// type (channel<T>, returned as a single token)
+inline Token Parser::type_token()
+{
+  Token t = curr_token;
+  if (curr_token.type() != CHANNEL)
+  {
+    advance();
+    return t;
+  }
+  eat(CHANNEL, "Expected CHANNEL ");
+  eat(LESS, "Expected LESS ");
+  Token elem = type_token();
+  eat(GREATER, "Expected GREATER ");
+  return Token(ID, "channel<" + elem.lexeme() + ">", t.line(), t.column());
+}
+
 // Recursive-decent functions"
-void Parser::parse(Program& root_node)
+inline void Parser::parse(Program& root_node)
 {
   advance();
   while (curr_token.type() != EOS)
@@ -146,10 +206,64 @@ void Parser::parse(Program& root_node)
   eat(EOS, "Expecting end-of-file ");
 }
 
+inline void Parser::parse(Program& root_node, ThreadPool& pool)
+{
+  //  FUN and TYPE only start declarations
+  std::vector<size_t> starts;
+  for (size_t i = 0; i < tokens.size(); ++i)
+    if (tokens[i].type() == FUN or tokens[i].type() == TYPE)
+      starts.push_back(i);
+  if (lexer or tokens.empty() or (!starts.empty() and starts[0] != 0)
+      or (starts.empty() and tokens[0].type() != EOS))
+  {
+    parse(root_node);
+    return;
+  }
+  starts.push_back(tokens.size() - 1);
+
+  std::vector<Decl*> decls(starts.size() - 1, nullptr);
+  pool.parallel_for(0, (long)decls.size() - 1, 0, [&](int /*worker*/, long lo, long hi) {
+      for (long i = lo; i <= hi; ++i)
+      {
+        std::vector<Token> decl_tokens(tokens.begin() + starts[i], tokens.begin() + starts[i+1]);
+        decl_tokens.push_back(tokens.back());
+        Program decl_root;
+        try
+        {
+          Parser decl_parser(std::move(decl_tokens));
+          decl_parser.lazy = lazy;
+          decl_parser.parse(decl_root);
+        }
+        catch (MyPLException&)
+        {
+          continue;
+        }
+        if (decl_root.decls.size() == 1)
+        {
+          decls[i] = decl_root.decls.front();
+          decl_root.decls.clear();
+        }
+      }
+    });
+
+  bool parsed = true;
+  for (Decl* d : decls)
+    if (!d)
+      parsed = false;
+  if (!parsed)
+  {
+    for (Decl* d : decls)
+      delete d;
+    parse(root_node);
+    return;
+  }
+  root_node.decls.insert(root_node.decls.end(), decls.begin(), decls.end());
+}
+
 //  ----------------------------
 //        Declarations
 //  ----------------------------
-void Parser::tdecl(TypeDecl& node)
+inline void Parser::tdecl(TypeDecl& node)
 {
   //  Type Declaration case
   eat(TYPE, "Expected TYPE");
@@ -167,11 +281,10 @@ void Parser::tdecl(TypeDecl& node)
   eat(END, "Expected END");
 }
 
-void Parser::fdecl(FunDecl& node)
+inline void Parser::fdecl(FunDecl& node)
 {
   eat(FUN, "Expected FUN");
-  node.return_type = curr_token;
-  advance();
+  node.return_type = type_token();
   node.id = curr_token;
   eat(ID, "Expected ID ");
   eat(LPAREN, "Expected LPAREN");
@@ -183,8 +296,7 @@ void Parser::fdecl(FunDecl& node)
     f.id = curr_token;
     advance();
     eat(COLON, "Expected COLON ");
-    f.type = curr_token;
-    advance();
+    f.type = type_token();
     node.params.push_back(f);
 
     //  If there is more than one param, eat the comma and repeat process
@@ -195,6 +307,9 @@ void Parser::fdecl(FunDecl& node)
   //  Eat closing paren for the param list
   eat(RPAREN, "Expected RPAREN");
 
+  if (lazy and skim_body(node))
+    return;
+
   //  Add all statements in function body to its stmt_list
   while (curr_token.type() != END)
     stmt(node.stmts);
@@ -202,11 +317,54 @@ void Parser::fdecl(FunDecl& node)
   eat(END, "Expected END");
 }
 
+inline bool Parser::skim_body(FunDecl& node)
+{
+  if (lexer)
+    return false;
+  //  curr_token is tokens[next_token - 1]; find the END that closes the
+  //  function, counting the blocks that END closes in between
+  int depth = 0;
+  size_t end = next_token - 1;
+  for (; end < tokens.size(); ++end)
+  {
+    TokenType t = tokens[end].type();
+    if (t == IF or t == WHILE or t == FOR or t == TRY)
+      ++depth;
+    else if (t == END and depth-- == 0)
+      break;
+    else if (t == FUN or t == TYPE or t == EOS)
+      return false;
+  }
+  if (end == tokens.size())
+    return false;
+  node.body_tokens.assign(tokens.begin() + (next_token - 1), tokens.begin() + end + 1);
+  node.skimmed = true;
+  next_token = end + 1;
+  advance();
+  return true;
+}
+
+inline void Parser::parse_body(FunDecl& node)
+{
+  std::vector<Token> body_tokens = node.body_tokens;
+  body_tokens.push_back(Token(EOS, "", body_tokens.back().line(), body_tokens.back().column()));
+  Parser parser(std::move(body_tokens));
+  parser.advance();
+  std::list<Stmt*> stmts;
+  while (parser.curr_token.type() != END)
+    parser.stmt(stmts);
+  parser.eat(END, "Expected END");
+  node.stmts = stmts;
+}
+
 // -----------------------------
 //        Statements
 // -----------------------------
-void Parser::stmt(std::list<Stmt*>& stmts)
+inline void Parser::stmt(std::list<Stmt*>& stmts)
 {
+  //  Remember where the statement starts for error and profile reports
+  Token first = curr_token;
+
   //  Examine curr token to determine which of the 7 (+ 3!) statements should be called
   switch(curr_token.type())
   {
@@ -220,6 +378,7 @@ void Parser::stmt(std::list<Stmt*>& stmts)
     }
 
     case FOR:
+    case PARALLEL:
     {
       //  ForStmt case
       ForStmt* f = new ForStmt();
@@ -275,6 +434,15 @@ void Parser::stmt(std::list<Stmt*>& stmts)
       break;
     }
 
+    case SPAWN:
+    {
+      //  spawn stmt case (the task handle is not kept)
+      CallExpr* c = new CallExpr();
+      spawn_expr(*c);
+      stmts.push_back(c);
+      break;
+    }
+
     case ID:
     {
       //  Need to check if the statement should be a CallExpr or an AssignStmt
@@ -296,6 +464,10 @@ void Parser::stmt(std::list<Stmt*>& stmts)
           Expr* e = new Expr();
           expr(*e);
           c->arg_list.push_back(e);
+
+          //  If there is more than one param, eat the comma and repeat loop
+          if (curr_token.type() == COMMA)
+            eat(COMMA, "Expected COMMA ");
         }
 
         //  Eat closing param
@@ -331,9 +503,11 @@ void Parser::stmt(std::list<Stmt*>& stmts)
       error("Unexpected token ");
       break;
   }
+  stmts.back()->line = first.line();
+  stmts.back()->column = first.column();
 }
 
-void Parser::vdecl_stmt(VarDeclStmt& node)
+inline void Parser::vdecl_stmt(VarDeclStmt& node)
 {
   eat(VAR, "Expected VAR ");
   node.id = curr_token;
@@ -344,9 +518,8 @@ void Parser::vdecl_stmt(VarDeclStmt& node)
   {
     eat(COLON, "Expected COLON ");
     Token* new_id = new Token();
-    *new_id = curr_token;
+    *new_id = type_token();
     node.type = new_id;
-    advance();
   }
 
   eat(ASSIGN, "Expected ASSIGN ");
@@ -356,7 +529,7 @@ void Parser::vdecl_stmt(VarDeclStmt& node)
   node.expr = e;
 }
 
-void Parser::while_stmt(WhileStmt& node)
+inline void Parser::while_stmt(WhileStmt& node)
 {
   eat(WHILE, "Expected WHILE ");
   Expr* e = new Expr();
@@ -375,10 +548,17 @@ void Parser::while_stmt(WhileStmt& node)
   node.stmts = stmt_list;
 }
 
-void Parser::for_stmt(ForStmt& node)
+inline void Parser::for_stmt(ForStmt& node)
 {
+  if (curr_token.type() == PARALLEL)
+  {
+    eat(PARALLEL, "Expected PARALLEL ");
+    node.parallel = true;
+  }
   eat(FOR, "Expected FOR ");
   node.var_id = curr_token;
+  eat(ID, "Expected ID ");
+  eat(ASSIGN, "Expected ASSIGN ");
   Expr* start = new Expr();
   Expr* end = new Expr();
   expr(*start);
@@ -386,6 +566,24 @@ void Parser::for_stmt(ForStmt& node)
   expr(*end);
   node.start = start;
   node.end = end;
+
+  //  Reductions of a parallel loop: reduce sum x, max y, ...
+  if (node.parallel && curr_token.type() == REDUCE)
+  {
+    eat(REDUCE, "Expected REDUCE ");
+    while (true)
+    {
+      ForStmt::Reduction r;
+      r.op = curr_token;
+      eat(ID, "Expected reduction (sum, min, or max) ");
+      r.var_id = curr_token;
+      eat(ID, "Expected ID ");
+      node.reductions.push_back(r);
+      if (curr_token.type() != COMMA)
+        break;
+      eat(COMMA, "Expected COMMA ");
+    }
+  }
   eat(DO, "Expected DO ");
 
   //  Initialize new list for all possible stmts in the for loop
@@ -399,7 +597,7 @@ void Parser::for_stmt(ForStmt& node)
   node.stmts = stmt_list;
 }
 
-void Parser::if_stmt(IfStmt& node)
+inline void Parser::if_stmt(IfStmt& node)
 {
   BasicIf* bi = new BasicIf();
   //  initialize list for Basic If statements
@@ -459,7 +657,7 @@ void Parser::if_stmt(IfStmt& node)
 
 //  Finals parser implementations
 //  Try Stmt node parser
-void Parser::try_stmt(TryStmt& node)
+inline void Parser::try_stmt(TryStmt& node)
 {
   eat (TRY, "Expected TRY ");
   std::list<Stmt*> try_stmts;
@@ -473,7 +671,7 @@ void Parser::try_stmt(TryStmt& node)
   node.catch_stmt = c;
 }
 
-void Parser::throw_stmt(ThrowStmt& node)
+inline void Parser::throw_stmt(ThrowStmt& node)
 {
   eat (THROW, "Expected THROW: ");
   Expr *e = new Expr();
@@ -482,7 +680,7 @@ void Parser::throw_stmt(ThrowStmt& node)
 }
 
 //  Try stmt node parser
-void Parser::catch_stmt(CatchStmt& node)
+inline void Parser::catch_stmt(CatchStmt& node)
 {
   eat (CATCH, "Expected CATCH ");
   eat (LPAREN, "Expected LPAREN ");
@@ -518,7 +716,7 @@ void Parser::catch_stmt(CatchStmt& node)
   eat(END, "Expected END ");
 }
 
-void Parser::return_stmt(ReturnStmt& node)
+inline void Parser::return_stmt(ReturnStmt& node)
 {
   eat(RETURN, "Expected RETURN ");
   Expr* e = new Expr();
@@ -526,10 +724,33 @@ void Parser::return_stmt(ReturnStmt& node)
   node.expr = e;
 }
 
+//  Spawn node parser (spawn f(args))
+inline void Parser::spawn_expr(CallExpr& node)
+{
+  eat(SPAWN, "Expected SPAWN ");
+  node.spawn = true;
+  node.function_id = curr_token;
+  eat(ID, "Expected function ID ");
+  eat(LPAREN, "Expected LPAREN ");
+
+  while (curr_token.type() != RPAREN)
+  {
+    Expr* e = new Expr();
+    expr(*e);
+    node.arg_list.push_back(e);
+
+    //  If there is more than one param, eat the comma and repeat loop
+    if (curr_token.type() == COMMA)
+      eat(COMMA, "Expected COMMA ");
+  }
+
+  eat(RPAREN, "Expected RPAREN ");
+}
+
 //  --------------------------------
 //            Expressions
 //  --------------------------------
-void Parser::expr(Expr& node)
+inline void Parser::expr(Expr& node)
 {
   if (curr_token.type() == NEG)
   {
@@ -560,8 +781,7 @@ void Parser::expr(Expr& node)
     node.first = c;
 
     //  Check for closing paran
-    if (curr_token.type() == RPAREN)
-      eat(RPAREN, "Expected RPAREN");
+    eat(RPAREN, "Expected RPAREN ");
   }
 
   else
@@ -582,14 +802,10 @@ void Parser::expr(Expr& node)
     Expr* e = new Expr();
     expr(*e);
     node.rest = e;
-
-    //  Eat closing paren
-    if (curr_token.type() == RPAREN)
-      eat(RPAREN, "Expected RPAREN ");
   }
 }
 
-void Parser::simple_term(SimpleTerm& node)
+inline void Parser::simple_term(SimpleTerm& node)
 {
   if (curr_token.type() == INT_VAL || curr_token.type() == DOUBLE_VAL
       || curr_token.type() == BOOL_VAL || curr_token.type() == CHAR_VAL
@@ -606,11 +822,34 @@ void Parser::simple_term(SimpleTerm& node)
     //  NewRValue Case
     NewRValue* n = new NewRValue();
     eat(NEW, "Expected NEW ");
-    n->type_id = curr_token;
-    eat(ID, "Expected Type ID ");
+    if (curr_token.type() == CHANNEL)
+    {
+      //  Channel with an optional capacity: new channel<T>(n)
+      n->type_id = type_token();
+      if (curr_token.type() == LPAREN)
+      {
+        eat(LPAREN, "Expected LPAREN ");
+        n->capacity = new Expr();
+        expr(*n->capacity);
+        eat(RPAREN, "Expected RPAREN ");
+      }
+    }
+    else
+    {
+      n->type_id = curr_token;
+      eat(ID, "Expected Type ID ");
+    }
     node.rvalue = n;
   }
 
+  else if (curr_token.type() == SPAWN)
+  {
+    //  Spawned CallExpr case
+    CallExpr* c = new CallExpr();
+    spawn_expr(*c);
+    node.rvalue = c;
+  }
+
   else if (curr_token.type() == NEG)
   {
     //  NegatedRValue Case
@@ -669,7 +908,7 @@ void Parser::simple_term(SimpleTerm& node)
     error("Something went wrong ");
 }
 
-void Parser::pval(SimpleRValue& node)
+inline void Parser::pval(SimpleRValue& node)
 {
   node.value = curr_token;
   switch(curr_token.type())
@@ -0,0 +1,190 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: phase_stats.h
+// DATE: Spring 2021
+// DESC: Per-phase resource report for the mypl driver (--phase-stats).
+//       Each phase (lex, parse, typecheck, optimize, execute) records
+//       wall time, CPU time, the growth of peak RSS, and the number and
+//       size of heap allocations made while it ran (see
+//       alloc_counters.h). Hardware counters (see hw_counters.h) are
+//       added when attached, and phases are also recorded as trace
+//       events when a tracer is attached.
+//----------------------------------------------------------------------
+
+#ifndef PHASE_STATS_H
+#define PHASE_STATS_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <sys/resource.h>
+#include "alloc_counters.h"
+#include "hw_counters.h"
+#include "tracer.h"
+
+
+class PhaseStats
+{
+public:
+
+  // start measuring the named phase (ends any phase still running)
+  void begin(const char* name);
+
+  // stop measuring the current phase (no-op if none is running)
+  void end();
+
+  // a human-readable table of the measured phases
+  std::string report() const;
+
+  // the measured phases as a JSON object
+  std::string json() const;
+
+  // also record each phase as a trace event
+  void set_tracer(Tracer* t) {tracer = t;}
+
+  // also report hardware counters for each phase
+  void set_hw_counters(HwCounters* c) {hw_counters = c;}
+
+private:
+
+  struct Phase
+  {
+    std::string name;
+    double wall_ms = 0;
+    double cpu_ms = 0;
+    long rss_kb = 0;          // growth of peak RSS during the phase
+    size_t allocs = 0;
+    size_t alloc_bytes = 0;
+    HwCounters::Values hw;
+  };
+
+  std::vector<Phase> phases;
+  bool running = false;
+  const char* curr_name = nullptr;
+  Tracer* tracer = nullptr;
+  HwCounters* hw_counters = nullptr;
+
+  // values at the start of the current phase
+  std::chrono::steady_clock::time_point wall_start;
+  double cpu_start = 0;
+  long rss_start = 0;
+  size_t allocs_start = 0;
+  size_t bytes_start = 0;
+  HwCounters::Values hw_start;
+
+  static double cpu_ms();
+  static long peak_rss_kb();
+};
+
+
+double PhaseStats::cpu_ms()
+{
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+
+long PhaseStats::peak_rss_kb()
+{
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+
+void PhaseStats::begin(const char* name)
+{
+  end();
+  curr_name = name;
+  Phase p;
+  p.name = name;
+  phases.push_back(p);
+  running = true;
+  AllocCounters::enable();
+  allocs_start = AllocCounters::count();
+  bytes_start = AllocCounters::bytes();
+  rss_start = peak_rss_kb();
+  cpu_start = cpu_ms();
+  if (hw_counters)
+    hw_start = hw_counters->read();
+  wall_start = std::chrono::steady_clock::now();
+}
+
+
+void PhaseStats::end()
+{
+  if (!running)
+    return;
+  auto wall_end = std::chrono::steady_clock::now();
+  double cpu_end = cpu_ms();
+  Phase& p = phases.back();
+  if (hw_counters)
+    p.hw = hw_counters->read() - hw_start;
+  p.wall_ms = std::chrono::duration<double, std::milli>(wall_end - wall_start).count();
+  p.cpu_ms = cpu_end - cpu_start;
+  p.rss_kb = peak_rss_kb() - rss_start;
+  p.allocs = AllocCounters::count() - allocs_start;
+  p.alloc_bytes = AllocCounters::bytes() - bytes_start;
+  running = false;
+  AllocCounters::disable();
+  if (tracer)
+    tracer->complete(curr_name, "phase", wall_start, wall_end);
+}
+
+
+std::string PhaseStats::report() const
+{
+  std::string s;
+  char line[160];
+  snprintf(line, sizeof(line), "%-10s %12s %12s %10s %10s %14s\n",
+           "phase", "wall (ms)", "cpu (ms)", "rss (KB)", "allocs", "bytes");
+  s += line;
+  Phase total;
+  for (const Phase& p : phases) {
+    snprintf(line, sizeof(line), "%-10s %12.3f %12.3f %10ld %10zu %14zu\n",
+             p.name.c_str(), p.wall_ms, p.cpu_ms, p.rss_kb, p.allocs, p.alloc_bytes);
+    s += line;
+    total.wall_ms += p.wall_ms;
+    total.cpu_ms += p.cpu_ms;
+    total.rss_kb += p.rss_kb;
+    total.allocs += p.allocs;
+    total.alloc_bytes += p.alloc_bytes;
+  }
+  snprintf(line, sizeof(line), "%-10s %12.3f %12.3f %10ld %10zu %14zu\n",
+           "total", total.wall_ms, total.cpu_ms, total.rss_kb, total.allocs,
+           total.alloc_bytes);
+  s += line;
+  if (hw_counters) {
+    s += "\n" + std::string("phase     ") + HwCounters::header() + "\n";
+    for (const Phase& p : phases) {
+      snprintf(line, sizeof(line), "%-10s", p.name.c_str());
+      s += line + HwCounters::report(p.hw) + "\n";
+    }
+  }
+  return s;
+}
+
+
+std::string PhaseStats::json() const
+{
+  std::string s = "{\"phases\": [";
+  char buf[256];
+  for (size_t i = 0; i < phases.size(); ++i) {
+    const Phase& p = phases[i];
+    snprintf(buf, sizeof(buf),
+             "%s\n  {\"name\": \"%s\", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+             "\"rss_kb\": %ld, \"allocs\": %zu, \"alloc_bytes\": %zu",
+             i > 0 ? "," : "", p.name.c_str(), p.wall_ms, p.cpu_ms, p.rss_kb,
+             p.allocs, p.alloc_bytes);
+    s += buf;
+    if (hw_counters)
+      s += ", \"hw\": {" + HwCounters::json(p.hw) + "}";
+    s += "}";
+  }
+  return s + "\n]}\n";
+}
+
+#endif
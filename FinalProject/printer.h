@@ -35,6 +35,7 @@ public:
   void visit(CatchStmt& node);
   // expressions
   void visit(Expr& node);
+  void visit(QuickExpr& node);
   void visit(SimpleTerm& node);
   void visit(ComplexTerm& node);
   // rvalues
@@ -233,10 +234,20 @@ void Printer::visit(WhileStmt& node)
 void Printer::visit(ForStmt& node)
 {
   //  Print out the ForStmt
+  if (node.parallel)
+    cout << "parallel ";
   cout << "for " << node.var_id.lexeme();
   node.start->accept(*this);
   cout << " to ";
   node.end->accept(*this);
+
+  //  Print out the reduction clause
+  bool first = true;
+  for (const ForStmt::Reduction& r : node.reductions)
+  {
+    cout << (first ? " reduce " : ", ") << r.op.lexeme() << " " << r.var_id.lexeme();
+    first = false;
+  }
   cout << " do" << endl;
   inc_indent();
 
@@ -318,6 +329,9 @@ void Printer::visit(Expr& node)
   }
 }
 
+//  Accept quickened expr visitor (prints like the generic expression)
+void Printer::visit(QuickExpr& node) { visit((Expr&)node); }
+
 //  Accept simple term visitor
 void Printer::visit(SimpleTerm& node) { node.rvalue->accept(*this); }
 
@@ -328,11 +342,21 @@ void Printer::visit(ComplexTerm& node) { node.expr->accept(*this); }
 void Printer::visit(SimpleRValue& node) { cout << node.value.lexeme(); }
 
 //  Accept new rval term visitor
-void Printer::visit(NewRValue& node) { cout << "new " << node.type_id.lexeme(); }
+void Printer::visit(NewRValue& node)
+{
+  cout << "new " << node.type_id.lexeme();
+  if (node.capacity) {
+    cout << "(";
+    node.capacity->accept(*this);
+    cout << ")";
+  }
+}
 
 //  Accept call expr visitor
 void Printer::visit(CallExpr& node)
 {
+  if (node.spawn)
+    cout << "spawn ";
   cout << node.function_id.lexeme() << "(";
   if (node.arg_list.size() == 1)
     node.arg_list.front()->accept(*this);
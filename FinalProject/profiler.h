@@ -0,0 +1,225 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: profiler.h
+// DATE: Spring 2021
+// DESC: Function-level profiler for MyPL programs (--profile). The
+//       interpreter opens a Profiler::Scope around each user function
+//       call; the profiler keeps a call tree with call counts, time,
+//       and allocation counts, and reports per-function totals and the
+//       tree as collapsed stacks (one "main;f;g <usec>" line per path,
+//       the input format of flamegraph.pl and speedscope).
+//----------------------------------------------------------------------
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "alloc_counters.h"
+
+
+class Profiler
+{
+public:
+
+  // records one call for as long as the scope is alive (does nothing
+  // if the profiler is null, i.e. profiling is disabled)
+  class Scope
+  {
+  public:
+    Scope(Profiler* p, const std::string& name) : profiler(p)
+    {
+      if (profiler)
+        profiler->enter(name);
+    }
+    ~Scope()
+    {
+      if (profiler)
+        profiler->exit();
+    }
+  private:
+    Profiler* profiler;
+  };
+
+  Profiler();
+  ~Profiler();
+
+  // per-function totals, sorted by exclusive time
+  std::string report() const;
+
+  // write the call tree as collapsed stacks (times in microseconds)
+  void write_collapsed(std::ostream& out) const;
+
+private:
+
+  typedef std::chrono::steady_clock Clock;
+
+  // totals for one function
+  struct FunStats
+  {
+    std::string name;
+    long calls = 0;
+    long active = 0;           // calls currently on the stack
+    double inclusive_us = 0;   // not counted again for recursive calls
+    double exclusive_us = 0;
+    size_t allocs = 0;         // exclusive
+    size_t alloc_bytes = 0;
+  };
+
+  // a call path in the call tree
+  struct Node
+  {
+    FunStats* fun = nullptr;
+    Node* parent = nullptr;
+    std::map<std::string, Node*> children;
+    double exclusive_us = 0;
+  };
+
+  // an active call
+  struct Frame
+  {
+    Node* node;
+    Clock::time_point start;
+    double child_us;
+    size_t allocs_start;
+    size_t bytes_start;
+    size_t child_allocs;
+    size_t child_bytes;
+  };
+
+  std::map<std::string, FunStats> functions;
+  Node root;
+  std::vector<Frame> stack;
+
+  void enter(const std::string& name);
+  void exit();
+
+  void delete_tree(Node* node);
+  void collapsed(const Node* node, const std::string& path, std::ostream& out) const;
+};
+
+
+inline Profiler::Profiler()
+{
+  AllocCounters::enable();
+  stack.reserve(1024);
+}
+
+
+inline Profiler::~Profiler()
+{
+  AllocCounters::disable();
+  for (auto& child : root.children)
+    delete_tree(child.second);
+}
+
+
+inline void Profiler::delete_tree(Node* node)
+{
+  for (auto& child : node->children)
+    delete_tree(child.second);
+  delete node;
+}
+
+
+inline void Profiler::enter(const std::string& name)
+{
+  Node* parent = stack.empty() ? &root : stack.back().node;
+  Node*& node = parent->children[name];
+  if (!node) {
+    node = new Node;
+    node->fun = &functions[name];
+    node->fun->name = name;
+    node->parent = parent;
+  }
+  ++node->fun->calls;
+  ++node->fun->active;
+  // sample the counters last so the profiler's own work is not counted
+  stack.push_back({node, Clock::time_point(), 0, AllocCounters::count(),
+                   AllocCounters::bytes(), 0, 0});
+  stack.back().start = Clock::now();
+}
+
+
+inline void Profiler::exit()
+{
+  Clock::time_point end = Clock::now();
+  size_t allocs = AllocCounters::count();
+  size_t bytes = AllocCounters::bytes();
+  Frame f = stack.back();
+  stack.pop_back();
+
+  double total_us = std::chrono::duration<double, std::micro>(end - f.start).count();
+  size_t total_allocs = allocs - f.allocs_start;
+  size_t total_bytes = bytes - f.bytes_start;
+  FunStats* fun = f.node->fun;
+  --fun->active;
+  if (fun->active == 0)
+    fun->inclusive_us += total_us;
+  fun->exclusive_us += total_us - f.child_us;
+  fun->allocs += total_allocs - f.child_allocs;
+  fun->alloc_bytes += total_bytes - f.child_bytes;
+  f.node->exclusive_us += total_us - f.child_us;
+
+  if (!stack.empty()) {
+    stack.back().child_us += total_us;
+    stack.back().child_allocs += total_allocs;
+    stack.back().child_bytes += total_bytes;
+  }
+}
+
+
+inline std::string Profiler::report() const
+{
+  std::vector<const FunStats*> sorted;
+  double total_us = 0;
+  for (auto& f : functions) {
+    sorted.push_back(&f.second);
+    total_us += f.second.exclusive_us;
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](const FunStats* a, const FunStats* b) {
+              return a->exclusive_us > b->exclusive_us;
+            });
+
+  std::string s;
+  char line[256];
+  snprintf(line, sizeof(line), "%-20s %10s %14s %14s %7s %10s %14s\n",
+           "function", "calls", "incl (ms)", "excl (ms)", "excl %",
+           "allocs", "alloc bytes");
+  s += line;
+  for (const FunStats* f : sorted) {
+    snprintf(line, sizeof(line), "%-20s %10ld %14.3f %14.3f %6.1f%% %10zu %14zu\n",
+             f->name.c_str(), f->calls, f->inclusive_us / 1000,
+             f->exclusive_us / 1000,
+             total_us > 0 ? 100 * f->exclusive_us / total_us : 0.0,
+             f->allocs, f->alloc_bytes);
+    s += line;
+  }
+  return s;
+}
+
+
+inline void Profiler::write_collapsed(std::ostream& out) const
+{
+  for (auto& child : root.children)
+    collapsed(child.second, child.first, out);
+}
+
+
+inline void Profiler::collapsed(const Node* node, const std::string& path,
+                         std::ostream& out) const
+{
+  long us = (long)node->exclusive_us;
+  if (us > 0)
+    out << path << " " << us << "\n";
+  for (auto& child : node->children)
+    collapsed(child.second, path + ";" + child.first, out);
+}
+
+#endif
@@ -0,0 +1,311 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: quickener.h
+// DATE: Spring 2021
+// DESC: Rewrite pass run after type checking that replaces binary Expr
+//       nodes whose operand types are known (int, double, string, or
+//       bool) with type-specialized QuickExpr nodes. The interpreter
+//       evaluates a QuickExpr without any runtime type tests.
+//----------------------------------------------------------------------
+
+#ifndef QUICKENER_H
+#define QUICKENER_H
+
+#include "ast.h"
+
+
+class Quickener : public Visitor
+{
+public:
+  // top-level
+  void visit(Program& node);
+  void visit(FunDecl& node);
+  void visit(TypeDecl& node);
+  // statements
+  void visit(VarDeclStmt& node);
+  void visit(AssignStmt& node);
+  void visit(ReturnStmt& node);
+  void visit(IfStmt& node);
+  void visit(WhileStmt& node);
+  void visit(ForStmt& node);
+  void visit(TryStmt& node);
+  void visit(CatchStmt& node);
+  void visit(ThrowStmt& node);
+  // expressions
+  void visit(Expr& node);
+  void visit(QuickExpr& node);
+  void visit(SimpleTerm& node);
+  void visit(ComplexTerm& node);
+  // rvalues
+  void visit(SimpleRValue& node);
+  void visit(NewRValue& node);
+  void visit(CallExpr& node);
+  void visit(IDRValue& node);
+  void visit(NegatedRValue& node);
+
+  // number of expressions specialized so far
+  int quickened_count() const;
+
+private:
+  int count = 0;
+
+  // rewrite the expression (and its subexpressions), returning either
+  // the original node or its specialized replacement
+  Expr* quicken(Expr* e);
+
+  // find the specialized op for the operator and operand types
+  bool quick_op(TokenType op, const std::string& lhs_type,
+                const std::string& rhs_type, QuickExpr::QuickOp& result);
+
+  // rewrite each statement in a body
+  void quicken_stmts(std::list<Stmt*>& stmts);
+};
+
+
+inline int Quickener::quickened_count() const
+{
+  return count;
+}
+
+
+inline Expr* Quickener::quicken(Expr* e)
+{
+  if (!e)
+    return e;
+  e->accept(*this);
+  //  negated expressions only evaluate their first term
+  if (e->negated or !e->op or !e->rest)
+    return e;
+  QuickExpr::QuickOp op;
+  if (!quick_op(e->op->type(), e->first->type, e->rest->type, op))
+    return e;
+
+  //  Move the children into the specialized node
+  QuickExpr* q = new QuickExpr;
+  q->first = e->first;
+  q->op = e->op;
+  q->rest = e->rest;
+  q->type = e->type;
+  q->quick_op = op;
+  e->first = nullptr;
+  e->op = nullptr;
+  e->rest = nullptr;
+  delete e;
+  ++count;
+  return q;
+}
+
+
+inline bool Quickener::quick_op(TokenType op, const std::string& lhs_type,
+                         const std::string& rhs_type, QuickExpr::QuickOp& result)
+{
+  if (lhs_type != rhs_type)
+    return false;
+
+  if (lhs_type == "int")
+  {
+    switch (op)
+    {
+      case PLUS: result = QuickExpr::INT_ADD; return true;
+      case MINUS: result = QuickExpr::INT_SUB; return true;
+      case MULTIPLY: result = QuickExpr::INT_MUL; return true;
+      case DIVIDE: result = QuickExpr::INT_DIV; return true;
+      case MODULO: result = QuickExpr::INT_MOD; return true;
+      case LESS: result = QuickExpr::INT_LESS; return true;
+      case LESS_EQUAL: result = QuickExpr::INT_LESS_EQUAL; return true;
+      case GREATER: result = QuickExpr::INT_GREATER; return true;
+      case GREATER_EQUAL: result = QuickExpr::INT_GREATER_EQUAL; return true;
+      case EQUAL: result = QuickExpr::INT_EQUAL; return true;
+      case NOT_EQUAL: result = QuickExpr::INT_NOT_EQUAL; return true;
+      default: return false;
+    }
+  }
+
+  else if (lhs_type == "double")
+  {
+    switch (op)
+    {
+      case PLUS: result = QuickExpr::DOUBLE_ADD; return true;
+      case MINUS: result = QuickExpr::DOUBLE_SUB; return true;
+      case MULTIPLY: result = QuickExpr::DOUBLE_MUL; return true;
+      case DIVIDE: result = QuickExpr::DOUBLE_DIV; return true;
+      case LESS: result = QuickExpr::DOUBLE_LESS; return true;
+      case LESS_EQUAL: result = QuickExpr::DOUBLE_LESS_EQUAL; return true;
+      case GREATER: result = QuickExpr::DOUBLE_GREATER; return true;
+      case GREATER_EQUAL: result = QuickExpr::DOUBLE_GREATER_EQUAL; return true;
+      case EQUAL: result = QuickExpr::DOUBLE_EQUAL; return true;
+      case NOT_EQUAL: result = QuickExpr::DOUBLE_NOT_EQUAL; return true;
+      default: return false;
+    }
+  }
+
+  else if (lhs_type == "string")
+  {
+    switch (op)
+    {
+      case PLUS: result = QuickExpr::STRING_CONCAT; return true;
+      case EQUAL: result = QuickExpr::STRING_EQUAL; return true;
+      case NOT_EQUAL: result = QuickExpr::STRING_NOT_EQUAL; return true;
+      default: return false;
+    }
+  }
+
+  else if (lhs_type == "bool")
+  {
+    switch (op)
+    {
+      case AND: result = QuickExpr::BOOL_AND; return true;
+      case OR: result = QuickExpr::BOOL_OR; return true;
+      default: return false;
+    }
+  }
+
+  return false;
+}
+
+
+inline void Quickener::quicken_stmts(std::list<Stmt*>& stmts)
+{
+  for (Stmt* s : stmts)
+    s->accept(*this);
+}
+
+
+/* --------------------------------
+      Top Level Visitors
+---------------------------------*/
+
+inline void Quickener::visit(Program& node)
+{
+  for (Decl* d : node.decls)
+    d->accept(*this);
+}
+
+inline void Quickener::visit(FunDecl& node)
+{
+  quicken_stmts(node.stmts);
+}
+
+inline void Quickener::visit(TypeDecl& node)
+{
+  for (VarDeclStmt* v : node.vdecls)
+    v->accept(*this);
+}
+
+/* --------------------------------
+        Statement Visitors
+---------------------------------*/
+
+inline void Quickener::visit(VarDeclStmt& node)
+{
+  node.expr = quicken(node.expr);
+}
+
+inline void Quickener::visit(AssignStmt& node)
+{
+  node.expr = quicken(node.expr);
+}
+
+inline void Quickener::visit(ReturnStmt& node)
+{
+  node.expr = quicken(node.expr);
+}
+
+inline void Quickener::visit(IfStmt& node)
+{
+  node.if_part->expr = quicken(node.if_part->expr);
+  quicken_stmts(node.if_part->stmts);
+  for (BasicIf* b : node.else_ifs)
+  {
+    b->expr = quicken(b->expr);
+    quicken_stmts(b->stmts);
+  }
+  quicken_stmts(node.body_stmts);
+}
+
+inline void Quickener::visit(WhileStmt& node)
+{
+  node.expr = quicken(node.expr);
+  quicken_stmts(node.stmts);
+}
+
+inline void Quickener::visit(ForStmt& node)
+{
+  node.start = quicken(node.start);
+  node.end = quicken(node.end);
+  quicken_stmts(node.stmts);
+}
+
+inline void Quickener::visit(TryStmt& node)
+{
+  quicken_stmts(node.stmts);
+  if (node.catch_stmt)
+    node.catch_stmt->accept(*this);
+}
+
+inline void Quickener::visit(CatchStmt& node)
+{
+  node.catch_expr = quicken(node.catch_expr);
+  quicken_stmts(node.stmts);
+}
+
+inline void Quickener::visit(ThrowStmt& node)
+{
+  node.expr = quicken(node.expr);
+}
+
+/* --------------------------------
+        Expression Visitors
+---------------------------------*/
+
+inline void Quickener::visit(Expr& node)
+{
+  node.first->accept(*this);
+  node.rest = quicken(node.rest);
+}
+
+inline void Quickener::visit(QuickExpr& node)
+{
+  visit((Expr&)node);
+}
+
+inline void Quickener::visit(SimpleTerm& node)
+{
+  node.rvalue->accept(*this);
+}
+
+inline void Quickener::visit(ComplexTerm& node)
+{
+  node.expr = quicken(node.expr);
+}
+
+/* --------------------------------
+      Rvalue Visitors
+---------------------------------*/
+
+inline void Quickener::visit(SimpleRValue&)
+{
+}
+
+inline void Quickener::visit(NewRValue& node)
+{
+  if (node.capacity)
+    node.capacity = quicken(node.capacity);
+}
+
+inline void Quickener::visit(CallExpr& node)
+{
+  for (Expr*& e : node.arg_list)
+    e = quicken(e);
+}
+
+inline void Quickener::visit(IDRValue&)
+{
+}
+
+inline void Quickener::visit(NegatedRValue& node)
+{
+  node.expr = quicken(node.expr);
+}
+
+#endif
@@ -0,0 +1,193 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: runtime_stats.h
+// DATE: Spring 2021
+// DESC: Runtime event counters (printed with --stats). Each thread
+//       increments its own counter block without synchronization; the
+//       blocks are registered in a global list the first time a thread
+//       counts something and are summed for the report. When a thread
+//       exits, its counts are added to a block kept for finished
+//       threads and its own block is freed.
+//----------------------------------------------------------------------
+
+#ifndef RUNTIME_STATS_H
+#define RUNTIME_STATS_H
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+struct RuntimeCounters
+{
+  // built-in functions (in report order)
+  enum BuiltIn {PRINT, READ, STOI, ITOS, STOD, DTOS, GET, LENGTH, AWAIT, SEND, RECV,
+                TRY_RECV, CLOSE, BUILT_IN_COUNT};
+
+  // data objects
+  size_t data_constructs = 0;
+  size_t data_copies = 0;
+  size_t data_moves = 0;
+  size_t data_allocs = 0;       // value storage allocated on the C++ heap
+  // symbol table
+  size_t env_pushes = 0;
+  size_t env_pops = 0;
+  size_t lookups = 0;
+  size_t lookup_depth = 0;      // environments searched by all lookups
+  // heap
+  size_t heap_created = 0;
+  // calls
+  size_t calls = 0;
+  size_t max_call_depth = 0;
+  // errors and thrown values
+  size_t exceptions = 0;
+  size_t built_in_calls[BUILT_IN_COUNT] = {};
+};
+
+
+class RuntimeStats
+{
+public:
+
+  // the calling thread's counters
+  static RuntimeCounters& local()
+  {
+    static thread_local Block block;
+    return block.counters;
+  }
+
+  // counts a call and adds one to the caller's depth (kept by the
+  // caller, since a task may resume on another thread during the call)
+  // for as long as the scope is alive
+  class CallScope
+  {
+  public:
+    explicit CallScope(size_t& depth) : depth(depth)
+    {
+      RuntimeCounters& counters = local();
+      ++counters.calls;
+      if (++depth > counters.max_call_depth)
+        counters.max_call_depth = depth;
+    }
+    ~CallScope() {--depth;}
+  private:
+    size_t& depth;
+  };
+
+  // the counters of all threads added together
+  static RuntimeCounters total();
+
+  // a human-readable report of the totals
+  static std::string report();
+
+private:
+
+  // the blocks of running threads, and the counts of finished ones
+  struct Registry
+  {
+    std::mutex lock;
+    std::vector<RuntimeCounters*> blocks;
+    RuntimeCounters finished;
+  };
+
+  static Registry& registry()
+  {
+    static Registry all;
+    return all;
+  }
+
+  // a thread's counters, registered while the thread runs (the
+  // registry is made first, so it outlives every block)
+  struct Block
+  {
+    RuntimeCounters counters;
+    Block()
+    {
+      Registry& r = registry();
+      std::lock_guard<std::mutex> guard(r.lock);
+      r.blocks.push_back(&counters);
+    }
+    ~Block()
+    {
+      Registry& r = registry();
+      std::lock_guard<std::mutex> guard(r.lock);
+      add(r.finished, counters);
+      r.blocks.erase(std::find(r.blocks.begin(), r.blocks.end(), &counters));
+    }
+  };
+
+  // add the counts of b to sum
+  static void add(RuntimeCounters& sum, const RuntimeCounters& b);
+};
+
+
+inline void RuntimeStats::add(RuntimeCounters& sum, const RuntimeCounters& b)
+{
+  sum.data_constructs += b.data_constructs;
+  sum.data_copies += b.data_copies;
+  sum.data_moves += b.data_moves;
+  sum.data_allocs += b.data_allocs;
+  sum.env_pushes += b.env_pushes;
+  sum.env_pops += b.env_pops;
+  sum.lookups += b.lookups;
+  sum.lookup_depth += b.lookup_depth;
+  sum.heap_created += b.heap_created;
+  sum.calls += b.calls;
+  if (b.max_call_depth > sum.max_call_depth)
+    sum.max_call_depth = b.max_call_depth;
+  sum.exceptions += b.exceptions;
+  for (int i = 0; i < RuntimeCounters::BUILT_IN_COUNT; ++i)
+    sum.built_in_calls[i] += b.built_in_calls[i];
+}
+
+
+inline RuntimeCounters RuntimeStats::total()
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+  RuntimeCounters sum = r.finished;
+  for (const RuntimeCounters* b : r.blocks)
+    add(sum, *b);
+  return sum;
+}
+
+
+inline std::string RuntimeStats::report()
+{
+  const char* built_in_names[] =
+    {"print", "read", "stoi", "itos", "stod", "dtos", "get", "length", "await", "send",
+     "recv", "try_recv", "close"};
+  RuntimeCounters t = total();
+  std::string s;
+  char line[128];
+  auto row = [&](const char* name, size_t value) {
+    snprintf(line, sizeof(line), "  %-24s %14zu\n", name, value);
+    s += line;
+  };
+  s += "data objects\n";
+  row("constructed", t.data_constructs);
+  row("copied", t.data_copies);
+  row("moved", t.data_moves);
+  row("value allocations", t.data_allocs);
+  s += "symbol table\n";
+  row("environment pushes", t.env_pushes);
+  row("environment pops", t.env_pops);
+  row("lookups", t.lookups);
+  snprintf(line, sizeof(line), "  %-24s %14.2f\n", "avg environments walked",
+           t.lookups ? (double)t.lookup_depth / t.lookups : 0.0);
+  s += line;
+  s += "heap\n";
+  row("objects created", t.heap_created);
+  s += "calls\n";
+  row("user function calls", t.calls);
+  row("max call depth", t.max_call_depth);
+  row("exceptions thrown", t.exceptions);
+  s += "built-in calls\n";
+  for (int i = 0; i < RuntimeCounters::BUILT_IN_COUNT; ++i)
+    row(built_in_names[i], t.built_in_calls[i]);
+  return s;
+}
+
+#endif
@@ -0,0 +1,296 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: sample_profiler.h
+// DATE: Spring 2021
+// DESC: Sampling profiler for MyPL programs (--sample-profile=HZ).
+//       The interpreter keeps a shadow stack of the user functions being
+//       called and the line of the statement being executed; a SIGPROF
+//       timer (setitimer) copies them into a preallocated sample buffer
+//       HZ times per second of CPU time. The signal handler only reads
+//       and writes plain memory, so it is async-signal-safe; samples
+//       are aggregated into a report and collapsed stacks at exit.
+//----------------------------------------------------------------------
+
+#ifndef SAMPLE_PROFILER_H
+#define SAMPLE_PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+
+class SampleProfiler
+{
+public:
+
+  // pushes a function name on the shadow stack for as long as the scope
+  // is alive (does nothing if the profiler is null); the name must
+  // outlive the profiler
+  class Frame
+  {
+  public:
+    Frame(SampleProfiler* p, const std::string* name) : profiler(p)
+    {
+      if (profiler) {
+        caller_line = profiler->curr_line;
+        profiler->push(name);
+      }
+    }
+    ~Frame()
+    {
+      if (profiler) {
+        profiler->pop();
+        profiler->curr_line = caller_line;
+      }
+    }
+  private:
+    SampleProfiler* profiler;
+    int caller_line = 0;
+  };
+
+  // start sampling at the given rate (samples per second of CPU time)
+  SampleProfiler(int hz);
+
+  // stop sampling
+  ~SampleProfiler();
+
+  // record the line of the statement about to run
+  void set_line(int line) {curr_line = line;}
+
+  // stop the timer (samples taken so far are kept)
+  void stop();
+
+  // per-function and per-line sample counts
+  std::string report() const;
+
+  // write the samples as collapsed stacks (one line per distinct stack)
+  void write_collapsed(std::ostream& out) const;
+
+private:
+
+  static const int MAX_DEPTH = 256;          // deeper frames are cut off
+  static const size_t MAX_SAMPLES = 1 << 16;
+  static const size_t MAX_FRAMES = 1 << 20;
+
+  // a sample: the innermost line and frames[first, first + depth)
+  struct Sample
+  {
+    size_t first;
+    int depth;
+    int line;
+  };
+
+  // shadow stack (written by the interpreter, read by the handler)
+  const std::string* stack[MAX_DEPTH];
+  volatile int depth = 0;
+  volatile int curr_line = 0;
+
+  // sample storage (written only by the handler until stop()); left
+  // uninitialized so untouched pages cost no memory
+  Sample* samples;
+  const std::string** frames;
+  size_t sample_count = 0;
+  size_t frame_count = 0;
+  volatile size_t dropped = 0;
+  int rate = 0;
+  bool running = false;
+  struct sigaction old_action;
+
+  // the running profiler the signal handler samples into (if any)
+  static SampleProfiler*& active();
+  static void on_signal(int sig);
+
+  void push(const std::string* name);
+  void pop();
+  void take_sample();
+
+  // the function names of a sample, outermost first
+  std::vector<std::string> names(const Sample& s) const;
+};
+
+
+inline SampleProfiler*& SampleProfiler::active()
+{
+  static SampleProfiler* profiler = nullptr;
+  return profiler;
+}
+
+
+inline SampleProfiler::SampleProfiler(int hz)
+  : samples(new Sample[MAX_SAMPLES]), frames(new const std::string*[MAX_FRAMES]),
+    rate(hz)
+{
+  if (hz <= 0)
+    return;
+  active() = this;
+  struct sigaction action;
+  action.sa_handler = on_signal;
+  sigemptyset(&action.sa_mask);
+  // restart interrupted reads (e.g. the read built-in)
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGPROF, &action, &old_action);
+  itimerval timer;
+  timer.it_interval.tv_sec = 0;
+  timer.it_interval.tv_usec = std::max(1, 1000000 / hz);
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  running = true;
+}
+
+
+inline SampleProfiler::~SampleProfiler()
+{
+  stop();
+  delete [] samples;
+  delete [] frames;
+}
+
+
+inline void SampleProfiler::stop()
+{
+  if (!running)
+    return;
+  itimerval timer = {};
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  sigaction(SIGPROF, &old_action, nullptr);
+  active() = nullptr;
+  running = false;
+}
+
+
+inline void SampleProfiler::push(const std::string* name)
+{
+  int d = depth;
+  if (d < MAX_DEPTH)
+    stack[d] = name;
+  // the frame must be visible to the handler before the new depth
+  std::atomic_signal_fence(std::memory_order_release);
+  depth = d + 1;
+}
+
+
+inline void SampleProfiler::pop()
+{
+  depth = depth - 1;
+}
+
+
+inline void SampleProfiler::on_signal(int)
+{
+  if (active())
+    active()->take_sample();
+}
+
+
+inline void SampleProfiler::take_sample()
+{
+  int d = depth < MAX_DEPTH ? depth : MAX_DEPTH;
+  std::atomic_signal_fence(std::memory_order_acquire);
+  if (sample_count == MAX_SAMPLES or frame_count + d > MAX_FRAMES) {
+    dropped = dropped + 1;
+    return;
+  }
+  Sample& s = samples[sample_count];
+  s.first = frame_count;
+  s.depth = d;
+  s.line = curr_line;
+  for (int i = 0; i < d; ++i)
+    frames[frame_count + i] = stack[i];
+  frame_count += d;
+  ++sample_count;
+}
+
+
+inline std::vector<std::string> SampleProfiler::names(const Sample& s) const
+{
+  std::vector<std::string> result;
+  if (s.depth == 0)
+    result.push_back("[front end]");
+  for (int i = 0; i < s.depth; ++i)
+    result.push_back(*frames[s.first + i]);
+  return result;
+}
+
+
+inline std::string SampleProfiler::report() const
+{
+  // self: innermost frame; total: anywhere on the stack (once per sample)
+  std::map<std::string, std::pair<size_t, size_t>> functions;
+  std::map<std::pair<std::string, int>, size_t> lines;
+  for (size_t i = 0; i < sample_count; ++i) {
+    std::vector<std::string> stack_names = names(samples[i]);
+    ++functions[stack_names.back()].first;
+    std::vector<std::string> seen;
+    for (const std::string& name : stack_names)
+      if (std::find(seen.begin(), seen.end(), name) == seen.end()) {
+        ++functions[name].second;
+        seen.push_back(name);
+      }
+    if (samples[i].depth > 0)
+      ++lines[{stack_names.back(), samples[i].line}];
+  }
+
+  std::string s;
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%zu samples at %d Hz (%zu dropped)\n\n",
+           sample_count, rate, (size_t)dropped);
+  s += buf;
+  std::vector<std::pair<std::string, std::pair<size_t, size_t>>>
+    sorted(functions.begin(), functions.end());
+  std::sort(sorted.begin(), sorted.end(), [](
+      const std::pair<std::string, std::pair<size_t, size_t>>& a,
+      const std::pair<std::string, std::pair<size_t, size_t>>& b) {
+      return a.second.first > b.second.first;
+    });
+  snprintf(buf, sizeof(buf), "%-20s %10s %7s %10s %7s\n",
+           "function", "self", "self %", "total", "total %");
+  s += buf;
+  for (auto& f : sorted) {
+    snprintf(buf, sizeof(buf), "%-20s %10zu %6.1f%% %10zu %6.1f%%\n",
+             f.first.c_str(), f.second.first,
+             100.0 * f.second.first / std::max<size_t>(sample_count, 1),
+             f.second.second,
+             100.0 * f.second.second / std::max<size_t>(sample_count, 1));
+    s += buf;
+  }
+
+  std::vector<std::pair<std::pair<std::string, int>, size_t>>
+    hot(lines.begin(), lines.end());
+  std::sort(hot.begin(), hot.end(), [](
+      const std::pair<std::pair<std::string, int>, size_t>& a,
+      const std::pair<std::pair<std::string, int>, size_t>& b) {
+      return a.second > b.second;
+    });
+  if (hot.size() > 10)
+    hot.resize(10);
+  s += "\nhot lines\n";
+  for (auto& l : hot) {
+    snprintf(buf, sizeof(buf), "%-20s line %-6d %10zu %6.1f%%\n",
+             l.first.first.c_str(), l.first.second, l.second,
+             100.0 * l.second / std::max<size_t>(sample_count, 1));
+    s += buf;
+  }
+  return s;
+}
+
+
+inline void SampleProfiler::write_collapsed(std::ostream& out) const
+{
+  std::map<std::string, size_t> stacks;
+  for (size_t i = 0; i < sample_count; ++i) {
+    std::string path;
+    for (const std::string& name : names(samples[i]))
+      path += (path.empty() ? "" : ";") + name;
+    ++stacks[path];
+  }
+  for (auto& entry : stacks)
+    out << entry.first << " " << entry.second << "\n";
+}
+
+#endif
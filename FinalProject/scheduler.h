@@ -0,0 +1,455 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: scheduler.h
+// DATE: Spring 2021
+// DESC: M:N scheduler for lightweight tasks (spawn/await). Each task
+//       runs on its own stack as a ucontext green thread; a small set
+//       of worker threads take ready tasks from a shared run queue and
+//       switch to them until they finish or park. A task parks while it
+//       waits for another task or for a blocking call, which runs on a
+//       separate I/O thread, so waiting never ties up a worker. A
+//       WaitQueue lets other code (such as channels) park tasks until a
+//       condition holds.
+//----------------------------------------------------------------------
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cxxabi.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+
+class Scheduler;
+
+
+class Task
+{
+public:
+
+  typedef std::function<void()> Body;
+
+  // true once the body has returned
+  bool done();
+
+private:
+
+  friend class Scheduler;
+
+  // the C++ runtime's per-thread exception state (the exceptions
+  // being handled and the number in flight); it belongs to whichever
+  // task is running, so it moves with the task between workers
+  struct EhState
+  {
+    void* caught = nullptr;
+    unsigned int uncaught = 0;
+  };
+
+  Body body;
+  ucontext_t context;
+  char* stack = nullptr;
+  size_t stack_size = 0;
+  EhState eh;
+  bool exited = false;                  // set by the task as it ends
+
+  // completion and the tasks waiting for it
+  std::mutex lock;
+  std::condition_variable finished;
+  bool complete = false;
+  std::vector<Task*> waiters;
+};
+
+
+class Scheduler
+{
+public:
+
+  // start the given number of workers (0 for one per available core)
+  explicit Scheduler(int threads = 0);
+
+  // the number of workers
+  int size() const {return (int)workers.size();}
+
+  // create a task running body; the caller owns the task and may delete
+  // it once it is done. The body must not throw.
+  Task* spawn(const Task::Body& body);
+
+  // wait for the task to finish: a task parks, any other thread blocks
+  void await(Task* task);
+
+  // run fn, which may block, without holding up a worker: a task parks
+  // while the I/O thread runs it; any other thread runs it directly.
+  // Exceptions from fn are rethrown in the caller.
+  void blocking(const std::function<void()>& fn);
+
+  // the task running on this thread, or nullptr outside of tasks
+  static Task* current();
+
+  // the process-wide scheduler, created on first use and never
+  // destroyed (so exiting while tasks are parked is safe)
+  static Scheduler& global();
+
+  // the number of workers for the global scheduler (before its first use)
+  static void set_global_size(int threads);
+
+  // the stack size of new tasks (a main thread's usual limit; pages are
+  // only committed as the task touches them)
+  static const size_t STACK_SIZE = 8 * 1024 * 1024;
+
+private:
+
+  // a worker thread's own context and the task it is running
+  struct Worker
+  {
+    ucontext_t context;
+    Task* current = nullptr;
+    std::function<void(Task*)> park;    // run once the task has switched out
+  };
+
+  // a blocking call waiting for the I/O thread
+  struct BlockingCall
+  {
+    const std::function<void()>* fn;
+    std::exception_ptr* error;
+    Task* task;
+  };
+
+  std::vector<std::thread> workers;
+  std::thread io_thread;
+
+  std::mutex lock;
+  std::condition_variable ready;
+  std::deque<Task*> run_queue;
+
+  std::mutex io_lock;
+  std::condition_variable io_ready;
+  std::deque<BlockingCall> io_queue;
+
+  // the size set for the global scheduler (0 until set)
+  static int& global_size();
+
+  friend class WaitQueue;
+
+  static Worker*& this_worker();
+  static Task::EhState& eh_globals();
+  static void trampoline();
+
+  void run();
+  void run_io();
+  void make_ready(Task* task);
+  void suspend(const std::function<void(Task*)>& park);
+  void finish(Task* task);
+};
+
+
+// threads and tasks waiting for a condition that other threads make true
+class WaitQueue
+{
+public:
+
+  WaitQueue() : waiting(0) {}
+
+  // wait until ready() returns true: a task parks, any other thread
+  // blocks. Whoever makes ready() true must call notify_all() after.
+  void wait(const std::function<bool()>& ready);
+
+  // wake the waiters to check their conditions again (cheap when there
+  // are none)
+  void notify_all();
+
+private:
+  std::mutex lock;
+  std::condition_variable changed;
+  std::vector<Task*> tasks;
+  std::atomic<int> waiting;
+};
+
+
+inline int& Scheduler::global_size()
+{
+  static int size = 0;
+  return size;
+}
+
+
+inline bool Task::done()
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return complete;
+}
+
+
+inline Scheduler::Scheduler(int threads)
+{
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 0; i < threads; ++i)
+    workers.push_back(std::thread(&Scheduler::run, this));
+  io_thread = std::thread(&Scheduler::run_io, this);
+  // the workers run until the process exits
+  for (std::thread& t : workers)
+    t.detach();
+  io_thread.detach();
+}
+
+
+inline Scheduler& Scheduler::global()
+{
+  static Scheduler* scheduler = new Scheduler(global_size());
+  return *scheduler;
+}
+
+
+inline void Scheduler::set_global_size(int threads)
+{
+  global_size() = threads;
+}
+
+
+// not inlined, so a task that resumed on another worker never reuses the
+// address of the previous worker's variable
+inline __attribute__((noinline)) Scheduler::Worker*& Scheduler::this_worker()
+{
+  static thread_local Worker* worker = nullptr;
+  return worker;
+}
+
+
+inline Task* Scheduler::current()
+{
+  Worker* worker = this_worker();
+  return worker ? worker->current : nullptr;
+}
+
+
+// the first two members of libsupc++'s __cxa_eh_globals
+inline Task::EhState& Scheduler::eh_globals()
+{
+  return *reinterpret_cast<Task::EhState*>(abi::__cxa_get_globals());
+}
+
+
+inline Task* Scheduler::spawn(const Task::Body& body)
+{
+  Task* task = new Task;
+  task->body = body;
+  // the lowest page is a guard, so an overflow faults instead of
+  // running into other memory
+  size_t page = sysconf(_SC_PAGESIZE);
+  task->stack_size = STACK_SIZE + page;
+  task->stack = (char*)mmap(nullptr, task->stack_size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (task->stack == MAP_FAILED)
+    throw std::bad_alloc();
+  mprotect(task->stack, page, PROT_NONE);
+  getcontext(&task->context);
+  task->context.uc_stack.ss_sp = task->stack;
+  task->context.uc_stack.ss_size = task->stack_size;
+  task->context.uc_link = nullptr;
+  makecontext(&task->context, &Scheduler::trampoline, 0);
+  make_ready(task);
+  return task;
+}
+
+
+inline void Scheduler::trampoline()
+{
+  Task* task = current();
+  try {
+    task->body();
+  }
+  catch (...) {
+    // bodies handle their own errors; nothing can unwind past here
+  }
+  task->body = nullptr;
+  task->exited = true;
+  setcontext(&this_worker()->context);
+}
+
+
+inline void Scheduler::make_ready(Task* task)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    run_queue.push_back(task);
+  }
+  ready.notify_one();
+}
+
+
+inline void Scheduler::suspend(const std::function<void(Task*)>& park)
+{
+  Worker* worker = this_worker();
+  Task* task = worker->current;
+  worker->park = park;
+  swapcontext(&task->context, &worker->context);
+  // resumed, possibly by a different worker
+}
+
+
+inline void Scheduler::await(Task* task)
+{
+  if (!current()) {
+    std::unique_lock<std::mutex> guard(task->lock);
+    task->finished.wait(guard, [task]() {return task->complete;});
+    return;
+  }
+  if (task->done())
+    return;
+  // register only once this task has switched out, so the one it waits
+  // for cannot wake it while it is still running
+  suspend([this, task](Task* self) {
+      std::unique_lock<std::mutex> guard(task->lock);
+      if (task->complete) {
+        guard.unlock();
+        make_ready(self);
+      }
+      else
+        task->waiters.push_back(self);
+    });
+}
+
+
+inline void Scheduler::blocking(const std::function<void()>& fn)
+{
+  if (!current()) {
+    fn();
+    return;
+  }
+  std::exception_ptr error;
+  suspend([this, &fn, &error](Task* self) {
+      {
+        std::lock_guard<std::mutex> guard(io_lock);
+        io_queue.push_back({&fn, &error, self});
+      }
+      io_ready.notify_one();
+    });
+  if (error)
+    std::rethrow_exception(error);
+}
+
+
+inline void WaitQueue::wait(const std::function<bool()>& ready)
+{
+  // announce the wait before checking, so a notifier that changes the
+  // condition after the check is sure to see a waiter
+  ++waiting;
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  Task* self = Scheduler::current();
+  while (!ready()) {
+    if (!self) {
+      std::unique_lock<std::mutex> guard(lock);
+      changed.wait(guard, ready);
+      break;
+    }
+    // register only once switched out (see Scheduler::await)
+    Scheduler::global().suspend([this, &ready](Task* task) {
+        std::unique_lock<std::mutex> guard(lock);
+        if (ready()) {
+          guard.unlock();
+          Scheduler::global().make_ready(task);
+        }
+        else
+          tasks.push_back(task);
+      });
+  }
+  --waiting;
+}
+
+
+inline void WaitQueue::notify_all()
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting.load() == 0)
+    return;
+  std::vector<Task*> woken;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    woken.swap(tasks);
+    changed.notify_all();
+  }
+  for (Task* task : woken)
+    Scheduler::global().make_ready(task);
+}
+
+
+inline void Scheduler::finish(Task* task)
+{
+  munmap(task->stack, task->stack_size);
+  task->stack = nullptr;
+  std::vector<Task*> waiters;
+  {
+    // the owner may delete the task as soon as this lock is released
+    std::lock_guard<std::mutex> guard(task->lock);
+    task->complete = true;
+    waiters.swap(task->waiters);
+    task->finished.notify_all();
+  }
+  for (Task* t : waiters)
+    make_ready(t);
+}
+
+
+inline void Scheduler::run()
+{
+  Worker self;
+  this_worker() = &self;
+  while (true) {
+    Task* task;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      ready.wait(guard, [this]() {return !run_queue.empty();});
+      task = run_queue.front();
+      run_queue.pop_front();
+    }
+    // switch to the task with its exception state in place
+    self.current = task;
+    eh_globals() = task->eh;
+    swapcontext(&self.context, &task->context);
+    task->eh = eh_globals();
+    eh_globals() = Task::EhState();
+    self.current = nullptr;
+
+    if (task->exited)
+      finish(task);
+    else if (self.park) {
+      std::function<void(Task*)> park;
+      park.swap(self.park);
+      park(task);
+    }
+  }
+}
+
+
+inline void Scheduler::run_io()
+{
+  while (true) {
+    BlockingCall call;
+    {
+      std::unique_lock<std::mutex> guard(io_lock);
+      io_ready.wait(guard, [this]() {return !io_queue.empty();});
+      call = io_queue.front();
+      io_queue.pop_front();
+    }
+    try {
+      (*call.fn)();
+    }
+    catch (...) {
+      *call.error = std::current_exception();
+    }
+    make_ready(call.task);
+  }
+}
+
+#endif
@@ -10,9 +10,11 @@
 #define SYMBOL_TABLE_H
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <list>
 #include "data_object.h"
+#include "runtime_stats.h"
 
 // string->string map to store type information for user-defined types
 typedef std::map<std::string,std::string> StringMap;
@@ -51,6 +53,14 @@ public:
   // check if name exists in given environment
   bool name_exists_in_env(const std::string& name, int env_id) const;
 
+  // check if the name visible from the current environment is declared
+  // in the given environment or one nested within it
+  bool name_exists_since(const std::string& name, int env_id) const;
+
+  // get the identifier of the environment the name visible from the
+  // current environment is declared in (-1 if it isn't visible there)
+  int get_environment_id(const std::string& name) const;
+
   // set the name's symbol-table info (as a string)
   void set_str_info(const std::string& name, const std::string& info);
 
@@ -86,6 +96,19 @@ public:
 
   // get the name's symbol-table info (if stored as a map)
   void get_vec_info(const std::string& name, StringVec& info) const;
+
+  // get a pointer to the name's data-object info (nullptr if none);
+  // the pointer stays valid until the name's environment is popped
+  DataObject* get_val_slot(const std::string& name);
+
+  // look up names that are in none of this table's environments in the
+  // global (outermost) environment of globals, seeing only the first
+  // visible names added to it; globals must not change while in use,
+  // and its names can be read but not set through this table
+  void set_globals(const SymbolTable* globals, size_t visible);
+
+  // the number of names added to the global environment so far
+  size_t global_count() const {return global_order.size();}
   
   // give a string representation for printing/testing
   std::string to_string() const;
@@ -134,6 +157,17 @@ private:
   // holds the current environment identifier
   int current_environment_id = 0;
 
+  // the order names were added to the global environment in
+  std::unordered_map<std::string,size_t> global_order;
+
+  // a shared table to fall back on (see set_globals)
+  const SymbolTable* globals = nullptr;
+  size_t visible_globals = 0;
+
+  // the name's info in the nearest environment holding it, or in the
+  // globals; false if the name isn't visible
+  bool find_info(const std::string& name, SymTableObject*& obj) const;
+
   // gets the current environment index 
   int curr_env_index() const;
 
@@ -151,10 +185,10 @@ private:
 // BASIC SYMBOL TABLE OPERATIONS
 //----------------------------------------------------------------------
 
-SymbolTable::~SymbolTable()
+inline SymbolTable::~SymbolTable()
 {
-  for (std::pair<int,Environment> p1 : environments) {
-    for (std::pair<std::string,SymTableObject*> p2 : p1.second)
+  for (std::pair<int,Environment>& p1 : environments) {
+    for (std::pair<const std::string,SymTableObject*>& p2 : p1.second)
       delete_sym_obj(p2.second);
     p1.second.clear();
   }
@@ -162,8 +196,9 @@ SymbolTable::~SymbolTable()
 }
 
 
-void SymbolTable::push_environment()
+inline void SymbolTable::push_environment()
 {
+  ++RuntimeStats::local().env_pushes;
   std::pair<int,Environment> env_entry;
   env_entry.first = environment_count++;
   auto it = environments.begin();
@@ -176,8 +211,9 @@ void SymbolTable::push_environment()
 }
 
 
-void SymbolTable::pop_environment()
+inline void SymbolTable::pop_environment()
 {
+  ++RuntimeStats::local().env_pops;
   if (environments.size() == 0)
     return;
   int index = curr_env_index();
@@ -193,39 +229,54 @@ void SymbolTable::pop_environment()
 }
 
 
-int SymbolTable::get_environment_id()
+inline int SymbolTable::get_environment_id()
 {
   return current_environment_id;
 }
 
 
-void SymbolTable::set_environment_id(int env_id)
+inline void SymbolTable::set_environment_id(int env_id)
 {
   current_environment_id = env_id;
 }
 
   
-void SymbolTable::add_name(const std::string& name)
+inline void SymbolTable::add_name(const std::string& name)
 {
   if (environments.size() == 0)
     return;
-  environments[curr_env_index()].second[name] = nullptr;
+  int index = curr_env_index();
+  if (index == 0 and !global_order.count(name)) {
+    size_t order = global_order.size();
+    global_order[name] = order;
+  }
+  Environment& env = environments[index].second;
+  // re-adding a name (e.g., a declaration in a loop body) drops its info
+  auto it = env.find(name);
+  if (it != env.end())
+    delete_sym_obj(it->second);
+  env[name] = nullptr;
 }
 
 
-bool SymbolTable::name_exists(const std::string& name) const
+inline bool SymbolTable::name_exists(const std::string& name) const
 {
-  if (environments.size() == 0)
-    return false;
-  int index = 0;
-  return get_env_for_name(name, index);
+  SymTableObject* obj;
+  return find_info(name, obj);
+}
+
+
+inline void SymbolTable::set_globals(const SymbolTable* table, size_t visible)
+{
+  globals = table;
+  visible_globals = visible;
 }
 
 //----------------------------------------------------------------------
 // SET FUNCTIONS
 //----------------------------------------------------------------------
 
-void SymbolTable::set_str_info(const std::string& name, const std::string& info)
+inline void SymbolTable::set_str_info(const std::string& name, const std::string& info)
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -238,20 +289,26 @@ void SymbolTable::set_str_info(const std::string& name, const std::string& info)
 }
 
 
-void SymbolTable::set_val_info(const std::string& name, const DataObject& info)
+inline void SymbolTable::set_val_info(const std::string& name, const DataObject& info)
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
+    SymTableObject* curr = environments[index].second[name];
+    // update in place so val slots handed out stay valid
+    if (curr and curr->type() == VAL) {
+      ((ValObject*)curr)->obj_val = info;
+      return;
+    }
     ValObject* obj = new ValObject;
     obj->obj_val = info;
-    if (environments[index].second[name])
-      delete_sym_obj(environments[index].second[name]);
+    if (curr)
+      delete_sym_obj(curr);
     environments[index].second[name] = obj;
   }
 }
 
 
-void SymbolTable::set_vec_info(const std::string& name, const StringVec& info)
+inline void SymbolTable::set_vec_info(const std::string& name, const StringVec& info)
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -264,7 +321,7 @@ void SymbolTable::set_vec_info(const std::string& name, const StringVec& info)
 }
 
 
-void SymbolTable::set_map_info(const std::string& name, const StringMap& info)
+inline void SymbolTable::set_map_info(const std::string& name, const StringMap& info)
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
@@ -281,47 +338,31 @@ void SymbolTable::set_map_info(const std::string& name, const StringMap& info)
 // HAS FUNCTIONS
 //----------------------------------------------------------------------
 
-bool SymbolTable::has_str_info(const std::string& name) const
+inline bool SymbolTable::has_str_info(const std::string& name) const
 {
-  int index = -1;
-  if (get_env_for_name(name, index)) {
-    SymTableObject* obj = environments[index].second.at(name);
-    return obj and obj->type() == STR;
-  }
-  return false;
+  SymTableObject* obj;
+  return find_info(name, obj) and obj and obj->type() == STR;
 }
 
 
-bool SymbolTable::has_val_info(const std::string& name) const
+inline bool SymbolTable::has_val_info(const std::string& name) const
 {
-  int index = -1;
-  if (get_env_for_name(name, index)) {
-    SymTableObject* obj = environments[index].second.at(name);
-    return obj and obj->type() == VAL;
-  }
-  return false;
+  SymTableObject* obj;
+  return find_info(name, obj) and obj and obj->type() == VAL;
 }
   
 
-bool SymbolTable::has_vec_info(const std::string& name) const
+inline bool SymbolTable::has_vec_info(const std::string& name) const
 {
-  int index = -1;
-  if (get_env_for_name(name, index)) {
-    SymTableObject* obj = environments[index].second.at(name);
-    return obj and obj->type() == VEC;
-  }
-  return false;
+  SymTableObject* obj;
+  return find_info(name, obj) and obj and obj->type() == VEC;
 }
 
 
-bool SymbolTable::has_map_info(const std::string& name) const
+inline bool SymbolTable::has_map_info(const std::string& name) const
 {
-  int index = -1;
-  if (get_env_for_name(name, index)) {
-    SymTableObject* obj = environments[index].second.at(name);
-    return obj and obj->type() == MAP;
-  }
-  return false;
+  SymTableObject* obj;
+  return find_info(name, obj) and obj and obj->type() == MAP;
 }
 
 
@@ -329,47 +370,47 @@ bool SymbolTable::has_map_info(const std::string& name) const
 // GET FUNCTIONS
 //----------------------------------------------------------------------
 
-void SymbolTable::get_str_info(const std::string& name, std::string& info) const
+inline void SymbolTable::get_str_info(const std::string& name, std::string& info) const
 {
-  int index = -1;
-  if (get_env_for_name(name, index)) {
-    SymTableObject* obj = environments[index].second.at(name);
-    if (obj)
-      info = ((StrObject*)obj)->str_val;
-  }
+  SymTableObject* obj;
+  if (find_info(name, obj) and obj)
+    info = ((StrObject*)obj)->str_val;
 }
 
 
-void SymbolTable::get_val_info(const std::string& name, DataObject& info) const
+inline void SymbolTable::get_val_info(const std::string& name, DataObject& info) const
 {
-  int index = -1;
-  if (get_env_for_name(name, index)) {
-    SymTableObject* obj = environments[index].second.at(name);
-    if (obj) 
-      info = ((ValObject*)obj)->obj_val;
-  }
+  SymTableObject* obj;
+  if (find_info(name, obj) and obj)
+    info = ((ValObject*)obj)->obj_val;
 }
 
 
-void SymbolTable::get_vec_info(const std::string& name, StringVec& info) const
+inline void SymbolTable::get_vec_info(const std::string& name, StringVec& info) const
 {
-  int index = -1;
-  if (get_env_for_name(name, index)) {
-    SymTableObject* obj = environments[index].second.at(name);
-    if (obj)
-      info = ((VecObject*)obj)->vec_val;
-  }
+  SymTableObject* obj;
+  if (find_info(name, obj) and obj)
+    info = ((VecObject*)obj)->vec_val;
+}
+
+
+inline void SymbolTable::get_map_info(const std::string& name, StringMap& info) const
+{
+  SymTableObject* obj;
+  if (find_info(name, obj) and obj)
+    info = ((MapObject*)obj)->map_val;
 }
 
 
-void SymbolTable::get_map_info(const std::string& name, StringMap& info) const
+inline DataObject* SymbolTable::get_val_slot(const std::string& name)
 {
   int index = -1;
   if (get_env_for_name(name, index)) {
     SymTableObject* obj = environments[index].second.at(name);
-    if (obj)
-      info = ((MapObject*)obj)->map_val;
+    if (obj and obj->type() == VAL)
+      return &((ValObject*)obj)->obj_val;
   }
+  return nullptr;
 }
 
 
@@ -377,7 +418,7 @@ void SymbolTable::get_map_info(const std::string& name, StringMap& info) const
 // PRETTY PRINT ENVIRONMENTS
 //----------------------------------------------------------------------
 
-std::string SymbolTable::to_string() const
+inline std::string SymbolTable::to_string() const
 {
   std::string s = "";
   for (std::pair<int,Environment> env_entry : environments) {
@@ -426,7 +467,7 @@ std::string SymbolTable::to_string() const
 // HELPER FUNCTIONS
 //----------------------------------------------------------------------
 
-void SymbolTable::delete_sym_obj(SymTableObject* obj)
+inline void SymbolTable::delete_sym_obj(SymTableObject* obj)
 {
   if (!obj)
     return;
@@ -441,15 +482,15 @@ void SymbolTable::delete_sym_obj(SymTableObject* obj)
 }
 
 
-bool SymbolTable::name_exists_in_curr_env(const std::string& name) const
+inline bool SymbolTable::name_exists_in_curr_env(const std::string& name) const
 {
   return name_exists_in_env(name, current_environment_id);
 }
 
 
-bool SymbolTable::name_exists_in_env(const std::string& name, int env_id) const
+inline bool SymbolTable::name_exists_in_env(const std::string& name, int env_id) const
 {
-  for (std::pair<int,Environment> env_entry : environments) {
+  for (const std::pair<int,Environment>& env_entry : environments) {
     if (env_entry.first == env_id)
       return env_entry.second.count(name) > 0;
   }
@@ -457,10 +498,35 @@ bool SymbolTable::name_exists_in_env(const std::string& name, int env_id) const
 }
 
 
-bool SymbolTable::get_env_for_name(const std::string& name, int& index) const
+inline bool SymbolTable::name_exists_since(const std::string& name, int env_id) const
 {
+  int index;
+  if (!get_env_for_name(name, index))
+    return false;
+  for (int i = 0; i < environments.size(); ++i) {
+    if (environments[i].first == env_id)
+      return index >= i;
+  }
+  return false;
+}
+
+
+inline int SymbolTable::get_environment_id(const std::string& name) const
+{
+  int index;
+  if (!get_env_for_name(name, index))
+    return -1;
+  return environments[index].first;
+}
+
+
+inline bool SymbolTable::get_env_for_name(const std::string& name, int& index) const
+{
+  RuntimeCounters& stats = RuntimeStats::local();
+  ++stats.lookups;
   int curr_index = curr_env_index();
   for (size_t i = curr_index + 1; i > 0; --i) {
+    ++stats.lookup_depth;
     if (environments[i-1].second.count(name) > 0) {
       index = i - 1;
       return true;
@@ -469,8 +535,29 @@ bool SymbolTable::get_env_for_name(const std::string& name, int& index) const
   return false;
 }
 
-  
-int SymbolTable::curr_env_index() const
+
+inline bool SymbolTable::find_info(const std::string& name, SymTableObject*& obj) const
+{
+  int index;
+  if (environments.size() > 0 and get_env_for_name(name, index)) {
+    obj = environments[index].second.at(name);
+    return true;
+  }
+  if (!globals or globals->environments.size() == 0)
+    return false;
+  auto order = globals->global_order.find(name);
+  if (order == globals->global_order.end() or order->second >= visible_globals)
+    return false;
+  const Environment& env = globals->environments[0].second;
+  auto it = env.find(name);
+  if (it == env.end())
+    return false;
+  obj = it->second;
+  return true;
+}
+
+
+inline int SymbolTable::curr_env_index() const
 {
   for (int i = 0; i < environments.size(); ++i) {
     if (current_environment_id == environments[i].first)
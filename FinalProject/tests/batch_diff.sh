@@ -0,0 +1,68 @@
+#!/bin/bash
+#----------------------------------------------------------------------
+# Differential test for batch mode: runs every tests/*.mypl over a few
+# input files with --batch and compares each output file with the
+# output of running the program on that input by itself.
+#
+# usage: tests/batch_diff.sh [path/to/mypl]
+#----------------------------------------------------------------------
+
+MYPL=${1:-./mypl}
+TESTS=$(dirname "$0")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+status=0
+
+mkdir "$WORK/in" "$WORK/out"
+for n in 7 42 300; do
+  echo $n > "$WORK/in/input$n"
+done
+
+for f in "$TESTS"/*.mypl; do
+  rm -f "$WORK"/out/*
+  # front-end errors are reported once, on stderr, with no output files
+  front=$("$MYPL" --batch --threads=3 --out-dir="$WORK/out" "$f" "$WORK"/in/* 2>&1 >/dev/null \
+            | grep -v ": exit ")
+  ok=1
+  for input in "$WORK"/in/*; do
+    expected=$("$MYPL" "$f" < "$input" 2>/dev/null)
+    output="$WORK/out/$(basename "$input").out"
+    if [ -f "$output" ]; then
+      actual=$(cat "$output")
+    else
+      actual=$front
+    fi
+    if [ "$expected" != "$actual" ]; then
+      echo "FAIL $f ($(basename "$input"))"
+      diff <(echo "$expected") <(echo "$actual")
+      ok=0
+      status=1
+    fi
+  done
+  [ $ok -eq 1 ] && echo "ok   $f"
+done
+
+# inputs that would write the same output file are refused up front
+mkdir "$WORK/in2"
+echo 7 > "$WORK/in2/input7"
+rm -f "$WORK"/out/*
+if "$MYPL" --batch --out-dir="$WORK/out" "$TESTS/hello.mypl" "$WORK/in/input7" "$WORK/in2/input7" \
+     2>/dev/null || [ -n "$(ls "$WORK/out")" ]; then
+  echo "FAIL duplicate output files"
+  status=1
+else
+  echo "ok   duplicate output files"
+fi
+
+# so are inputs that are another input's output (as when a batch is run
+# again over in/*, next to the outputs of the last run)
+echo 7 > "$WORK/in2/input7.out"
+if "$MYPL" --batch "$TESTS/hello.mypl" "$WORK/in2"/* 2>/dev/null \
+     || [ "$(cat "$WORK/in2/input7.out")" != "7" ]; then
+  echo "FAIL input is an output file"
+  status=1
+else
+  echo "ok   input is an output file"
+fi
+
+exit $status
@@ -0,0 +1,45 @@
+#!/bin/bash
+#----------------------------------------------------------------------
+# Differential test for the C++ backend: runs every tests/*.mypl with
+# the interpreter and as a C++ program generated with --emit-cpp and
+# built with the system g++, and reports any difference in output or
+# exit code. Programs rejected by the front end are compared on the
+# error message alone; programs using features the backend does not
+# support are skipped.
+#
+# usage: tests/cpp_diff.sh [path/to/mypl]
+#----------------------------------------------------------------------
+
+MYPL=${1:-./mypl}
+TESTS=$(dirname "$0")
+RUNTIME=$(cd "$TESTS/.." && pwd)
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+status=0
+
+for f in "$TESTS"/*.mypl; do
+  expected=$(echo 7 | "$MYPL" "$f" 2>&1; echo "exit: $?")
+  front=$("$MYPL" --emit-cpp "$WORK/out.cpp" "$f" 2>&1)
+  front_status=$?
+  if [[ "$front" == *"not supported in generated C++"* ]]; then
+    echo "skip $f"
+    continue
+  elif [ $front_status -ne 0 ]; then
+    actual=$(echo "$front"; echo "exit: 1")
+  elif ! g++ -std=c++11 -I "$RUNTIME" -o "$WORK/out" "$WORK/out.cpp"; then
+    echo "FAIL $f (generated C++ does not compile)"
+    status=1
+    continue
+  else
+    actual=$(echo 7 | "$WORK/out" 2>&1; echo "exit: $?")
+  fi
+  if [ "$expected" == "$actual" ]; then
+    echo "ok   $f"
+  else
+    echo "FAIL $f"
+    diff <(echo "$expected") <(echo "$actual")
+    status=1
+  fi
+done
+
+exit $status
@@ -0,0 +1,35 @@
+#!/bin/bash
+#----------------------------------------------------------------------
+# Differential test for the fork server: starts mypl --fork-server on a
+# temporary socket with every tests/*.mypl loaded, runs each one through
+# mypl --fork-client, and compares the output and exit code with
+# running the program directly.
+#
+# usage: tests/fork_diff.sh [path/to/mypl]
+#----------------------------------------------------------------------
+
+MYPL=${1:-./mypl}
+TESTS=$(dirname "$0")
+WORK=$(mktemp -d)
+SOCKET="$WORK/mypl.sock"
+"$MYPL" --fork-server "$SOCKET" "$TESTS"/*.mypl 2>/dev/null &
+SERVER=$!
+trap 'kill $SERVER; rm -rf "$WORK"' EXIT
+while [ ! -S "$SOCKET" ]; do
+  sleep 0.1
+done
+status=0
+
+for f in "$TESTS"/*.mypl; do
+  expected=$(echo 7 | "$MYPL" "$f" 2>/dev/null; echo "exit: $?")
+  actual=$(echo 7 | "$MYPL" --fork-client "$SOCKET" "$f" 2>/dev/null; echo "exit: $?")
+  if [ "$expected" == "$actual" ]; then
+    echo "ok   $f"
+  else
+    echo "FAIL $f"
+    diff <(echo "$expected") <(echo "$actual")
+    status=1
+  fi
+done
+
+exit $status
@@ -0,0 +1,26 @@
+#!/bin/bash
+#----------------------------------------------------------------------
+# Differential test for the JIT tier: runs every tests/*.mypl with the
+# interpreter alone and with every function JIT-compiled on its first
+# call, and reports any difference in output or exit code.
+#
+# usage: tests/jit_diff.sh [path/to/mypl]
+#----------------------------------------------------------------------
+
+MYPL=${1:-./mypl}
+TESTS=$(dirname "$0")
+status=0
+
+for f in "$TESTS"/*.mypl; do
+  expected=$(echo 7 | "$MYPL" "$f" 2>&1; echo "exit: $?")
+  actual=$(echo 7 | "$MYPL" --jit-threshold=1 "$f" 2>&1; echo "exit: $?")
+  if [ "$expected" == "$actual" ]; then
+    echo "ok   $f"
+  else
+    echo "FAIL $f"
+    diff <(echo "$expected") <(echo "$actual")
+    status=1
+  fi
+done
+
+exit $status
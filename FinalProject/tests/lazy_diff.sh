@@ -0,0 +1,34 @@
+#!/bin/bash
+#----------------------------------------------------------------------
+# Differential test for lazy parsing: runs every tests/*.mypl eagerly,
+# with --lazy, and with --lazy --strict. Strict runs must match exactly;
+# lazy runs must match unless the eager run stops at a syntax or type
+# error, which lazy parsing reports only if the function is called.
+#
+# usage: tests/lazy_diff.sh [path/to/mypl]
+#----------------------------------------------------------------------
+
+MYPL=${1:-./mypl}
+TESTS=$(dirname "$0")
+status=0
+
+for f in "$TESTS"/*.mypl; do
+  expected=$(echo 7 | "$MYPL" "$f" 2>&1; echo "exit: $?")
+  strict=$(echo 7 | "$MYPL" --lazy --strict "$f" 2>&1; echo "exit: $?")
+  lazy=$(echo 7 | "$MYPL" --lazy --threads=3 "$f" 2>&1; echo "exit: $?")
+  if [ "$expected" != "$strict" ]; then
+    echo "FAIL $f (--strict)"
+    diff <(echo "$expected") <(echo "$strict")
+    status=1
+  elif [ "$expected" == "$lazy" ]; then
+    echo "ok   $f"
+  elif echo "$expected" | grep -q "^\(Parser\|Type\) Error"; then
+    echo "skip $f (front-end error)"
+  else
+    echo "FAIL $f"
+    diff <(echo "$expected") <(echo "$lazy")
+    status=1
+  fi
+done
+
+exit $status
@@ -0,0 +1,76 @@
+#!/bin/bash
+#----------------------------------------------------------------------
+# Differential test for the compile server: starts mypl --serve on a
+# temporary socket, runs every tests/*.mypl through mypl --client (twice,
+# so the second run uses the cached program), and compares the output
+# and exit code with running the program directly. Then checks that
+# the server survives a request whose frame is too long and clients
+# that never send a request (needs python3).
+#
+# usage: tests/serve_diff.sh [path/to/mypl]
+#----------------------------------------------------------------------
+
+MYPL=${1:-./mypl}
+TESTS=$(dirname "$0")
+WORK=$(mktemp -d)
+SOCKET="$WORK/mypl.sock"
+"$MYPL" --serve "$SOCKET" --threads=2 &
+SERVER=$!
+trap 'kill $SERVER; rm -rf "$WORK"' EXIT
+while [ ! -S "$SOCKET" ]; do
+  sleep 0.1
+done
+status=0
+
+for f in "$TESTS"/*.mypl; do
+  expected=$(echo 7 | "$MYPL" "$f" 2>/dev/null; echo "exit: $?")
+  for run in first cached; do
+    actual=$(echo 7 | "$MYPL" --client "$SOCKET" "$f" 2>/dev/null; echo "exit: $?")
+    if [ "$expected" != "$actual" ]; then
+      echo "FAIL $f ($run run)"
+      diff <(echo "$expected") <(echo "$actual")
+      status=1
+      continue 2
+    fi
+  done
+  echo "ok   $f"
+done
+
+# a 4 GB length prefix is refused (the connection is closed at once)
+# without stopping the server
+python3 -c 'import socket, sys
+s = socket.socket(socket.AF_UNIX)
+s.connect(sys.argv[1])
+s.settimeout(5)
+s.sendall(b"\xff\xff\xff\xff")
+sys.exit(s.recv(1) != b"")' "$SOCKET" 2>/dev/null
+refused=$?
+f="$TESTS/hello.mypl"
+expected=$("$MYPL" "$f" 2>/dev/null </dev/null; echo "exit: $?")
+actual=$("$MYPL" --client "$SOCKET" "$f" 2>/dev/null </dev/null; echo "exit: $?")
+if [ $refused == 0 ] && [ "$expected" == "$actual" ]; then
+  echo "ok   oversized frame"
+else
+  echo "FAIL oversized frame"
+  status=1
+fi
+
+# idle connections on both workers are dropped once the request timeout
+# passes, so a later client still gets through
+python3 -c 'import socket, sys, time
+idle = [socket.socket(socket.AF_UNIX) for i in range(2)]
+for s in idle:
+  s.connect(sys.argv[1])
+time.sleep(10)' "$SOCKET" &
+IDLE=$!
+sleep 0.5
+actual=$(timeout 8 "$MYPL" --client "$SOCKET" "$f" 2>/dev/null </dev/null; echo "exit: $?")
+kill $IDLE
+if [ "$expected" == "$actual" ]; then
+  echo "ok   idle clients"
+else
+  echo "FAIL idle clients"
+  status=1
+fi
+
+exit $status
@@ -0,0 +1,32 @@
+#!/bin/bash
+#----------------------------------------------------------------------
+# Differential test for event tracing: runs every tests/*.mypl with and
+# without --trace (on several threads, so parallel for loops and tasks
+# trace from worker interpreters), compares the output and exit code,
+# and checks that each trace is a JSON document (needs python3).
+#
+# usage: tests/trace_diff.sh [path/to/mypl]
+#----------------------------------------------------------------------
+
+MYPL=${1:-./mypl}
+TESTS=$(dirname "$0")
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+status=0
+
+for f in "$TESTS"/*.mypl; do
+  expected=$(echo 7 | "$MYPL" --threads=4 "$f" 2>&1; echo "exit: $?")
+  actual=$(echo 7 | "$MYPL" --threads=4 --trace="$WORK/trace.json" "$f" 2>&1; echo "exit: $?")
+  if [ "$expected" != "$actual" ]; then
+    echo "FAIL $f"
+    diff <(echo "$expected") <(echo "$actual")
+    status=1
+  elif ! python3 -c 'import json, sys; json.load(open(sys.argv[1]))' "$WORK/trace.json"; then
+    echo "FAIL $f (trace is not JSON)"
+    status=1
+  else
+    echo "ok   $f"
+  fi
+done
+
+exit $status
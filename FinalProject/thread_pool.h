@@ -0,0 +1,218 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: thread_pool.h
+// DATE: Spring 2021
+// DESC: Work-stealing thread pool used by parallel for loops. A range
+//       of iterations is cut into chunks that are dealt out to the
+//       workers' queues; each worker runs chunks from the back of its
+//       own queue and, once that is empty, steals chunks from the front
+//       of the others', so uneven iterations still keep every worker
+//       busy. The calling thread waits until all chunks have run.
+//----------------------------------------------------------------------
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class ThreadPool
+{
+public:
+
+  // runs the iterations [lo, hi] on the given worker (0 to size()-1);
+  // must not throw
+  typedef std::function<void(int worker, long lo, long hi)> RangeFn;
+
+  // start the given number of workers (0 for one per available core)
+  explicit ThreadPool(int threads = 0);
+
+  // finish the current job and stop the workers
+  ~ThreadPool();
+
+  // the number of workers
+  int size() const {return (int)workers.size();}
+
+  // run fn over [first, last] in chunks of about grain iterations (0
+  // picks a grain that gives each worker several chunks) and wait for
+  // all of them to finish; only one job runs at a time
+  void parallel_for(long first, long last, long grain, const RangeFn& fn);
+
+  // the process-wide pool, created on first use
+  static ThreadPool& global();
+
+  // the number of workers for the global pool (before its first use)
+  static void set_global_size(int threads);
+
+  // chunks taken from another worker's queue since the pool started
+  size_t steals() const {return steal_count.load();}
+
+private:
+
+  struct Chunk
+  {
+    const RangeFn* fn;
+    long lo;
+    long hi;
+  };
+
+  struct Queue
+  {
+    std::mutex lock;
+    std::deque<Chunk> chunks;
+  };
+
+  std::vector<std::thread> workers;
+  std::vector<Queue*> queues;
+
+  // job start and completion
+  std::mutex lock;
+  std::condition_variable work_ready;
+  std::condition_variable work_done;
+  size_t job = 0;                       // incremented for each job
+  size_t pending = 0;                   // chunks not yet finished
+  bool stopping = false;
+  std::mutex job_lock;                  // one job at a time
+  std::atomic<size_t> steal_count;
+
+  // the size set for the global pool (0 until set)
+  static int& global_size();
+
+  void run(int id);
+  bool take(int id, Chunk& chunk);
+};
+
+
+inline int& ThreadPool::global_size()
+{
+  static int size = 0;
+  return size;
+}
+
+
+inline ThreadPool::ThreadPool(int threads) : steal_count(0)
+{
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 0; i < threads; ++i)
+    queues.push_back(new Queue);
+  for (int i = 0; i < threads; ++i)
+    workers.push_back(std::thread(&ThreadPool::run, this, i));
+}
+
+
+inline ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  work_ready.notify_all();
+  for (std::thread& t : workers)
+    t.join();
+  for (Queue* q : queues)
+    delete q;
+}
+
+
+inline ThreadPool& ThreadPool::global()
+{
+  static ThreadPool pool(global_size());
+  return pool;
+}
+
+
+inline void ThreadPool::set_global_size(int threads)
+{
+  global_size() = threads;
+}
+
+
+inline void ThreadPool::parallel_for(long first, long last, long grain, const RangeFn& fn)
+{
+  if (last < first)
+    return;
+  std::lock_guard<std::mutex> one_job(job_lock);
+  long count = last - first + 1;
+  if (grain <= 0)
+    grain = std::max(1L, count / (8L * size()));
+
+  // count the chunks first: workers still finishing the previous job
+  // may pick up new chunks as soon as they are queued
+  size_t chunks = (count + grain - 1) / grain;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    pending = chunks;
+  }
+  // deal the chunks out round-robin
+  for (size_t i = 0; i < chunks; ++i) {
+    long lo = first + (long)i * grain;
+    long hi = std::min(last, lo + grain - 1);
+    Queue* q = queues[i % queues.size()];
+    std::lock_guard<std::mutex> guard(q->lock);
+    q->chunks.push_back({&fn, lo, hi});
+  }
+
+  std::unique_lock<std::mutex> guard(lock);
+  ++job;
+  work_ready.notify_all();
+  work_done.wait(guard, [this]() {return pending == 0;});
+}
+
+
+inline bool ThreadPool::take(int id, Chunk& chunk)
+{
+  // newest chunk from our own queue
+  {
+    Queue* q = queues[id];
+    std::lock_guard<std::mutex> guard(q->lock);
+    if (!q->chunks.empty()) {
+      chunk = q->chunks.back();
+      q->chunks.pop_back();
+      return true;
+    }
+  }
+  // oldest chunk from another worker's queue
+  for (size_t i = 1; i < queues.size(); ++i) {
+    Queue* q = queues[(id + i) % queues.size()];
+    std::lock_guard<std::mutex> guard(q->lock);
+    if (!q->chunks.empty()) {
+      chunk = q->chunks.front();
+      q->chunks.pop_front();
+      ++steal_count;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+inline void ThreadPool::run(int id)
+{
+  size_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      work_ready.wait(guard, [&]() {return stopping or job != seen;});
+      if (stopping)
+        return;
+      seen = job;
+    }
+    Chunk chunk;
+    while (take(id, chunk)) {
+      (*chunk.fn)(id, chunk.lo, chunk.hi);
+      std::lock_guard<std::mutex> guard(lock);
+      if (--pending == 0)
+        work_done.notify_all();
+    }
+  }
+}
+
+#endif
@@ -24,6 +24,7 @@ enum TokenType {
   EQUAL, GREATER, GREATER_EQUAL, LESS, LESS_EQUAL, NOT_EQUAL,
   // reserved words
   TYPE, WHILE, FOR, TO, DO, IF, THEN, ELSEIF, ELSE, END, FUN, VAR, RETURN, NEW, TRY, THROW, CATCH,
+  PARALLEL, REDUCE, SPAWN, CHANNEL,
   // primitive types
   BOOL_TYPE, INT_TYPE, DOUBLE_TYPE, CHAR_TYPE, STRING_TYPE,
   // values
@@ -72,8 +73,15 @@ private:
   // the column location of the start of the lexeme (starts at 1)
   int token_column;
 
-  // token type to string representation (for printing)
-  std::map<TokenType,std::string> token_type_map =
+  // token type to string representation (for printing), shared by
+  // all tokens
+  static const std::map<TokenType,std::string>& token_type_map();
+};
+
+
+inline const std::map<TokenType,std::string>& Token::token_type_map()
+{
+  static const std::map<TokenType,std::string> names =
     { // basic symbols
       {ASSIGN, "ASSIGN"}, {COMMA, "COMMA"}, {DOT, "DOT"},
       {LPAREN, "LPAREN"}, {RPAREN, "RPAREN"}, {COLON, "COLON"},
@@ -92,7 +100,8 @@ private:
       {DO, "DO"}, {IF, "IF"}, {THEN, "THEN"}, {ELSEIF, "ELSEIF"},
       {ELSE, "ELSE"}, {END, "END"}, {FUN, "FUN"}, {VAR, "VAR"},
       {RETURN, "RETURN"}, {NEW, "NEW"}, {TRY, "TRY"}, {CATCH, "CATCH"},
-      {THROW,"THROW"},
+      {THROW,"THROW"}, {PARALLEL, "PARALLEL"}, {REDUCE, "REDUCE"},
+      {SPAWN, "SPAWN"}, {CHANNEL, "CHANNEL"},
       // primitive types
       {BOOL_TYPE, "BOOL_TYPE"}, {INT_TYPE, "INT_TYPE"},
       {DOUBLE_TYPE, "DOUBLE_TYPE"}, {CHAR_TYPE, "CHAR_TYPE"},
@@ -104,48 +113,49 @@ private:
       // eos
       {EOS, "EOS"}
     };
-  };
+  return names;
+}
 
-Token::Token()
+inline Token::Token()
   : token_type(EOS), token_lexeme(""), token_line(0), token_column(0)
 {
 }
 
 
-Token::Token(TokenType type, const std::string& lexeme, int line, int column)
+inline Token::Token(TokenType type, const std::string& lexeme, int line, int column)
   : token_type(type), token_lexeme(lexeme), token_line(line),
     token_column(column)
 {
 }
 
 
-TokenType Token::type() const
+inline TokenType Token::type() const
 {
   return token_type;
 }
 
 
-std::string Token::lexeme() const
+inline std::string Token::lexeme() const
 {
   return token_lexeme;
 }
 
 
-int Token::line() const
+inline int Token::line() const
 {
   return token_line;
 }
 
 
-int Token::column() const
+inline int Token::column() const
 {
   return token_column;
 }
 
 
-std::string Token::to_string() const
+inline std::string Token::to_string() const
 {
-  return token_type_map.find(token_type)->second +
+  return token_type_map().find(token_type)->second +
     " '" + lexeme() + "' " +
     std::to_string(line()) + ":" + std::to_string(column());
 }
@@ -0,0 +1,173 @@
+//----------------------------------------------------------------------
+// NAME: Zac Foteff
+// FILE: tracer.h
+// DATE: Spring 2021
+// DESC: Event tracer producing Chrome trace-event JSON (--trace=FILE),
+//       viewable in Perfetto or chrome://tracing. Front-end phases and
+//       user function calls are recorded as complete ("X") events and
+//       heap allocations as instant ("i") events. Events go into a
+//       ring buffer allocated up front; writers claim a slot with one
+//       atomic increment, and once the buffer wraps the oldest events
+//       are overwritten. The buffer is serialized when tracing ends.
+//----------------------------------------------------------------------
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+
+
+class Tracer
+{
+public:
+
+  typedef std::chrono::steady_clock Clock;
+
+  // records a complete event covering the scope's lifetime (does
+  // nothing if the tracer is null)
+  class Span
+  {
+  public:
+    Span(Tracer* t, const char* name, const char* category)
+      : tracer(t), name(name), category(category)
+    {
+      if (tracer)
+        start = Clock::now();
+    }
+    ~Span()
+    {
+      if (tracer)
+        tracer->complete(name, category, start, Clock::now());
+    }
+  private:
+    Tracer* tracer;
+    const char* name;
+    const char* category;
+    Clock::time_point start;
+  };
+
+  // preallocate room for the given number of events
+  Tracer(size_t capacity = 1 << 20);
+  ~Tracer();
+
+  // record an event that ran from start to end (names must be string
+  // literals or otherwise outlive the tracer)
+  void complete(const char* name, const char* category,
+                Clock::time_point start, Clock::time_point end);
+
+  // record a point event with an optional string argument
+  void instant(const char* name, const char* category, const char* arg = nullptr);
+
+  // write the recorded events as a trace-event JSON document
+  void write(std::ostream& out) const;
+
+private:
+
+  struct Event
+  {
+    const char* name;
+    const char* category;
+    const char* arg;
+    char phase;
+    int tid;
+    int64_t ts_ns;
+    int64_t dur_ns;
+  };
+
+  Event* events;
+  size_t capacity;
+  std::atomic<size_t> next;
+  Clock::time_point epoch;
+
+  // a small id for the calling thread
+  static int thread_id();
+
+  // claim the next slot in the ring
+  Event& slot() {return events[next.fetch_add(1, std::memory_order_relaxed) % capacity];}
+
+  int64_t since_epoch(Clock::time_point t) const
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t - epoch).count();
+  }
+};
+
+
+inline Tracer::Tracer(size_t capacity)
+  : events(new Event[capacity]), capacity(capacity), next(0),
+    epoch(Clock::now())
+{
+}
+
+
+inline Tracer::~Tracer()
+{
+  delete [] events;
+}
+
+
+inline int Tracer::thread_id()
+{
+  static std::atomic<int> next_id(1);
+  thread_local int id = next_id++;
+  return id;
+}
+
+
+inline void Tracer::complete(const char* name, const char* category,
+                      Clock::time_point start, Clock::time_point end)
+{
+  Event& e = slot();
+  e.name = name;
+  e.category = category;
+  e.arg = nullptr;
+  e.phase = 'X';
+  e.tid = thread_id();
+  e.ts_ns = since_epoch(start);
+  e.dur_ns = since_epoch(end) - e.ts_ns;
+}
+
+
+inline void Tracer::instant(const char* name, const char* category, const char* arg)
+{
+  Event& e = slot();
+  e.name = name;
+  e.category = category;
+  e.arg = arg;
+  e.phase = 'i';
+  e.tid = thread_id();
+  e.ts_ns = since_epoch(Clock::now());
+  e.dur_ns = 0;
+}
+
+
+inline void Tracer::write(std::ostream& out) const
+{
+  size_t count = next.load();
+  size_t first = count > capacity ? count - capacity : 0;
+  char buf[128];
+  out << "{\"traceEvents\": [";
+  for (size_t i = first; i < count; ++i) {
+    const Event& e = events[i % capacity];
+    out << (i > first ? ",\n" : "\n") << "{\"name\": \"" << e.name
+        << "\", \"cat\": \"" << e.category << "\", \"ph\": \"" << e.phase << "\"";
+    snprintf(buf, sizeof(buf), ", \"ts\": %.3f, \"pid\": 1, \"tid\": %d",
+             e.ts_ns / 1000.0, e.tid);
+    out << buf;
+    if (e.phase == 'X') {
+      snprintf(buf, sizeof(buf), ", \"dur\": %.3f", e.dur_ns / 1000.0);
+      out << buf;
+    }
+    else
+      out << ", \"s\": \"t\"";
+    if (e.arg)
+      out << ", \"args\": {\"type\": \"" << e.arg << "\"}";
+    out << "}";
+  }
+  out << "\n], \"otherData\": {\"dropped_events\": " << first << "}}\n";
+}
+
+#endif
@@ -11,14 +11,30 @@
 #define TYPE_CHECKER_H
 
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
 #include "ast.h"
 #include "symbol_table.h"
+#include "channel_analysis.h"
 #include "mypl_exception.h"
+#include "thread_pool.h"
 
 
 class TypeChecker : public Visitor
 {
 public:
+  // check function bodies in parallel on the pool (see check_parallel)
+  void enable_parallel(ThreadPool& thread_pool) {pool = &thread_pool;}
+
+  // check the body of a function that was skimmed when the program was
+  // checked, once it has been parsed (see lazy_bodies.h), seeing the
+  // names it would have seen then; calls for different functions may
+  // run at the same time
+  void check_deferred(FunDecl& node);
+
   // top-level
   void visit(Program& node);
   void visit(FunDecl& node);
@@ -36,6 +52,7 @@ public:
   void visit(ThrowStmt& node);
   // expressions
   void visit(Expr& node);
+  void visit(QuickExpr& node);
   void visit(SimpleTerm& node);
   void visit(ComplexTerm& node);
   // rvalues
@@ -48,10 +65,92 @@ public:
 private:
   // the symbol table
   SymbolTable sym_table;
+  // the pool function bodies are checked on (if parallel)
+  ThreadPool* pool = nullptr;
   // the previously inferred type
   std::string curr_type;
   // helper to add built in functions
   void initialize_built_in_types();
+  // the names of the built in functions
+  std::set<std::string> built_ins;
+  // built in functions over tasks and channels, typed in visit(CallExpr&)
+  const std::set<std::string> generic_built_ins =
+    {"await", "send", "recv", "try_recv", "close"};
+
+  // how each function uses its channel parameters
+  ChannelAnalysis::Roles channel_roles;
+  std::mutex channel_lock;
+
+  // the skimmed functions, with the number of global names visible to
+  // their bodies; the global environment is kept for them
+  std::unordered_map<FunDecl*, size_t> deferred;
+
+  // true for channel<T> where T is a primitive type, a declared type,
+  // or a channel type
+  bool is_channel_type(const std::string& type);
+
+  // check a call to a generic built in and set curr_type
+  void generic_call(CallExpr& node);
+
+  // the parts of visit(FunDecl&): add the function's name and type to
+  // the current environment, check its body, and pick the channel
+  // implementations it uses (given the functions declared before it)
+  void check_signature(FunDecl& node);
+  void check_body(FunDecl& node);
+  void check_channels(FunDecl& node);
+
+  // check the declarations with the function bodies on the pool: first
+  // every type and function signature in order, then each body on a
+  // worker's own checker that sees the global environment as it was
+  // after the function's signature (so the same names are visible as
+  // when checking in order); the first error in declaration order is
+  // reported
+  void check_parallel(Program& node);
+
+  // a parallel for whose body is being checked
+  struct ParallelLoop
+  {
+    ForStmt* node;
+    int env_id;                         // the loop variable's environment
+    int body_env_id;                    // the body's environment
+    std::set<std::string> captures;     // enclosing variables read
+  };
+  // the parallel loops enclosing the current statement (innermost last)
+  std::list<ParallelLoop> parallel_loops;
+
+  // record a read of the variable in each enclosing parallel loop it
+  // is declared outside of
+  void note_read(const std::string& name);
+
+  // check that a parallel loop body may assign the variable
+  void check_parallel_assign(const Token& id);
+
+  // check that a parallel loop body may assign through the path's head
+  void check_parallel_path(const Token& id);
+
+  // variables declared in the parallel loop bodies being checked that
+  // only reach objects made by the current iteration, as (name,
+  // environment) pairs, and those of them the body has written through
+  // or passed on (so they must keep holding such objects)
+  std::set<std::pair<std::string,int>> loop_objects;
+  std::set<std::pair<std::string,int>> used_loop_objects;
+
+  // true for the types whose values can reach objects (user-defined
+  // types, channels, and task handles)
+  bool holds_objects(const std::string& type);
+
+  // true if the expression's value is nil, a new object, or read
+  // through a variable in loop_objects (which is then marked used)
+  bool loop_object(Expr& expr);
+
+  // check an assignment of an object value in a parallel loop body and
+  // track whether a variable assigned to only reaches the iteration's
+  // own objects
+  void check_parallel_store(const std::list<Token>& lvals, Expr& expr);
+
+  // check an argument of a type that holds objects passed to a call in
+  // a parallel loop body
+  void check_parallel_arg(CallExpr& node, Expr& arg);
 
   // error message
   void error(const std::string& msg, const Token& token);
@@ -60,19 +159,155 @@ private:
 };
 
 
-void TypeChecker::error(const std::string& msg, const Token& token)
+inline void TypeChecker::error(const std::string& msg, const Token& token)
 {
   throw MyPLException(SEMANTIC, msg, token.line(), token.column());
 }
 
 
-void TypeChecker::error(const std::string& msg)
+inline void TypeChecker::error(const std::string& msg)
 {
   throw MyPLException(SEMANTIC, msg);
 }
 
 
-void TypeChecker::initialize_built_in_types()
+inline void TypeChecker::note_read(const std::string& name)
+{
+  for (ParallelLoop& loop : parallel_loops)
+  {
+    bool reduced = false;
+    for (const ForStmt::Reduction& r : loop.node->reductions)
+      if (r.var_id.lexeme() == name)
+        reduced = true;
+    if (!reduced && !sym_table.name_exists_since(name, loop.env_id))
+      loop.captures.insert(name);
+  }
+}
+
+
+inline void TypeChecker::check_parallel_assign(const Token& id)
+{
+  //  Iterations may run at the same time, so they can only write their
+  //  own variables and the loop's reductions
+  for (ParallelLoop& loop : parallel_loops)
+  {
+    //  The loop variable is the one in the loop's own environment
+    if (sym_table.name_exists_since(id.lexeme(), loop.env_id)
+        && !sym_table.name_exists_since(id.lexeme(), loop.body_env_id))
+      error("ForStmt Error| Parallel for body assigns its loop variable: ", id);
+    bool reduced = false;
+    for (const ForStmt::Reduction& r : loop.node->reductions)
+      if (r.var_id.lexeme() == id.lexeme())
+        reduced = true;
+    if (!reduced && !sym_table.name_exists_since(id.lexeme(), loop.env_id))
+      error("ForStmt Error| Parallel for body assigns a variable from an enclosing scope"
+            " (declare it as a reduction): ", id);
+  }
+}
+
+
+inline void TypeChecker::check_parallel_path(const Token& id)
+{
+  //  An object from an enclosing scope is shared by all the iterations,
+  //  so they can only write fields of objects they made themselves
+  for (ParallelLoop& loop : parallel_loops)
+    if (!sym_table.name_exists_since(id.lexeme(), loop.env_id))
+      error("ForStmt Error| Parallel for body assigns a field of a variable from an"
+            " enclosing scope: ", id);
+  //  A body variable may still hold (an alias of) a shared object
+  std::pair<std::string,int> key(id.lexeme(), sym_table.get_environment_id(id.lexeme()));
+  if (!loop_objects.count(key))
+    error("ForStmt Error| Parallel for body assigns a field of an object it may not"
+          " have made (only objects made by new in the body can be written): ", id);
+  used_loop_objects.insert(key);
+}
+
+
+inline bool TypeChecker::holds_objects(const std::string& type)
+{
+  return sym_table.has_map_info(type) || type.find("channel<") == 0
+    || type.find("task<") == 0;
+}
+
+
+inline bool TypeChecker::loop_object(Expr& expr)
+{
+  if (expr.negated || expr.op)
+    return false;
+  if (ComplexTerm* c = dynamic_cast<ComplexTerm*>(expr.first))
+    return loop_object(*c->expr);
+  SimpleTerm* t = dynamic_cast<SimpleTerm*>(expr.first);
+  if (!t)
+    return false;
+  if (SimpleRValue* v = dynamic_cast<SimpleRValue*>(t->rvalue))
+    return v->value.type() == NIL;
+  if (NewRValue* n = dynamic_cast<NewRValue*>(t->rvalue))
+    return sym_table.has_map_info(n->type_id.lexeme());
+  //  Fields of such objects only ever hold such objects (see
+  //  check_parallel_store), so the whole path can be followed
+  IDRValue* id = dynamic_cast<IDRValue*>(t->rvalue);
+  if (!id)
+    return false;
+  std::string name = id->path.front().lexeme();
+  std::pair<std::string,int> key(name, sym_table.get_environment_id(name));
+  if (!loop_objects.count(key))
+    return false;
+  used_loop_objects.insert(key);
+  return true;
+}
+
+
+inline void TypeChecker::check_parallel_store(const std::list<Token>& lvals, Expr& expr)
+{
+  bool made = loop_object(expr);
+  if (lvals.size() > 1)
+  {
+    if (!made)
+      error("ForStmt Error| Parallel for body stores an object it may not have made in"
+            " a field: ", lvals.back());
+    return;
+  }
+  //  Writes through the variable (or its aliases) were only allowed
+  //  for the objects it held before, which may be read again when the
+  //  statements repeat (e.g., in a while loop)
+  const Token& id = lvals.front();
+  std::pair<std::string,int> key(id.lexeme(), sym_table.get_environment_id(id.lexeme()));
+  if (made)
+    loop_objects.insert(key);
+  else if (used_loop_objects.count(key))
+    error("ForStmt Error| Parallel for body assigns an object it may not have made to a"
+          " variable it writes objects through: ", id);
+  else
+    loop_objects.erase(key);
+}
+
+
+inline void TypeChecker::check_parallel_arg(CallExpr& node, Expr& arg)
+{
+  //  A task runs alongside the iteration, and a function can only reach
+  //  the objects it is given, so only the iteration's own objects can
+  //  be passed (and only to a function called in the iteration)
+  std::string fun_name = node.function_id.lexeme();
+  if (node.spawn || fun_name == "send")
+    error("ForStmt Error| Parallel for body shares an object with another task: ",
+          node.function_id);
+  if (!loop_object(arg))
+    error("ForStmt Error| Parallel for body passes an object it may not have made to"
+          " a function: ", node.function_id);
+}
+
+
+inline bool TypeChecker::is_channel_type(const std::string& type)
+{
+  if (type.find("channel<") != 0 || type.back() != '>')
+    return false;
+  std::string elem = type.substr(8, type.length() - 9);
+  return elem == "int" || elem == "double" || elem == "char" || elem == "string"
+    || elem == "bool" || sym_table.has_map_info(elem) || is_channel_type(elem);
+}
+
+
+inline void TypeChecker::initialize_built_in_types()
 {
   // print function
   sym_table.add_name("print");
@@ -105,6 +340,8 @@ void TypeChecker::initialize_built_in_types()
   //  length
   sym_table.add_name("length");
   sym_table.set_vec_info("length", StringVec {"string", "int"});
+
+  built_ins = {"print", "read", "stoi", "itos", "stod", "dtos", "get", "length"};
 }
 
 
@@ -112,15 +349,18 @@ void TypeChecker::initialize_built_in_types()
       Top Level Visitors
 ---------------------------------*/
 
-void TypeChecker::visit(Program& node)
+inline void TypeChecker::visit(Program& node)
 {
   // push the global environment
   sym_table.push_environment();
   // add built-in functions
   initialize_built_in_types();
 
-  for (Decl* d : node.decls)
-    d->accept(*this);
+  if (pool)
+    check_parallel(node);
+  else
+    for (Decl* d : node.decls)
+      d->accept(*this);
 
   // check for a main function
   if (sym_table.name_exists("main") and sym_table.has_vec_info("main"))
@@ -141,22 +381,111 @@ void TypeChecker::visit(Program& node)
     // called!
     error("undefined 'main' function");
   }
-   // pop the global environment
-  sym_table.pop_environment();
+   // pop the global environment (unless skimmed bodies still need it)
+  if (deferred.empty())
+    sym_table.pop_environment();
 }
 
-void TypeChecker::visit(FunDecl& node)
+inline void TypeChecker::check_parallel(Program& node)
+{
+  //  Types and signatures in order, noting how many global names each
+  //  body may see; later declarations depend on them, so this stops at
+  //  the first error
+  std::vector<FunDecl*> funs;
+  std::vector<size_t> visible;
+  std::unique_ptr<MyPLException> decl_error;
+  try
+  {
+    for (Decl* d : node.decls)
+    {
+      FunDecl* f = dynamic_cast<FunDecl*>(d);
+      if (!f)
+      {
+        d->accept(*this);
+        continue;
+      }
+      check_signature(*f);
+      if (f->skimmed)
+      {
+        deferred[f] = sym_table.global_count();
+        continue;
+      }
+      funs.push_back(f);
+      visible.push_back(sym_table.global_count());
+    }
+  }
+  catch (MyPLException& e)
+  {
+    decl_error.reset(new MyPLException(e));
+  }
+
+  //  Bodies of the functions declared before any error, each worker on
+  //  its own checker over the (now unchanging) global environment
+  std::vector<std::unique_ptr<MyPLException>> errors(funs.size());
+  std::vector<std::unique_ptr<TypeChecker>> checkers(pool->size());
+  pool->parallel_for(0, (long)funs.size() - 1, 0, [&](int worker, long lo, long hi) {
+      for (long i = lo; i <= hi; ++i)
+      {
+        std::unique_ptr<TypeChecker>& checker = checkers[worker];
+        if (!checker)
+        {
+          checker.reset(new TypeChecker);
+          checker->built_ins = built_ins;
+          checker->sym_table.push_environment();
+        }
+        checker->sym_table.set_globals(&sym_table, visible[i]);
+        try
+        {
+          checker->check_body(*funs[i]);
+        }
+        catch (MyPLException& e)
+        {
+          errors[i].reset(new MyPLException(e));
+          //  its environments were left mid-body
+          checker.reset();
+        }
+      }
+    });
+
+  for (std::unique_ptr<MyPLException>& e : errors)
+    if (e)
+      throw *e;
+  if (decl_error)
+    throw *decl_error;
+  for (FunDecl* f : funs)
+    check_channels(*f);
+}
+
+inline void TypeChecker::visit(FunDecl& node)
+{
+  check_signature(node);
+  if (node.skimmed)
+  {
+    deferred[&node] = sym_table.global_count();
+    return;
+  }
+  check_body(node);
+  check_channels(node);
+}
+
+inline void TypeChecker::check_deferred(FunDecl& node)
+{
+  TypeChecker checker;
+  checker.built_ins = built_ins;
+  checker.sym_table.push_environment();
+  checker.sym_table.set_globals(&sym_table, deferred.at(&node));
+  checker.check_body(node);
+  std::lock_guard<std::mutex> guard(channel_lock);
+  check_channels(node);
+}
+
+inline void TypeChecker::check_signature(FunDecl& node)
 {
-  bool is_nil = false;
-  std::string return_stmt_type;
   //  Check that function isnt already declared in the current environment
-  if (sym_table.name_exists_in_curr_env(node.id.lexeme()))
+  if (sym_table.name_exists_in_curr_env(node.id.lexeme())
+      || generic_built_ins.count(node.id.lexeme()))
     error("FunDecl Error| Function declaration matches another function that is already declared in scope ", node.id);
 
-  //  If return type is nil, raise flag
-  if (node.return_type.lexeme() == "nil")
-    is_nil = true;
-
   //  Check that function has a return type that matches primitives, nil, or a UDT
   if (
      node.return_type.lexeme() != "int" && node.return_type.lexeme() != "double"
@@ -165,25 +494,38 @@ void TypeChecker::visit(FunDecl& node)
      )
   {
     //  Check if name is a UDT that exists in scope
-    if ( !(sym_table.name_exists_in_curr_env(node.return_type.lexeme())) )
+    if ( !(sym_table.name_exists_in_curr_env(node.return_type.lexeme()))
+         && !is_channel_type(node.return_type.lexeme()) )
       error("FunDecl Error| Unrecognized return type: ", node.return_type);
   }
 
   StringVec params;
-  //  Iterate though params and add them to StringVec and symbol table
+  //  Iterate though params and add them to StringVec
   for (FunDecl::FunParam param: node.params)
-  {
-    sym_table.add_name(param.id.lexeme());
-    sym_table.set_str_info(param.id.lexeme(), param.type.lexeme());
     params.push_back(param.type.lexeme());
-  }
 
   params.push_back(node.return_type.lexeme());
   //  Add function name to the environment
   sym_table.add_name(node.id.lexeme());
   sym_table.set_vec_info(node.id.lexeme(), params);
+}
+
+inline void TypeChecker::check_body(FunDecl& node)
+{
+  bool is_nil = false;
+  std::string return_stmt_type;
 
-  sym_table.push_environment();\
+  //  If return type is nil, raise flag
+  if (node.return_type.lexeme() == "nil")
+    is_nil = true;
+
+  //  Params are only visible in the function body
+  sym_table.push_environment();
+  for (FunDecl::FunParam param: node.params)
+  {
+    sym_table.add_name(param.id.lexeme());
+    sym_table.set_str_info(param.id.lexeme(), param.type.lexeme());
+  }
 
   //  Add return type
   sym_table.add_name("return");
@@ -216,7 +558,15 @@ void TypeChecker::visit(FunDecl& node)
   }
 }
 
-void TypeChecker::visit(TypeDecl& node)
+inline void TypeChecker::check_channels(FunDecl& node)
+{
+  //  Record how the function uses its channel parameters, then pick the
+  //  implementation of the channels it creates
+  channel_roles[node.id.lexeme()] = ChannelAnalysis::param_roles(node, channel_roles);
+  ChannelAnalysis::mark_spsc(node, channel_roles);
+}
+
+inline void TypeChecker::visit(TypeDecl& node)
 {
   //  Check that a type with the same name isn't declared in the scope
   if (sym_table.name_exists_in_curr_env(node.id.lexeme()))
@@ -243,12 +593,16 @@ void TypeChecker::visit(TypeDecl& node)
         Statement Visitors
   ---------------------------------*/
 //  VarDeclStmt visitor
-void TypeChecker::visit(VarDeclStmt& node)
+inline void TypeChecker::visit(VarDeclStmt& node)
 {
-  //  Check that type exists
+  //  Check that a user-defined type exists
   if (node.type != nullptr)
-    if (sym_table.name_exists(node.type->lexeme()))
-      error("VarDeclStmt Error| Type already exists: ", node.id);
+  {
+    std::string t = node.type->lexeme();
+    if (t != "int" && t != "double" && t != "char" && t != "string" && t != "bool"
+        && !sym_table.has_map_info(t) && !is_channel_type(t))
+      error("VarDeclStmt Error| Type does not exist: ", *node.type);
+  }
 
   //  If a variable already exists in the env -> shadowing error
   if (sym_table.name_exists_in_curr_env(node.id.lexeme()))
@@ -272,12 +626,23 @@ void TypeChecker::visit(VarDeclStmt& node)
   //  initialize variable info and add it to the symbol table
   std::string var = node.id.lexeme();
   std::string expr_type = curr_type;
+  bool made = !parallel_loops.empty() && holds_objects(expr_type)
+    && loop_object(*node.expr);
   sym_table.add_name(var);
   sym_table.set_str_info(var, expr_type);
+  if (!parallel_loops.empty())
+  {
+    std::pair<std::string,int> key(var, sym_table.get_environment_id());
+    used_loop_objects.erase(key);
+    if (made)
+      loop_objects.insert(key);
+    else
+      loop_objects.erase(key);
+  }
 }
 
 // AssignStmt visitor
-void TypeChecker::visit(AssignStmt& node)
+inline void TypeChecker::visit(AssignStmt& node)
 {
   std::string prev_type;
   std::list<Token> lvals = node.lvalue_list;
@@ -288,6 +653,14 @@ void TypeChecker::visit(AssignStmt& node)
   else
     error("AssignStmt Error| Value not found: ", lvals.front());
 
+  if (!parallel_loops.empty())
+  {
+    if (lvals.size() > 1)
+      check_parallel_path(lvals.front());
+    else
+      check_parallel_assign(lvals.front());
+  }
+
   prev_type = curr_type;
   lvals.pop_front();
   //  Iterate through the rest of the path (if it exists)
@@ -312,13 +685,19 @@ void TypeChecker::visit(AssignStmt& node)
   std::string lhs_type = curr_type;
   Expr* e = node.expr;
   e->accept(*this);
-  if (lhs_type != curr_type)
+  if (lhs_type != curr_type && curr_type != "nil")
     error("AssignStmt Error| lhs type does not match rhs type: ");
+
+  if (!parallel_loops.empty() && holds_objects(lhs_type))
+    check_parallel_store(node.lvalue_list, *e);
 }
 
 //  ReturnStmt visitor
-void TypeChecker::visit(ReturnStmt& node)
+inline void TypeChecker::visit(ReturnStmt& node)
 {
+  if (!parallel_loops.empty())
+    error("ReturnStmt Error| Cannot return from inside a parallel for", node.expr->first_token());
+
   node.expr->accept(*this);
   std::string return_type;
 
@@ -332,7 +711,7 @@ void TypeChecker::visit(ReturnStmt& node)
 }
 
 //  IfStmt visitor
-void TypeChecker::visit(IfStmt& node)
+inline void TypeChecker::visit(IfStmt& node)
 {
   //  Get type of if stmt condition
   node.if_part->expr->accept(*this);
@@ -377,7 +756,7 @@ void TypeChecker::visit(IfStmt& node)
 }
 
 //  WhileStmt visitor
-void TypeChecker::visit(WhileStmt& node)
+inline void TypeChecker::visit(WhileStmt& node)
 {
   node.expr->accept(*this);
 
@@ -393,8 +772,29 @@ void TypeChecker::visit(WhileStmt& node)
 }
 
 //  ForStmt visitor
-void TypeChecker::visit(ForStmt& node)
+inline void TypeChecker::visit(ForStmt& node)
 {
+  //  Reductions must name distinct int or double variables in scope
+  std::set<std::string> reduced;
+  for (const ForStmt::Reduction& r : node.reductions)
+  {
+    std::string op = r.op.lexeme();
+    if (op != "sum" && op != "min" && op != "max")
+      error("ForStmt Error| Unknown reduction (expected sum, min, or max): ", r.op);
+    std::string var = r.var_id.lexeme();
+    if (!sym_table.name_exists(var) || !sym_table.has_str_info(var))
+      error("ForStmt Error| Reduction variable not found: ", r.var_id);
+    std::string type;
+    sym_table.get_str_info(var, type);
+    if (type != "int" && type != "double")
+      error("ForStmt Error| Reduction variable must be an int or double: ", r.var_id);
+    if (!reduced.insert(var).second)
+      error("ForStmt Error| Variable reduced more than once: ", r.var_id);
+    //  The reductions are combined into the enclosing variables
+    if (!parallel_loops.empty())
+      check_parallel_assign(r.var_id);
+  }
+
   //  Push environment
   sym_table.push_environment();
 
@@ -419,16 +819,31 @@ void TypeChecker::visit(ForStmt& node)
     error("ForStmt Error| End condition needs to be of type int: ", node.var_id);
 
   //  Push body environment and iterate through all body statements
+  int for_env = sym_table.get_environment_id();
   sym_table.push_environment();
+  if (node.parallel)
+    parallel_loops.push_back({&node, for_env, sym_table.get_environment_id(), {}});
   for (Stmt* s : node.stmts)
     s->accept(*this);
+  //  Record what the iterations read from enclosing scopes
+  if (node.parallel)
+  {
+    std::set<std::string>& captures = parallel_loops.back().captures;
+    node.captures.assign(captures.begin(), captures.end());
+    parallel_loops.pop_back();
+    if (parallel_loops.empty())
+    {
+      loop_objects.clear();
+      used_loop_objects.clear();
+    }
+  }
   //  Pop body environment
   sym_table.pop_environment();
   //  Pop for environment
   sym_table.pop_environment();
 }
 
-void TypeChecker::visit(TryStmt& node)
+inline void TypeChecker::visit(TryStmt& node)
 {
   //  Iterate through all stmts in the try stmt
   sym_table.push_environment();
@@ -440,7 +855,7 @@ void TypeChecker::visit(TryStmt& node)
   node.catch_stmt->accept(*this);
 }
 
-void TypeChecker::visit(ThrowStmt& node)
+inline void TypeChecker::visit(ThrowStmt& node)
 {
   //  Typecheck expression and ensure it is a int,double, or bool
   node.expr->accept(*this);
@@ -448,7 +863,7 @@ void TypeChecker::visit(ThrowStmt& node)
     error("ThrowStmt Error| Can only throw an int, double, or a bool expression");
 }
 
-void TypeChecker::visit(CatchStmt& node)
+inline void TypeChecker::visit(CatchStmt& node)
 {
   //  If catch_expr exists evaluate it
   if (node.catch_expr)
@@ -470,7 +885,7 @@ void TypeChecker::visit(CatchStmt& node)
         Expression Visitors
 ---------------------------------*/
 //  Expr visitor
-void TypeChecker::visit(Expr& node)
+inline void TypeChecker::visit(Expr& node)
 {
   std::string lhs_type;
   std::string rhs_type;
@@ -550,17 +965,27 @@ void TypeChecker::visit(Expr& node)
         break;
     }
   }
+
+  //  Record the resolved types for later passes
+  node.first->type = lhs_type;
+  node.type = curr_type;
+}
+
+//  QuickExpr visitor (already checked before it was specialized)
+inline void TypeChecker::visit(QuickExpr& node)
+{
+  visit((Expr&)node);
 }
 
 //  SimpleTerm visitor
-void TypeChecker::visit(SimpleTerm& node)
+inline void TypeChecker::visit(SimpleTerm& node)
 {
   //  Typecheck the expression
   node.rvalue->accept(*this);
 }
 
 //  ComplexTerm visitor
-void TypeChecker::visit(ComplexTerm& node)
+inline void TypeChecker::visit(ComplexTerm& node)
 {
   //  typecheck the expression
   node.expr->accept(*this);
@@ -570,7 +995,7 @@ void TypeChecker::visit(ComplexTerm& node)
       Rvalue Visitors
 ---------------------------------*/
 //  SimpleRValue visitor
-void TypeChecker::visit(SimpleRValue& node)
+inline void TypeChecker::visit(SimpleRValue& node)
 {
   switch (node.value.type())
   {
@@ -605,10 +1030,25 @@ void TypeChecker::visit(SimpleRValue& node)
 }
 
 //  NewRValue visitor
-void TypeChecker::visit(NewRValue& node)
+inline void TypeChecker::visit(NewRValue& node)
 {
+  //  Channels take an optional int capacity
+  if (node.type_id.lexeme().find("channel<") == 0)
+  {
+    if (!is_channel_type(node.type_id.lexeme()))
+      error("NewRValue Error| Unknown channel element type: ", node.type_id);
+    if (node.capacity)
+    {
+      node.capacity->accept(*this);
+      if (curr_type != "int")
+        error("NewRValue Error| Channel capacity must be an int: ", node.type_id);
+    }
+    curr_type = node.type_id.lexeme();
+    return;
+  }
+
   //  Ensure that new type exists in environment
-  if (sym_table.name_exists_in_curr_env(node.type_id.lexeme()))
+  if (sym_table.name_exists(node.type_id.lexeme()))
   {
     //  Ensure that the type has data associated with it
     if ( !(sym_table.has_map_info(node.type_id.lexeme())) )
@@ -623,9 +1063,16 @@ void TypeChecker::visit(NewRValue& node)
 }
 
 //  CallExpr visitor
-void TypeChecker::visit(CallExpr& node)
+inline void TypeChecker::visit(CallExpr& node)
 {
   std::string fun_name = node.function_id.lexeme();
+
+  if (generic_built_ins.count(fun_name))
+  {
+    generic_call(node);
+    return;
+  }
+
   StringVec fun_type;
   sym_table.get_vec_info(fun_name, fun_type);
 
@@ -643,15 +1090,63 @@ void TypeChecker::visit(CallExpr& node)
     e->accept(*this);
     if (fun_type[i] != curr_type && curr_type != "nil")
       error("CallExpr| Function call does not match function defintion: ", node.function_id);
+    if (!parallel_loops.empty() && holds_objects(fun_type[i]))
+      check_parallel_arg(node, *e);
     i++;
   }
 
   //  Set curr type to return type
   curr_type = fun_type[fun_type.size()-1];
+
+  //  A spawned call's value is a handle to the task running it
+  if (node.spawn)
+  {
+    if (built_ins.count(fun_name))
+      error("CallExpr Error| Only user-defined functions can be spawned: ", node.function_id);
+    curr_type = "task<" + curr_type + ">";
+  }
+}
+
+inline void TypeChecker::generic_call(CallExpr& node)
+{
+  std::string fun_name = node.function_id.lexeme();
+  size_t arity = fun_name == "send" ? 2 : 1;
+  if (node.arg_list.size() != arity)
+    error("CallExpr Error| Incorrect number of parameters: ", node.function_id);
+  node.arg_list.front()->accept(*this);
+
+  //  await takes a task handle (task<T>) and returns the task's result (T)
+  if (fun_name == "await")
+  {
+    if (curr_type.find("task<") != 0)
+      error("CallExpr Error| await expects a task handle: ", node.function_id);
+    curr_type = curr_type.substr(5, curr_type.length() - 6);
+    return;
+  }
+
+  //  The others take a channel<T>: send(c, T) and close(c) return nil,
+  //  and recv(c) and try_recv(c) return a T (nil once the channel is
+  //  closed and empty, or for try_recv, when nothing is ready)
+  if (curr_type.find("channel<") != 0)
+    error("CallExpr Error| " + fun_name + " expects a channel: ", node.function_id);
+  std::string elem_type = curr_type.substr(8, curr_type.length() - 9);
+  if (fun_name == "send")
+  {
+    node.arg_list.back()->accept(*this);
+    if (curr_type != elem_type)
+      error("CallExpr Error| Sent value does not match the channel type: ", node.function_id);
+    if (!parallel_loops.empty() && holds_objects(elem_type))
+      check_parallel_arg(node, *node.arg_list.back());
+    curr_type = "nil";
+  }
+  else if (fun_name == "close")
+    curr_type = "nil";
+  else
+    curr_type = elem_type;
 }
 
 //  IDRValue visitor
-void TypeChecker::visit(IDRValue& node)
+inline void TypeChecker::visit(IDRValue& node)
 {
   std::list<Token> path = node.path;
   std::string prev_type;
@@ -661,6 +1156,8 @@ void TypeChecker::visit(IDRValue& node)
     sym_table.get_str_info(path.front().lexeme(), curr_type);
   else
     error("IDRValue Error| Head element of path does not exist: ", node.path.front());
+  if (!parallel_loops.empty())
+    note_read(path.front().lexeme());
 
   prev_type = curr_type;
   //  Remove head element
@@ -686,7 +1183,7 @@ void TypeChecker::visit(IDRValue& node)
 }
 
 //  NegatedRValue visitor
-void TypeChecker::visit(NegatedRValue& node)
+inline void TypeChecker::visit(NegatedRValue& node)
 {
   //  Get type of expr
   node.expr->accept(*this);